@@ -6,10 +6,11 @@
 
 QT       += core gui
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = PassMan
 TEMPLATE = app
+CONFIG += c++11
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which as been marked as deprecated (the exact warnings
@@ -26,7 +27,7 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES +=\
         passman.cpp \
     database.cpp \
-    entry.cpp \
+    entrystore.cpp \
     yubikeytester.cpp \
     yubikey.cpp \
     authenticator.cpp \
@@ -35,11 +36,35 @@ SOURCES +=\
     generator.cpp \
     strengthcalculator.cpp \
     help.cpp \
-    license.cpp
+    license.cpp \
+    vaultheader.cpp \
+    chunkedcipher.cpp \
+    record.cpp \
+    journal.cpp \
+    fieldcipher.cpp \
+    argon2.cpp \
+    pbkdf2.cpp \
+    kdfpolicy.cpp \
+    compressor.cpp \
+    searchindex.cpp \
+    fuzzymatcher.cpp \
+    entryid.cpp \
+    idtable.cpp \
+    entrymap.cpp \
+    undohistory.cpp \
+    groupindex.cpp \
+    securememory.cpp \
+    valuedelta.cpp \
+    digesttree.cpp \
+    merger.cpp \
+    chunker.cpp \
+    chunkstore.cpp \
+    entrylistmodel.cpp \
+    editbuffer.cpp
 
 HEADERS  += passman.h \
     database.h \
-    entry.h \
+    entrystore.h \
     yubikeytester.h \
     yubikey.h \
     authenticator.h \
@@ -47,7 +72,31 @@ HEADERS  += passman.h \
     generator.h \
     strengthcalculator.h \
     help.h \
-    license.h
+    license.h \
+    vaultheader.h \
+    chunkedcipher.h \
+    record.h \
+    journal.h \
+    fieldcipher.h \
+    argon2.h \
+    pbkdf2.h \
+    kdfpolicy.h \
+    compressor.h \
+    searchindex.h \
+    fuzzymatcher.h \
+    entryid.h \
+    idtable.h \
+    entrymap.h \
+    undohistory.h \
+    groupindex.h \
+    securememory.h \
+    valuedelta.h \
+    digesttree.h \
+    merger.h \
+    chunker.h \
+    chunkstore.h \
+    entrylistmodel.h \
+    editbuffer.h
 
 FORMS    += passman.ui \
     yubikeytester.ui \
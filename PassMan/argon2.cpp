@@ -0,0 +1,310 @@
+/*
+ * Description: Implementation of the Argon2 class.
+ *              Derives keys with Argon2id (RFC 9106), a memory-hard function for password hashing.
+ *              The lanes of each pass are filled in parallel on a thread pool.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Memory is a matrix of 1 KiB blocks, one row per lane, split into four slices.  Within a slice each lane only reads
+ * its own blocks and finished slices of the others, so lanes run on separate threads and meet at slice boundaries.
+ * The first half of the first pass picks reference blocks independently of the password (as Argon2i), the rest
+ * from the previous block's contents (as Argon2d).  Version 0x13 is used, where later passes XOR into old blocks.
+ */
+
+#include "argon2.h"
+
+class Argon2::SegmentTask : public QRunnable
+{
+    public:
+        SegmentTask(Argon2* owner, quint32 pass, quint32 lane, quint32 slice) : owner(owner), pass(pass), lane(lane), slice(slice) { }
+        void run() { owner->fillSegment(pass, lane, slice); }
+
+    private:
+        Argon2* owner;
+        quint32 pass, lane, slice;
+};
+
+static inline void store32(byte* out, quint32 value) { for (int i = 0; i < 4; i++) out[i] = (byte) (value >> (8 * i)); }   // Little-endian helpers
+
+static inline quint64 load64(const byte* in)
+{
+    quint64 value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | in[i];
+    return value;
+}
+
+static inline void store64(byte* out, quint64 value) { for (int i = 0; i < 8; i++) out[i] = (byte) (value >> (8 * i)); }
+
+static inline quint64 rotr64(quint64 w, unsigned c) { return (w >> c) | (w << (64 - c)); }
+
+static inline quint64 fBlaMka(quint64 x, quint64 y) { return x + y + 2 * (x & 0xFFFFFFFF) * (y & 0xFFFFFFFF); }  // BLAKE2b addition with a multiplication, for memory hardness
+
+static inline void mix(quint64& a, quint64& b, quint64& c, quint64& d)
+{
+    a = fBlaMka(a, b);
+    d = rotr64(d ^ a, 32);
+    c = fBlaMka(c, d);
+    b = rotr64(b ^ c, 24);
+    a = fBlaMka(a, b);
+    d = rotr64(d ^ a, 16);
+    c = fBlaMka(c, d);
+    b = rotr64(b ^ c, 63);
+}
+
+static inline void permute(quint64* v[16])    // BLAKE2b round without message words, over 16 words
+{
+    mix(*v[0], *v[4], *v[8], *v[12]);
+    mix(*v[1], *v[5], *v[9], *v[13]);
+    mix(*v[2], *v[6], *v[10], *v[14]);
+    mix(*v[3], *v[7], *v[11], *v[15]);
+    mix(*v[0], *v[5], *v[10], *v[15]);
+    mix(*v[1], *v[6], *v[11], *v[12]);
+    mix(*v[2], *v[7], *v[8], *v[13]);
+    mix(*v[3], *v[4], *v[9], *v[14]);
+}
+
+Argon2::Argon2(quint32 memory, quint32 passes, quint32 lanes)
+{
+    memoryCost = memory;
+    passCount = passes;
+    laneCount = lanes;
+    quint32 blocks = (memory < 2 * SYNC_POINTS * lanes) ? 2 * SYNC_POINTS * lanes : memory;
+    segmentLength = blocks / (lanes * SYNC_POINTS);
+    laneLength = segmentLength * SYNC_POINTS;
+    this->memory = 0;
+    cancelled = 0;
+}
+
+void Argon2::setCancel(const QAtomicInt* flag) { cancelled = flag; }    // Give up part way, between slices, once this flag is set
+
+bool Argon2::deriveKey(byte* key, size_t keyLength, const byte* password, size_t passwordLength, const byte* salt, size_t saltLength)   // False if the memory couldn't be allocated, or if cancelled
+{
+    CryptoPP::SecBlock<quint64> blocks;  // Wiped when released
+    try
+    {
+        blocks.New((size_t) laneLength * laneCount * BLOCK_WORDS);
+    }
+    catch (std::bad_alloc&)
+    {
+        return false;
+    }
+    memory = blocks.data();
+
+    byte h0[64 + 8];    // Initial hash of every parameter and input, with room for the block and lane indices
+    byte word[4];
+    CryptoPP::BLAKE2b initial(false, 64);
+    const quint32 parameters[] = { laneCount, (quint32) keyLength, memoryCost, passCount, VERSION, TYPE_ID };
+    for (quint32 p : parameters)
+    {
+        store32(word, p);
+        initial.Update(word, 4);
+    }
+    store32(word, (quint32) passwordLength);
+    initial.Update(word, 4);
+    initial.Update(password, passwordLength);
+    store32(word, (quint32) saltLength);
+    initial.Update(word, 4);
+    initial.Update(salt, saltLength);
+    store32(word, 0);   // No secret or associated data
+    initial.Update(word, 4);
+    initial.Update(word, 4);
+    initial.Final(h0);
+
+    byte block[BLOCK_WORDS * 8];
+    for (quint32 lane = 0; lane < laneCount; lane++)    // First two blocks of each lane come straight from the hash
+    {
+        for (quint32 i = 0; i < 2; i++)
+        {
+            store32(h0 + 64, i);
+            store32(h0 + 68, lane);
+            hashLong(block, sizeof(block), h0, sizeof(h0));
+            quint64* out = memory + ((size_t) lane * laneLength + i) * BLOCK_WORDS;
+            for (int w = 0; w < BLOCK_WORDS; w++) out[w] = load64(block + 8 * w);
+        }
+    }
+
+    memset(h0, 0, sizeof(h0));
+    QThreadPool pool;
+    pool.setMaxThreadCount(laneCount > 1 ? laneCount - 1 : 1);  // This thread fills lane zero
+    for (quint32 pass = 0; pass < passCount; pass++)
+    {
+        for (quint32 slice = 0; slice < SYNC_POINTS; slice++)
+        {
+            for (quint32 lane = 1; lane < laneCount; lane++) pool.start(new SegmentTask(this, pass, lane, slice));
+            fillSegment(pass, 0, slice);
+            pool.waitForDone(); // Every lane finishes the slice before any starts the next
+            if (cancelled && cancelled->load())
+            {
+                memset(block, 0, sizeof(block));
+                memory = 0;
+                return false;   // The blocks are wiped as they are released
+            }
+        }
+    }
+
+    quint64 result[BLOCK_WORDS]; // XOR of the last block in every lane
+    memcpy(result, memory + ((size_t) laneLength - 1) * BLOCK_WORDS, sizeof(result));
+    for (quint32 lane = 1; lane < laneCount; lane++)
+    {
+        const quint64* last = memory + ((size_t) lane * laneLength + laneLength - 1) * BLOCK_WORDS;
+        for (int w = 0; w < BLOCK_WORDS; w++) result[w] ^= last[w];
+    }
+    for (int w = 0; w < BLOCK_WORDS; w++) store64(block + 8 * w, result[w]);
+    hashLong(key, keyLength, block, sizeof(block));
+    memset(block, 0, sizeof(block));
+    memset(result, 0, sizeof(result));
+    memory = 0;
+    return true;
+}
+
+void Argon2::calibrate(double seconds, quint32 lanes, quint32& memory, quint32& passes)    // Pick memory and passes filling roughly this long
+{
+    byte probe[32];
+    byte input[16] = { 0 };
+    memory = DEFAULT_MEMORY;
+    while (true)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        bool allocated = Argon2(memory, 1, lanes).deriveKey(probe, sizeof(probe), input, sizeof(input), input, sizeof(input));
+        double elapsed = timer.nsecsElapsed() / 1e9;
+        if ((!allocated || elapsed > seconds) && memory > MIN_CALIBRATION_MEMORY)   // Too slow or too large for this machine, trade memory for time
+        {
+            memory /= 2;
+            continue;
+        }
+        passes = (elapsed > 0) ? (quint32) (seconds / elapsed) : 1;
+        if (passes < 1) passes = 1;
+        return;
+    }
+}
+
+quint32 Argon2::defaultLanes()  // Lanes to use on this machine
+{
+    int cores = QThread::idealThreadCount();
+    if (cores < (int) MIN_LANES) return MIN_LANES;
+    return (cores > 8) ? 8 : cores; // More lanes than this gain little, and slow opening on smaller machines
+}
+
+void Argon2::hashLong(byte* out, size_t outLength, const byte* in, size_t inLength)  // Variable-length BLAKE2b, H' in the RFC
+{
+    byte length[4];
+    store32(length, (quint32) outLength);
+    if (outLength <= 64)
+    {
+        CryptoPP::BLAKE2b hash(false, (unsigned int) outLength);
+        hash.Update(length, 4);
+        hash.Update(in, inLength);
+        hash.Final(out);
+        return;
+    }
+    byte v[64];
+    CryptoPP::BLAKE2b first(false, 64);
+    first.Update(length, 4);
+    first.Update(in, inLength);
+    first.Final(v);
+    memcpy(out, v, 32); // Chain 64-byte hashes, keeping the first half of each
+    size_t written = 32;
+    while (outLength - written > 64)
+    {
+        CryptoPP::BLAKE2b next(false, 64);
+        next.Update(v, 64);
+        next.Final(v);
+        memcpy(out + written, v, 32);
+        written += 32;
+    }
+    CryptoPP::BLAKE2b last(false, (unsigned int) (outLength - written));
+    last.Update(v, 64);
+    last.Final(out + written);
+    memset(v, 0, sizeof(v));
+}
+
+void Argon2::fillBlock(const quint64* prev, const quint64* ref, quint64* next, bool withXor)    // Compression function G
+{
+    quint64 r[BLOCK_WORDS];
+    quint64 t[BLOCK_WORDS];
+    for (int i = 0; i < BLOCK_WORDS; i++) t[i] = r[i] = prev[i] ^ ref[i];
+    if (withXor) for (int i = 0; i < BLOCK_WORDS; i++) t[i] ^= next[i];
+    quint64* v[16];
+    for (int row = 0; row < 8; row++)   // Rows of sixteen words
+    {
+        for (int i = 0; i < 16; i++) v[i] = &r[16 * row + i];
+        permute(v);
+    }
+    for (int column = 0; column < 8; column++)  // Columns of eight word pairs
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            v[2 * i] = &r[2 * column + 16 * i];
+            v[2 * i + 1] = &r[2 * column + 16 * i + 1];
+        }
+        permute(v);
+    }
+    for (int i = 0; i < BLOCK_WORDS; i++) next[i] = t[i] ^ r[i];
+}
+
+void Argon2::fillSegment(quint32 pass, quint32 lane, quint32 slice)    // Fill one lane's share of a slice
+{
+    bool independent = (pass == 0 && slice < SYNC_POINTS / 2);
+    quint64 zero[BLOCK_WORDS] = { 0 };
+    quint64 input[BLOCK_WORDS] = { 0 };
+    quint64 addresses[BLOCK_WORDS];
+    if (independent)
+    {
+        input[0] = pass;
+        input[1] = lane;
+        input[2] = slice;
+        input[3] = (quint64) laneLength * laneCount;
+        input[4] = passCount;
+        input[5] = TYPE_ID;
+    }
+    quint32 start = (pass == 0 && slice == 0) ? 2 : 0;  // The first two blocks are already filled
+    if (independent && start == 2)
+    {
+        input[6]++;
+        fillBlock(zero, input, addresses, false);
+        fillBlock(zero, addresses, addresses, false);
+    }
+    size_t laneStart = (size_t) lane * laneLength;
+    for (quint32 index = start; index < segmentLength; index++)
+    {
+        quint32 column = slice * segmentLength + index;
+        const quint64* prev = memory + (laneStart + (column == 0 ? laneLength - 1 : column - 1)) * BLOCK_WORDS;
+        quint64 random;
+        if (independent)
+        {
+            if (index % BLOCK_WORDS == 0)   // Next batch of password-independent addresses
+            {
+                input[6]++;
+                fillBlock(zero, input, addresses, false);
+                fillBlock(zero, addresses, addresses, false);
+            }
+            random = addresses[index % BLOCK_WORDS];
+        }
+        else random = prev[0];
+        quint32 refLane = (pass == 0 && slice == 0) ? lane : (quint32) ((random >> 32) % laneCount);
+        quint32 refIndex = referenceIndex(pass, slice, index, (quint32) random, refLane == lane);
+        const quint64* ref = memory + ((size_t) refLane * laneLength + refIndex) * BLOCK_WORDS;
+        fillBlock(prev, ref, memory + (laneStart + column) * BLOCK_WORDS, pass > 0);
+    }
+}
+
+quint32 Argon2::referenceIndex(quint32 pass, quint32 slice, quint32 index, quint32 random, bool sameLane) const  // Block a new block depends on
+{
+    quint32 area;   // Blocks that are finished and may be referenced
+    if (pass == 0)
+    {
+        if (slice == 0) area = index - 1;
+        else if (sameLane) area = slice * segmentLength + index - 1;
+        else area = slice * segmentLength - (index == 0 ? 1 : 0);
+    }
+    else
+    {
+        if (sameLane) area = laneLength - segmentLength + index - 1;
+        else area = laneLength - segmentLength - (index == 0 ? 1 : 0);
+    }
+    quint64 position = ((quint64) random * random) >> 32; // Bias towards recent blocks
+    position = area - 1 - ((area * position) >> 32);
+    quint32 start = (pass == 0 || slice == SYNC_POINTS - 1) ? 0 : (slice + 1) * segmentLength;
+    return (quint32) ((start + position) % laneLength);
+}
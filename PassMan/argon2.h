@@ -0,0 +1,57 @@
+/*
+ * Description: Definition of the Argon2 class.
+ *              Derives keys with Argon2id (RFC 9106), a memory-hard function for password hashing.
+ *              The lanes of each pass are filled in parallel on a thread pool.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef ARGON2_H
+#define ARGON2_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <new>
+#include <crypto++/blake2.h>
+#include <crypto++/secblock.h>
+
+class Argon2
+{
+    public:
+        static const quint32 VERSION = 0x13;
+        static const quint32 MIN_LANES = 1;
+        static const quint32 MAX_LANES = 255;   // Format limit, well above any core count the calibration picks
+        static const quint32 MIN_MEMORY = 8;    // KiB per lane
+        static const quint32 DEFAULT_MEMORY = 256 * 1024;   // KiB tried first when calibrating
+        static const quint32 MIN_CALIBRATION_MEMORY = 16 * 1024;    // KiB below which calibration stops halving memory
+
+        Argon2(quint32 memory, quint32 passes, quint32 lanes);  // Memory in KiB
+
+        void setCancel(const QAtomicInt* flag); // Give up part way, between slices, once this flag is set
+        bool deriveKey(byte* key, size_t keyLength, const byte* password, size_t passwordLength, const byte* salt, size_t saltLength);   // False if the memory couldn't be allocated, or if cancelled
+        static void calibrate(double seconds, quint32 lanes, quint32& memory, quint32& passes);    // Pick memory and passes filling roughly this long
+        static quint32 defaultLanes();  // Lanes to use on this machine
+
+    private:
+        static const int SYNC_POINTS = 4;   // Slices per pass, lanes only meet at slice boundaries
+        static const int BLOCK_WORDS = 128; // 64-bit words in a 1 KiB block
+        static const int TYPE_ID = 2;
+        quint32 memoryCost;
+        quint32 passCount;
+        quint32 laneCount;
+        quint32 segmentLength;
+        quint32 laneLength;
+        quint64* memory;
+        const QAtomicInt* cancelled;    // Null when the derivation can't be cancelled
+
+        class SegmentTask;
+        static void hashLong(byte* out, size_t outLength, const byte* in, size_t inLength);  // Variable-length BLAKE2b, H' in the RFC
+        static void fillBlock(const quint64* prev, const quint64* ref, quint64* next, bool withXor);    // Compression function G
+        void fillSegment(quint32 pass, quint32 lane, quint32 slice);    // Fill one lane's share of a slice
+        quint32 referenceIndex(quint32 pass, quint32 slice, quint32 index, quint32 random, bool sameLane) const;  // Block a new block depends on
+};
+
+#endif // ARGON2_H
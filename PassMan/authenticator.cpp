@@ -3,9 +3,22 @@
  *              Handles secure file encryption/decryption operations.
  *              Utilizes AES-256 in GCM-AE mode.
  *              Two factors are used for the key: A user password, and their YubiKey's HMAC-SHA1 response.
- *              They are combined to a single master key via PBKDF2-SHA512.
+ *              They are combined to a single master key via Argon2id or PBKDF2-SHA512, which wraps a random data key.
+ *              Saves while a database is unlocked reuse the data key, so only opening or changing credentials derives a key.
+ *              The YubiKey is answered, and the key derived and the file decrypted or encrypted, without blocking the interface.
  * Author:      Adam Coffee
  * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * An operation runs in stages: the YubiKey challenge is a background process, answered or timed out through signals,
+ * then the key derivation, unwrapping, decryption, journal replay and record decoding run on a worker thread, or for a
+ * save the key derivation, compression and encryption.  The worker touches no widgets: issues are noted as reports and
+ * shown once it is done, and its stage and progress are polled into the status bar.  Opening decodes into a private
+ * database, which is only swapped into the caller's back on the GUI thread once the file has opened, so the one on
+ * show is never touched by the worker and survives a failed or cancelled open.  Saving serializes the database on
+ * the GUI thread first, so the worker never reads it while it can be edited.  A save that outgrows the journal rewrites
+ * the whole snapshot, attachments included, so it runs on the worker too, only without deriving a key.  The window is modal, so
+ * nothing else starts meanwhile.  Cancelling, or running past the time limit, stops the worker at its next check, between
+ * stages or chunks, leaving an existing file as it was; the key derivation itself runs to its end.
  */
 
 #include "authenticator.h"
@@ -13,12 +26,16 @@
 
 const char Authenticator::FILE_PORTION_SEPARATOR = ':';
 const int Authenticator::TAG_SIZE = 16;
-const double Authenticator::MIN_PBKDF_TIME = 0.5;
 const int Authenticator::DECRYPT_MODE = 0;
 const int Authenticator::ENCRYPT_MODE = 1;
 const QString Authenticator::WAITING = "Waiting for key";
 const QString Authenticator::BUSY_YUBIKEY = "Contacting YubiKey";
 const QString Authenticator::BUSY_KEY = "Computing key";
+const QString Authenticator::BENCHMARKING = "Benchmarking key derivation";
+const QString Authenticator::DECRYPTING = "Decrypting database";
+const QString Authenticator::ENCRYPTING = "Encrypting database";
+const QString Authenticator::CANCEL = "Cancel";
+const QString Authenticator::CANCELLED = "Cancelled";
 const QString Authenticator::FAILED = "Failed";
 const QString Authenticator::COMPLETE = "Valid key";
 const QString Authenticator::ERROR_TITLE = "Authenticator Error";
@@ -36,101 +53,255 @@ const QString Authenticator::CIPHER_ERROR = "The ciphertext is invalid.";
 const QString Authenticator::SALT_ERROR = "The salt is invalid.";
 const QString Authenticator::INTEGRITY_ERROR = "The key is incorrect, or the database file is corrupted.";
 const QString Authenticator::ITERATION_ERROR = " The iteration count is invalid.";
+const QString Authenticator::VERSION_ERROR = "The file was created by a newer version of PassMan.";
+const QString Authenticator::PARAMETER_ERROR = "The key derivation or cipher parameters are invalid.";
+const QString Authenticator::WRITE_ERROR = "The file could not be opened for writing.";
+const QString Authenticator::RECORD_ERROR = "The database contents are malformed.";
+const QString Authenticator::JOURNAL_TITLE = "The most recent changes were not completely saved.";
+const QString Authenticator::JOURNAL_TORN = "They have been discarded, and the database will be rewritten on the next save.";
+const QString Authenticator::MEMORY_ERROR = "Not enough memory is available to derive the key.";
+const QString Authenticator::TIME_LIMIT_ERROR = "The operation ran past its time limit, and was stopped.";
+const QString Authenticator::UPGRADE_TITLE = "Weak Key Derivation";
+const QString Authenticator::UPGRADE_QUESTION = "This database's key derivation is weaker than this computer's calibrated setting.  Strengthen it now?";
+const QString Authenticator::UPGRADE_DETAIL = "The database is rewritten under the same password and YubiKey.  Opening it will take about as long as the last benchmark.";
+const QString Authenticator::JOURNAL_LIMIT_KEY = "journal/compactionSize";
+const QString Authenticator::TIME_LIMIT_KEY = "authenticator/timeLimit";
+const QString Authenticator::ARGON2_NAME = "Argon2id";
+const QString Authenticator::PBKDF2_NAME = "PBKDF2-SHA512";
 
-Authenticator::Authenticator(YubiKey* yk, QWidget *parent) : QMainWindow(parent), ui(new Ui::Authenticator)
+Authenticator::Authenticator(YubiKey* yk, QWidget *parent) : QMainWindow(parent), ui(new Ui::Authenticator), key(KEY_SIZE), masterKey(KEY_SIZE)
 {
     ui->setupUi(this);
     yubikey = yk;
     operationMode = DECRYPT_MODE;
+    readOnly = unlocked = false;
+    canChallenge = false;
+    busy = upgrading = compacting = timedOut = false;
+    db = 0;
+    staging = new Database(QString()); // Never written out, so it needs no version
+    journalEnd = 0;
+    journalSequence = 0;
+    ivLength = VaultHeader::NONCE_SIZE;
+    kdfType = VaultHeader::KDF_ARGON2ID;
+    iterations = 1;
+    memoryCost = 0;
+    lanes = 0;
+    vaultData = 0;
+    vaultSize = 0;
+    payload = 0;
+    payloadSize = 0;
     connect(yubikey, SIGNAL(yubiKeyChanged()), this, SLOT(updateYubiKeyState()));    // Update details if YubiKey plugged in
+    connect(yubikey, SIGNAL(responded(QByteArray)), this, SLOT(challengeDone(QByteArray)));
+    connect(&work, SIGNAL(finished()), this, SLOT(workDone()));
+    ticker.setInterval(PROGRESS_INTERVAL);
+    connect(&ticker, SIGNAL(timeout()), this, SLOT(updateProgress()));
+    deadline.setSingleShot(true);
+    connect(&deadline, SIGNAL(timeout()), this, SLOT(timeLimitReached()));
+    setWindowModality(Qt::ApplicationModal);    // The database isn't edited while it is saved, nor another file opened meanwhile
     setStatus(WAITING);
+    progressBar = new QProgressBar();
+    progressBar->setVisible(false);
+    statusBar()->addPermanentWidget(progressBar);
+    cancelButton = new QPushButton(CANCEL);
+    cancelButton->setVisible(false);
+    connect(cancelButton, SIGNAL(clicked()), this, SLOT(cancel()));
+    statusBar()->addPermanentWidget(cancelButton);
     yubikeyState = new QLabel();
     statusBar()->addPermanentWidget(yubikeyState);
     statusBar()->addPermanentWidget(new QLabel(" "));   // Dummy label to add space on right of statusBar
-    yubikey->poll();
-    updateYubiKeyState();
+    ui->kdfComboBox->addItem(ARGON2_NAME, VaultHeader::KDF_ARGON2ID);
+    ui->kdfComboBox->addItem(PBKDF2_NAME, VaultHeader::KDF_PBKDF2_SHA512);
+    updateYubiKeyState();   // The main window's probe is shared, and its result signalled when in
 }
 
 Authenticator::~Authenticator()
 {
     clean();    // Wipe sensitive variables prior to deconstruction!
+    delete staging;
     delete ui;
 }
 
-void Authenticator::open(const QString& fileName, Database* db) // Decrypt a file
+void Authenticator::open(const QString& fileName, Database* db, bool readOnly) // Decrypt a file, a read-only one is never upgraded nor left unlocked for saves
 {
+    abandonWork();  // Nothing below is changed from under the worker
+    staging->clear();
     ui->masterPasswordLineEdit->clear();
     operationMode = DECRYPT_MODE;
+    this->readOnly = readOnly;
+    unlocked = false;
     this->fileName = fileName;
     this->db = db;
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly))    // Failed to open file
+    header.clear();
+    if (!mapVault())    // Failed to open file
     {
-        notify(QMessageBox::Critical, ERROR_TITLE, DB_ERROR, FILE_ERROR);
-        this->clean();
-        this->hide();
+        fail(DB_ERROR, FILE_ERROR);
+        showReports();
         return;
     }
-    QByteArrayList parts = file.readAll().split(FILE_PORTION_SEPARATOR);
-    file.close();
+    bool loaded = VaultHeader::hasMagic(vaultData, vaultSize) ? readVault() : readLegacy();
+    ui->kdfComboBox->setCurrentIndex(ui->kdfComboBox->findData(kdfType));  // Shows the file's KDF, which can't be changed here
+    ui->kdfComboBox->setEnabled(false);
+    if (loaded) this->show();   // Show interface to user
+    else showReports();
+}
+
+bool Authenticator::mapVault()  // Map the file read-only, so the header and ciphertext are used in place
+{
+    releaseVault();
+    vault.setFileName(fileName);
+    if (!vault.open(QIODevice::ReadOnly)) return false;
+    vaultSize = vault.size();
+    uchar* map = (vaultSize > 0) ? vault.map(0, vaultSize) : 0;
+    if (map)
+    {
+        posix_madvise(map, vaultSize, POSIX_MADV_SEQUENTIAL);   // Decryption walks the file front to back once
+        vaultData = (const char*) map;
+    }
+    else    // Filesystem without mapping support, fall back to a single read
+    {
+        vaultCopy = vault.readAll();
+        vaultData = vaultCopy.constData();
+        vaultSize = vaultCopy.size();
+    }
+    return true;
+}
+
+void Authenticator::releaseVault()  // Unmap and close the file
+{
+    vaultCopy.fill(0);
+    vaultCopy.clear();
+    vault.close();  // Also removes the mapping
+    vaultData = 0;
+    vaultSize = 0;
+    payload = 0;
+    payloadSize = 0;
+}
+
+bool Authenticator::readVault()   // Validate the binary file header in place
+{
+    switch (header.parse(vaultData, vaultSize))
+    {
+        case VaultHeader::VALID:
+            break;
+        case VaultHeader::BAD_VERSION:
+            fail(DB_ERROR, VERSION_ERROR);
+            return false;
+        case VaultHeader::BAD_PARAMETERS:
+            fail(DB_ERROR, PARAMETER_ERROR);
+            return false;
+        default:    // File is missing crucial parts
+            fail(DB_ERROR, PIECES_ERROR);
+            return false;
+    }
+    if (!header.fits(vaultSize))  // Ciphertext is cut short
+    {
+        fail(DB_ERROR, PIECES_ERROR);
+        return false;
+    }
+    challenge = QByteArray(header.challenge(), VaultHeader::CHALLENGE_SIZE);    // Store the challenge, salt, and iv from the header
+    memcpy(salt, header.salt(), SALT_SIZE);
+    kdfType = header.kdf();
+    iterations = header.iterations();
+    memoryCost = header.memoryCost();
+    lanes = header.lanes();
+    memcpy(iv, header.nonce(), VaultHeader::NONCE_SIZE);
+    ivLength = VaultHeader::NONCE_SIZE;
+    memcpy(keyNonce, header.keyNonce(), VaultHeader::NONCE_SIZE);
+    memcpy(wrappedKey, header.wrappedKey(), VaultHeader::WRAPPED_KEY_SIZE);
+    payload = (const byte*) vaultData + header.headerLength();  // Ciphertext is decrypted straight from the mapping
+    payloadSize = header.payloadLength();
+    return true;
+}
+
+bool Authenticator::readLegacy()  // Load parameters and ciphertext from an original text file
+{
+    header.clear(0);    // No binary header, so no journal or wrapped key either
+    kdfType = VaultHeader::KDF_PBKDF2_SHA512;
+    memoryCost = lanes = 0; // Nothing stale from an Argon2id file reaches the next header
+    QByteArrayList parts = QByteArray::fromRawData(vaultData, vaultSize).split(FILE_PORTION_SEPARATOR);
     if (parts.length() != 5)    // File is missing crucial parts
     {
-        notify(QMessageBox::Critical, ERROR_TITLE, DB_ERROR, PIECES_ERROR);
-        this->clean();
-        this->hide();
-        return;
+        fail(DB_ERROR, PIECES_ERROR);
+        return false;
     }
     challenge = QByteArray::fromBase64(parts.at(0));    // Store the challenge, iv, and cipher from the file
     if (challenge.length() != YubiKey::MAX_HMAC_CHALLENGE_SIZE) // Challenge portion is invalid
     {
-        notify(QMessageBox::Critical, ERROR_TITLE, DB_ERROR, HMAC_ERROR);
-        this->clean();
-        this->hide();
-        return;
+        fail(DB_ERROR, HMAC_ERROR);
+        return false;
     }
     QByteArray salt = QByteArray::fromBase64(parts.at(1));
     if (salt.length() != SALT_SIZE) // Salt portion is invalid
     {
-        notify(QMessageBox::Critical, ERROR_TITLE, DB_ERROR, SALT_ERROR);
-        this->clean();
-        this->hide();
-        return;
+        fail(DB_ERROR, SALT_ERROR);
+        return false;
     }
     for (int i = 0; i < SALT_SIZE; i++) this->salt[i] = salt.at(i);
     QByteArray iters = QByteArray::fromBase64(parts.at(2));
     iterations = iters.toInt();
     if (iterations < 1)    // Iterations portion is invalid
     {
-        notify(QMessageBox::Critical, ERROR_TITLE, DB_ERROR, ITERATION_ERROR);
-        this->clean();
-        this->hide();
-        return;
+        fail(DB_ERROR, ITERATION_ERROR);
+        return false;
     }
     QByteArray iv = QByteArray::fromBase64(parts.at(3));
-    if (iv.length() != IV_SIZE) // Initialization vector is invalid
+    if (iv.length() != LEGACY_IV_SIZE) // Initialization vector is invalid
     {
-        notify(QMessageBox::Critical, ERROR_TITLE, DB_ERROR, IV_ERROR);
-        this->clean();
-        this->hide();
-        return;
+        fail(DB_ERROR, IV_ERROR);
+        return false;
     }
-    for (int i = 0; i < IV_SIZE; i++) this->iv[i] = iv.at(i);
+    for (int i = 0; i < LEGACY_IV_SIZE; i++) this->iv[i] = iv.at(i);
+    ivLength = LEGACY_IV_SIZE;
     cipher = QByteArray::fromBase64(parts.at(4)).toStdString();
     if (cipher.length() < 1)    // Ciphertext is invalid
     {
-        notify(QMessageBox::Critical, ERROR_TITLE, DB_ERROR, CIPHER_ERROR);
+        fail(DB_ERROR, CIPHER_ERROR);
+        return false;
+    }
+    payload = (const byte*) cipher.data();
+    payloadSize = cipher.length();
+    return true;    // Next save migrates the database to the binary format
+}
+
+void Authenticator::fail(const QString& text, const QString& detailText) { report(QMessageBox::Critical, text, detailText, true); } // Note an error that abandons the operation
+
+void Authenticator::report(QMessageBox::Icon icon, const QString& text, const QString& detailText, bool abandon) // Note an issue for the user, as the worker can't show it
+{
+    Report issue;
+    issue.icon = icon;
+    issue.text = text;
+    issue.detailText = detailText;
+    issue.abandon = abandon;
+    reports.append(issue);
+}
+
+void Authenticator::showReports()   // Show the issues noted during an operation, abandoning it if one was fatal
+{
+    QList<Report> shown = reports;
+    reports.clear();
+    bool failed = false, abandon = false;
+    foreach (const Report& issue, shown)
+    {
+        failed = failed || issue.abandon || issue.icon == QMessageBox::Critical;
+        abandon = abandon || issue.abandon;
+    }
+    if (failed) setStatus(FAILED);
+    foreach (const Report& issue, shown) notify(issue.icon, ERROR_TITLE, issue.text, issue.detailText);
+    if (abandon)
+    {
         this->clean();
         this->hide();
-        return;
     }
-    this->show();   // Show interface to user
 }
 
-void Authenticator::save(const QString& fileName, Database* db) // Encrypt a file
+void Authenticator::save(const QString& fileName, Database* db, bool keepKey) // Encrypt a file under new credentials, keeping the data key if it is unlocked
 {
+    abandonWork();  // Nothing below is changed from under the worker
     try
     {
         operationMode = ENCRYPT_MODE;
+        keepKey = keepKey && isUnlocked(fileName);
+        unlocked = false;
         this->fileName = fileName;
         this->db = db;
         byte challenge[YubiKey::MAX_HMAC_CHALLENGE_SIZE];
@@ -138,8 +309,10 @@ void Authenticator::save(const QString& fileName, Database* db) // Encrypt a fil
         prng.GenerateBlock(challenge, sizeof(challenge));   // Generate new random HMAC challenge each time!
         this->challenge.clear();
         for (int i = 0; i < YubiKey::MAX_HMAC_CHALLENGE_SIZE; i++) this->challenge.append(challenge[i]);
-        prng.GenerateBlock(iv, sizeof(iv)); // Generate new random IV each time!
+        prng.GenerateBlock(iv, VaultHeader::NONCE_SIZE);    // Generate new random IV each time!
+        ivLength = VaultHeader::NONCE_SIZE;
         prng.GenerateBlock(salt, sizeof(salt)); // Generate new random salt each time!
+        if (!keepKey) prng.GenerateBlock(key, key.size()); // A new file starts with its own data key
     }
     catch (CryptoPP::Exception& ex) //Catch if challenge and iv generation fail
     {
@@ -149,119 +322,694 @@ void Authenticator::save(const QString& fileName, Database* db) // Encrypt a fil
         this->hide();
         return;
     }
-    QJsonObject obj;
-    db->write(obj);
-    QJsonDocument doc(obj);
-    clear = doc.toJson().toStdString();
-    this->show();   // Continue process after user supplies password
+    int selected = ui->kdfComboBox->findData(KdfPolicy().preferredKdf());
+    ui->kdfComboBox->setCurrentIndex(selected < 0 ? 0 : selected);
+    ui->kdfComboBox->setEnabled(true);
+    this->show();   // Continue process after user supplies password, entries are serialized while encrypting
+}
+
+void Authenticator::formKey()   // Challenge the YubiKey, the operation continues once it answers
+{
+    if (!canChallenge || busy) return;
+    cancelled.store(0);
+    timedOut = false;
+    stage.store(CHALLENGE_STAGE);
+    setBusy(true);
+    yubikey->challenge(challenge);  // Answered in the background, however long the button takes
+}
+
+void Authenticator::challengeDone(const QByteArray& hmac)   // Combine the response with the password, and hand the rest to a worker thread
+{
+    if (!busy || stage.load() != CHALLENGE_STAGE) return;   // Another authenticator's challenge
+    yubikeyState->setText(yubikey->stateText());
+    if (yubikey->state() == YubiKey::NOT_PRESENT || yubikey->state() == YubiKey::TIMEOUT)
+    {
+        stage.store(IDLE_STAGE);
+        setBusy(false);
+        setStatus(WAITING);
+        notify(QMessageBox::Warning, ERROR_TITLE, YUBIKEY_ERROR, (yubikey->state() == YubiKey::NOT_PRESENT) ? YUBIKEY_PRESENT_ERROR : YUBIKEY_HMAC_ERROR);
+        return;
+    }
+    QByteArray password = ui->masterPasswordLineEdit->text().toUtf8();
+    response.New(hmac.size() + password.size());    // Only the locked copy outlives this call
+    memcpy(response.BytePtr(), hmac.constData(), hmac.size());
+    memcpy(response.BytePtr() + hmac.size(), password.constData(), password.size());
+    password.fill(0);
+    if (operationMode == ENCRYPT_MODE)
+    {
+        kdfType = ui->kdfComboBox->currentData().toInt();
+        snapshot(db);
+    }
+    startWork();
+}
+
+void Authenticator::startWork() // Run the key derivation and cipher work on a worker thread
+{
+    stage.store(compacting ? ENCRYPT_STAGE : DERIVE_STAGE);
+    progress.store(0);
+    updateProgress();
+    if (timeLimit() > 0) deadline.start(timeLimit() * 1000);
+    work.setFuture(QtConcurrent::run([this]() { return doWork(); }));
+}
+
+void Authenticator::abandonWork() // Stop any operation under way, waiting for the worker, whose result is then ignored
+{
+    if (work.isRunning())
+    {
+        cancelled.store(1);
+        work.waitForFinished(); // Quick, the key derivation and ciphers all check for the cancel
+    }
+    if (busy)
+    {
+        if (stage.load() == CHALLENGE_STAGE) yubikey->cancel();
+        stage.store(IDLE_STAGE);
+        setBusy(false);
+    }
+    deadline.stop();
+    upgrading = compacting = false;
 }
 
-void Authenticator::formKey()   // Create master key
+bool Authenticator::doWork()    // On the worker thread: derive the master key, then decrypt and decode, or encrypt, or only encrypt to compact
 {
-    if (canChallenge)
+    bool done;
+    if (compacting) return encrypt();   // The data key is already known
+    if (upgrading) done = deriveKey() && proceed() && wrapKey() && encrypt();
+    else if (operationMode == DECRYPT_MODE) done = deriveKey() && proceed() && unwrapKey() && decrypt() && readJournal() && (readOnly || !header.isLegacy() || newDataKey());  // Text files move to a data key
+    else
     {
-        setStatus(BUSY_YUBIKEY);
-        response = yubikey->hmacSHA1(challenge, true);
-        yubikeyState->setText(yubikey->stateText());
-        if (yubikey->state() == YubiKey::NOT_PRESENT)
+        KdfPolicy policy;
+        policy.setPreferredKdf(kdfType);
+        if (!policy.isCalibrated()) // Only the first save on this machine measures the KDFs
         {
-            notify(QMessageBox::Warning, ERROR_TITLE, YUBIKEY_ERROR, YUBIKEY_PRESENT_ERROR);
-            return;
+            stage.store(BENCHMARK_STAGE);
+            policy.benchmark();
+            stage.store(DERIVE_STAGE);
         }
-        else if (yubikey->state() == YubiKey::TIMEOUT)
+        applyPolicy(policy);
+        done = deriveKey() && proceed() && wrapKey() && encrypt();
+    }
+    memset(masterKey, 0, masterKey.size());
+    return done;
+}
+
+bool Authenticator::proceed() const { return !cancelled.load(); }   // Whether the worker should carry on, false once cancelled
+
+void Authenticator::workDone()  // Hand over the database, or report why not, once the worker is finished
+{
+    if (!busy || stage.load() == CHALLENGE_STAGE || work.isRunning()) return;   // Abandoned while the worker ran, and maybe another operation begun
+    deadline.stop();
+    bool done = work.result();
+    bool stopped = !done && cancelled.load();
+    stage.store(IDLE_STAGE);
+    setBusy(false);
+    if (stopped)
+    {
+        reports.clear();    // Whatever failed after the stop was caused by it
+        if (timedOut) report(QMessageBox::Critical, (operationMode == ENCRYPT_MODE || upgrading) ? ENCRYPT_ERROR : DECRYPT_ERROR, TIME_LIMIT_ERROR);
+        else setStatus(CANCELLED);
+    }
+    if (compacting)
+    {
+        compacting = false;
+        if (done)
         {
-            notify(QMessageBox::Warning, ERROR_TITLE, YUBIKEY_ERROR, YUBIKEY_HMAC_ERROR);
-            return;
+            db->commitChanges();
+            setStatus(COMPLETE);
         }
-        response.append(ui->masterPasswordLineEdit->text());
-        setStatus(BUSY_KEY);
-        CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA512> kdf;  // Derive master key from concatenation of user password and YubiKey response
-        if (operationMode == DECRYPT_MODE)
+        showReports();  // Stopped or failed, the file and the pending edits are left as they were
+        this->hide();
+        return;
+    }
+    if (upgrading)
+    {
+        upgrading = false;
+        if (done) staging->commitChanges(); // The rewritten snapshot holds every entry
+        handOver(); // Opened either way
+        if (done) setStatus(COMPLETE);
+        else
         {
-            kdf.DeriveKey(this->key, sizeof(key), 0, (byte*) response.data(), response.length(), this->salt, sizeof(salt), iterations, 0);  // Use recovered iteration count to derive key
-            if (!decrypt()) return;
-            db->read(QJsonDocument::fromJson(QByteArray::fromStdString(clear)).object());
+            showReports();
+            if (unlocked)   // Still open under the old parameters, which the file keeps
+            {
+                kdfType = previous.kdf();
+                iterations = previous.iterations();
+                memoryCost = previous.memoryCost();
+                lanes = previous.lanes();
+                memcpy(salt, previous.salt(), SALT_SIZE);
+                memcpy(keyNonce, previous.keyNonce(), sizeof(keyNonce));   // Rewrapped under the new master key before the rewrite failed
+                memcpy(wrappedKey, previous.wrappedKey(), sizeof(wrappedKey));
+                setStatus(COMPLETE);
+            }
         }
-        else
+        this->hide();
+        return;
+    }
+    if (!done)
+    {
+        showReports();
+        if (stopped)    // A cancelled open or save is given up, rather than tried again
         {
-            iterations =  kdf.DeriveKey(this->key, sizeof(key), 0, (byte*) response.data(), response.length(), this->salt, sizeof(salt), iterations, MIN_PBKDF_TIME);
-            if (!encrypt()) return;
-            QFile file(fileName);
-            QByteArray iv;
-            for (int i = 0; i < IV_SIZE; i++) iv.append(this->iv[i]);
-            QByteArray salt;
-            for (int i = 0; i < SALT_SIZE; i++) salt.append(this->salt[i]);
-            file.open(QIODevice::WriteOnly);
-            file.write(challenge.toBase64());
-            file.write(":");
-            file.write(salt.toBase64());
-            file.write(":");
-            file.write(QByteArray::number(iterations).toBase64());
-            file.write(":");
-            file.write(iv.toBase64());
-            file.write(":");
-            file.write(QByteArray::fromStdString(cipher).toBase64());
-            file.close();
+            this->clean();
+            this->hide();
         }
+        return;
+    }
+    if (operationMode == ENCRYPT_MODE)
+    {
+        db->commitChanges();
+        setStatus(COMPLETE);
         this->hide();
+        return;
+    }
+    releaseVault();
+    if (header.isLegacy()) staging->readJson(QJsonDocument::fromJson(QByteArray::fromRawData(clear.data(), (int) clear.size())).object());   // Records were decoded while decrypting
+    clear.assign(clear.length(), 0);
+    clear.clear();
+    unlocked = !readOnly;
+    setStatus(COMPLETE);
+    showReports();  // Only warnings remain, such as a torn journal
+    if (!readOnly && KdfPolicy().isWeak(kdfType, iterations, memoryCost) && offerUpgrade()) return;  // Handed over once rewritten
+    handOver();
+    this->hide();
+}
+
+void Authenticator::handOver()  // Swap the opened database into db and announce it, wiping the one it replaces
+{
+    db->swap(*staging);
+    staging->clear();
+    db->finishRead();
+}
+
+void Authenticator::updateProgress()    // Show the worker's stage and progress in the status bar
+{
+    int current = stage.load();
+    switch (current)
+    {
+        case CHALLENGE_STAGE: setStatus(BUSY_YUBIKEY); break;
+        case BENCHMARK_STAGE: setStatus(BENCHMARKING); break;
+        case DERIVE_STAGE: setStatus(BUSY_KEY); break;
+        case DECRYPT_STAGE: setStatus(DECRYPTING); break;
+        case ENCRYPT_STAGE: setStatus(ENCRYPTING); break;
+    }
+    bool measured = (current == DECRYPT_STAGE || current == ENCRYPT_STAGE);
+    progressBar->setRange(0, measured ? 100 : 0);   // Only a busy indicator while waiting on the YubiKey or the key derivation
+    if (measured) progressBar->setValue(progress.load());
+}
+
+void Authenticator::cancel()    // Abandon the operation, the worker stops at its next check
+{
+    if (!busy) return;
+    cancelled.store(1);
+    if (stage.load() != CHALLENGE_STAGE) return;    // The worker notices, and workDone gives up the operation
+    yubikey->cancel();
+    stage.store(IDLE_STAGE);
+    setBusy(false);
+    setStatus(CANCELLED);
+    this->clean();
+    this->hide();
+}
+
+void Authenticator::timeLimitReached()  // Cancel an operation that has run too long
+{
+    timedOut = true;
+    cancelled.store(1);
+}
+
+void Authenticator::setBusy(bool on)    // Lock the inputs and show progress while an operation is under way
+{
+    busy = on;
+    ui->masterPasswordLineEdit->setEnabled(!on);
+    ui->challengeButton->setEnabled(!on && canChallenge);
+    ui->slotOneRadioButton->setEnabled(!on);
+    ui->slotTwoRadioButton->setEnabled(!on);
+    ui->kdfComboBox->setEnabled(!on && operationMode == ENCRYPT_MODE);
+    progressBar->setVisible(on);
+    cancelButton->setVisible(on);
+    if (on)
+    {
+        ticker.start();
+        updateProgress();
+    }
+    else ticker.stop();
+}
+
+void Authenticator::closeEvent(QCloseEvent* event)  // Closing the window cancels any operation
+{
+    cancel();
+    if (busy) event->ignore();  // Still shown until the worker stops, and workDone hides it
+    else event->accept();
+}
+
+int Authenticator::timeLimit() const    // Configured seconds the worker may take, 0 for no limit
+{
+    int seconds = QSettings().value(TIME_LIMIT_KEY, DEFAULT_TIME_LIMIT).toInt();
+    return (seconds < 0) ? 0 : seconds;
+}
+
+void Authenticator::applyPolicy(const KdfPolicy& policy)    // Take this machine's calibrated cost for the selected KDF
+{
+    if (kdfType == VaultHeader::KDF_ARGON2ID)
+    {
+        iterations = policy.argon2Passes();
+        memoryCost = policy.argon2Memory();
+        lanes = policy.argon2Lanes();
+    }
+    else
+    {
+        iterations = policy.pbkdf2Iterations();
+        memoryCost = lanes = 0;
+    }
+}
+
+bool Authenticator::deriveKey() // Derive the master key with the selected KDF and cost
+{   // Key material is the concatenation of user password and YubiKey response
+    if (kdfType == VaultHeader::KDF_ARGON2ID)
+    {
+        Argon2 kdf(memoryCost, iterations, lanes);
+        kdf.setCancel(&cancelled);  // Cancel and the time limit stop it between slices
+        if (!kdf.deriveKey(masterKey, masterKey.size(), response.BytePtr(), response.size(), salt, sizeof(salt)))
+        {
+            if (proceed()) report(QMessageBox::Critical, (operationMode == ENCRYPT_MODE || upgrading) ? ENCRYPT_ERROR : DECRYPT_ERROR, MEMORY_ERROR);
+            return false;
+        }
+        return true;
+    }
+    Pbkdf2 kdf(response.BytePtr(), response.size());
+    kdf.setCancel(&cancelled);
+    return kdf.deriveKey(masterKey, masterKey.size(), salt, sizeof(salt), iterations) > 0;
+}
+
+bool Authenticator::offerUpgrade()   // Ask to rederive a weak vault's master key at the calibrated cost, and start rewriting it, false if it isn't
+{
+    QMessageBox msg;
+    msg.setWindowTitle(UPGRADE_TITLE);
+    msg.setIcon(QMessageBox::Question);
+    msg.setText(UPGRADE_QUESTION);
+    msg.setInformativeText(UPGRADE_DETAIL);
+    msg.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+    msg.setDefaultButton(QMessageBox::Yes);
+    if (msg.exec() != QMessageBox::Yes) return false;
+    previous = describe();  // Restored if the new key can't be derived, so the file stays openable
+    try
+    {
+        CryptoPP::AutoSeededRandomPool prng;
+        prng.GenerateBlock(salt, sizeof(salt)); // The YubiKey response is reused, so only the salt changes
+        prng.GenerateBlock(iv, VaultHeader::NONCE_SIZE);    // Generate new random IV each time!
+        ivLength = VaultHeader::NONCE_SIZE;
+    }
+    catch (CryptoPP::Exception& ex)
+    {
+        memcpy(salt, previous.salt(), SALT_SIZE);
+        notify(QMessageBox::Critical, ERROR_TITLE, ENCRYPT_ERROR, QString(ex.what()));
+        return false;
+    }
+    KdfPolicy policy;
+    kdfType = policy.preferredKdf();
+    applyPolicy(policy);
+    upgrading = true;
+    snapshot(staging);  // Rewriting also folds in the journal, which the new header no longer describes
+    cancelled.store(0);
+    timedOut = false;
+    setBusy(true);
+    startWork();
+    return true;
+}
+
+bool Authenticator::wrapKey()    // Seal the data key under the master key for the header
+{
+    try
+    {
+        CryptoPP::AutoSeededRandomPool prng;
+        prng.GenerateBlock(keyNonce, sizeof(keyNonce)); // Generate new random nonce for each wrapping!
+        QByteArray aad = describe().keyAssociatedData();
+        CryptoPP::GCM<CryptoPP::AES>::Encryption enc;
+        enc.SetKeyWithIV(masterKey, masterKey.size(), keyNonce, sizeof(keyNonce));
+        enc.EncryptAndAuthenticate(wrappedKey, wrappedKey + KEY_SIZE, TAG_SIZE, keyNonce, sizeof(keyNonce), (const byte*) aad.constData(), aad.size(), key, key.size());
+    }
+    catch (CryptoPP::Exception& ex)
+    {
+        fail(ENCRYPT_ERROR, QString(ex.what()));
+        return false;
+    }
+    return true;
+}
+
+bool Authenticator::unwrapKey() // Recover the data key with the master key, text files use the master key directly
+{
+    if (header.isLegacy())
+    {
+        memcpy(key, masterKey, key.size());
+        return true;
+    }
+    bool valid = false;
+    try
+    {
+        QByteArray aad = header.keyAssociatedData();
+        CryptoPP::GCM<CryptoPP::AES>::Decryption dec;
+        dec.SetKeyWithIV(masterKey, masterKey.size(), keyNonce, sizeof(keyNonce));
+        valid = dec.DecryptAndVerify(key, wrappedKey + KEY_SIZE, TAG_SIZE, keyNonce, sizeof(keyNonce), (const byte*) aad.constData(), aad.size(), wrappedKey, KEY_SIZE);
+    }
+    catch (CryptoPP::Exception& ex)
+    {
+        fail(DECRYPT_ERROR, QString(ex.what()));
+        return false;
+    }
+    if (!valid) // Wrong password or YubiKey, caught before touching the ciphertext
+    {
+        report(QMessageBox::Critical, DECRYPT_ERROR, INTEGRITY_ERROR);
+        return false;
+    }
+    return true;
+}
+
+bool Authenticator::newDataKey()    // Generate a random data key, wrapped under the master key
+{
+    try
+    {
+        CryptoPP::AutoSeededRandomPool prng;
+        prng.GenerateBlock(key, key.size());
+    }
+    catch (CryptoPP::Exception& ex)
+    {
+        fail(DECRYPT_ERROR, QString(ex.what()));
+        return false;
+    }
+    return wrapKey();
+}
+
+VaultHeader Authenticator::describe() const // Header for the current parameters, before the ciphertext length is known
+{
+    VaultHeader out;
+    out.setKdf(kdfType);
+    out.setMemoryCost(memoryCost);
+    out.setLanes(lanes);
+    out.setCipher(VaultHeader::CIPHER_AES256_GCM_CHUNKED);
+    out.setChunkSize(ChunkedCipher::CHUNK_SIZE);
+    out.setIterations(iterations);
+    out.setChallenge(challenge.constData());
+    out.setSalt((const char*) salt);
+    out.setNonce((const char*) iv);
+    out.setEncoding(VaultHeader::ENCODING_RECORDS);
+    int level = Compressor::configuredLevel();
+    out.setCompression((level == Compressor::NO_COMPRESSION) ? VaultHeader::COMPRESSION_NONE : VaultHeader::COMPRESSION_DEFLATE, level);
+    out.setKeyNonce((const char*) keyNonce);
+    out.setWrappedKey((const char*) wrappedKey);
+    return out;
+}
+
+bool Authenticator::isUnlocked(const QString& fileName) const { return unlocked && this->fileName == fileName; }  // Whether a save to this file can reuse the current data key
+
+void Authenticator::append(Database* db)    // Save only the edits since the last save, compacting when the journal grows large
+{
+    if (work.isRunning()) return;   // The edits stay pending for the next save
+    this->db = db;
+    cancelled.store(0); // An earlier cancel, such as of an upgrade, doesn't carry over
+    timedOut = false;
+    if (!db->hasChanges())
+    {
+        db->commitChanges();
+        return;
+    }
+    QByteArray batch;
+    db->writeChanges([&batch](const char* data, size_t length) -> bool
+    {
+        batch.append(data, (int) length);
+        return true;
+    });
+    QFile file(fileName);
+    bool journaled = !header.isLegacy() && db->canAppend() && file.open(QIODevice::ReadWrite) && file.size() == journalEnd;   // File still ends where the last save left it
+    if (journaled)
+    {
+        quint64 length = journalEnd - header.headerLength() - header.payloadLength();
+        journaled = length + Journal::segmentLength(batch.size(), header.chunkSize()) <= (quint64) journalLimit();
+    }
+    if (journaled) appendJournal(&file, batch);
+    else
+    {
+        file.close();
+        compact();
+    }
+    batch.fill(0);
+}
+
+bool Authenticator::readJournal()   // Apply the journal segments that follow the snapshot
+{
+    if (!proceed()) return false;
+    journalEnd = header.headerLength() + header.payloadLength();
+    journalSequence = 0;
+    if (header.isLegacy()) return true; // Text files end with the ciphertext
+    QByteArray changes;
+    bool parsed = true;
+    Journal::Status status = Journal::SEGMENT_END;
+    try
+    {
+        Journal journal(key, key.size(), header);
+        auto collect = [&changes](const byte* data, size_t length) -> bool
+        {
+            changes.append((const char*) data, (int) length);   // A segment holds the edits of one save, and is applied whole
+            return true;
+        };
+        while ((status = journal.next(vaultData, vaultSize, journalEnd, collect)) == Journal::SEGMENT_VALID)
+        {
+            parsed = staging->readChanges(changes.constData(), changes.size());
+            changes.fill(0);
+            changes.clear();
+            if (!parsed) break;
+        }
+        journalSequence = journal.sequence();
+    }
+    catch (CryptoPP::Exception& ex)
+    {
+        changes.fill(0);
+        staging->clear();
+        fail(DECRYPT_ERROR, QString(ex.what()));
+        return false;
+    }
+    changes.fill(0);
+    if (!parsed || status == Journal::SEGMENT_INVALID)   // The snapshot key was right, so the journal itself is damaged
+    {
+        staging->clear();
+        fail(DECRYPT_ERROR, parsed ? INTEGRITY_ERROR : RECORD_ERROR);
+        return false;
+    }
+    if (status == Journal::SEGMENT_TORN) report(QMessageBox::Warning, JOURNAL_TITLE, JOURNAL_TORN);    // The file no longer ends at journalEnd, so the next save compacts
+    return true;
+}
+
+int Authenticator::appendJournal(QFile* file, const QByteArray& batch)  // Seal a batch of edits as a new segment at the end of the file
+{
+    Journal journal(key, key.size(), header, journalSequence);
+    bool written;
+    try
+    {
+        written = file->seek(journalEnd) && journal.append(batch.constData(), batch.size(), file) && file->flush() && fsync(file->handle()) == 0;
+    }
+    catch (CryptoPP::Exception& ex)
+    {
+        file->resize(journalEnd);
+        notify(QMessageBox::Critical, ERROR_TITLE, ENCRYPT_ERROR, QString(ex.what()));
+        return false;
+    }
+    if (!written)
+    {
+        file->resize(journalEnd);   // Drop any partial segment, the edits stay pending for the next save
+        notify(QMessageBox::Critical, ERROR_TITLE, ENCRYPT_ERROR, WRITE_ERROR);
+        return false;
     }
+    journalEnd = file->pos();
+    journalSequence = journal.sequence();
+    db->commitChanges();
+    return true;
 }
 
+void Authenticator::compact()   // Start rewriting the snapshot under the current key on the worker, folding in the journal
+{
+    try
+    {
+        CryptoPP::AutoSeededRandomPool prng;
+        prng.GenerateBlock(iv, VaultHeader::NONCE_SIZE);    // Generate new random IV each time!
+        ivLength = VaultHeader::NONCE_SIZE;
+    }
+    catch (CryptoPP::Exception& ex)
+    {
+        notify(QMessageBox::Critical, ERROR_TITLE, ENCRYPT_ERROR, QString(ex.what()));
+        return;
+    }
+    operationMode = ENCRYPT_MODE;
+    snapshot(db);
+    compacting = true;
+    setBusy(true);
+    startWork();
+    this->show();   // Shows the progress, and being modal keeps edits the commit would drop from being made meanwhile
+}
+
+int Authenticator::journalLimit() const { return QSettings().value(JOURNAL_LIMIT_KEY, DEFAULT_JOURNAL_LIMIT).toInt(); }  // Configured journal size that triggers compaction
+
 void Authenticator::clean() // Reset authenticator and wipe any sensitive data
 {
-    for (int i = 0; i < CryptoPP::AES::MAX_KEYLENGTH; i++) key[i] = 0;
-    for (int i = 0; i < IV_SIZE; i++) iv[i] = 0;
+    abandonWork();  // Never wiped from under the worker
+    reports.clear();
+    staging->clear();   // Anything decoded that wasn't handed over
+    for (int i = 0; i < KEY_SIZE; i++) key[i] = masterKey[i] = 0;
+    memset(keyNonce, 0, sizeof(keyNonce));
+    memset(wrappedKey, 0, sizeof(wrappedKey));
+    for (int i = 0; i < LEGACY_IV_SIZE; i++) iv[i] = 0;
     for (int i = 0; i < SALT_SIZE; i++) salt[i] = 0;
+    memoryCost = lanes = 0;
+    header.clear();
+    releaseVault();
+    unlocked = false;
+    journalEnd = 0;
+    journalSequence = 0;
     challenge.fill(0);
-    response.fill(0);
+    response.New(0);   // Wiped as it is released
     clear.assign(clear.length(), 0);
     cipher.assign(cipher.length(), 0);
 }
 
-int Authenticator::encrypt()    // Perform authenticated AES-256 encryption in GCM-AE mode
+void Authenticator::snapshot(Database* from)    // Serialize a database on the GUI thread, so the worker never reads it while it can be edited
 {
+    clear.assign(clear.length(), 0);
+    clear.clear();
+    from->write([this](const char* data, size_t length) -> bool
+    {
+        clear.append(data, length);
+        return true;
+    });
+}
+
+int Authenticator::encrypt()    // Perform chunked authenticated AES-256 encryption in GCM-AE mode of the snapshot, compressing and streaming to the file
+{
+    stage.store(ENCRYPT_STAGE);
+    progress.store(0);
+    VaultHeader out = describe();   // Only describes the file once it is written
+    QSaveFile file(fileName);   // Only replaces the old file once everything is written
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        fail(ENCRYPT_ERROR, WRITE_ERROR);
+        return false;
+    }
+    bool written;
     try
     {
-        cipher.clear();
-        CryptoPP::GCM<CryptoPP::AES>::Encryption enc;
-        enc.SetKeyWithIV(key, sizeof(key), iv, sizeof(iv)); // Initialize cipher
-        CryptoPP::StringSource src(clear, true, new CryptoPP::AuthenticatedEncryptionFilter(enc, new CryptoPP::StringSink(cipher), false, TAG_SIZE));   // Run cleartext through
+        file.write(out.serialize());    // Rewritten below once the ciphertext length is known
+        ChunkedCipher enc(key, key.size(), out.nonce(), out.associatedData());
+        Compressor::Sink seal = [&enc, &file](const char* data, size_t length) { return enc.put(data, length, &file); };
+        auto feed = [this](const Compressor::Sink& sink) -> bool    // A chunk at a time, so progress shows and cancelling stops it
+        {
+            for (size_t done = 0; done < clear.size(); done += ChunkedCipher::CHUNK_SIZE)
+            {
+                if (!proceed()) return false;
+                size_t length = qMin((size_t) ChunkedCipher::CHUNK_SIZE, clear.size() - done);
+                if (!sink(clear.data() + done, length)) return false;
+                progress.store((int) ((done + length) * 100 / clear.size()));
+            }
+            return true;
+        };
+        if (out.compression() == VaultHeader::COMPRESSION_DEFLATE)
+        {
+            Compressor deflate(out.compressionLevel(), seal);
+            written = feed([&deflate](const char* data, size_t length) { return deflate.put(data, length); }) && deflate.finish();
+        }
+        else written = feed(seal);
+        written = written && enc.finish(&file);
+        out.setPayloadLength(enc.written());
+        written = written && file.seek(0) && file.write(out.serialize()) == VaultHeader::HEADER_SIZE && file.commit();
     }
     catch (CryptoPP::Exception& ex)
     {
-        setStatus(FAILED);
-        notify(QMessageBox::Critical, ERROR_TITLE, ENCRYPT_ERROR, QString(ex.what()));
-        this->clean();
-        this->hide();
+        clear.assign(clear.length(), 0);
+        clear.clear();
+        fail(ENCRYPT_ERROR, QString(ex.what()));
         return false;
     }
-    setStatus(COMPLETE);
+    clear.assign(clear.length(), 0);
+    clear.clear();
+    if (!written)
+    {
+        if (proceed()) fail(ENCRYPT_ERROR, WRITE_ERROR);    // Cancelled, the old file is left as it was
+        return false;
+    }
+    header = out;
+    unlocked = true;    // Later saves append to this snapshot
+    journalEnd = header.headerLength() + header.payloadLength();
+    journalSequence = 0;
     return true;
 }
 
 int Authenticator::decrypt()    // Perform authenticated AES-256 decryption in GCM-AE mode
 {
+    stage.store(DECRYPT_STAGE);
+    progress.store(0);
+    if (header.cipher() == VaultHeader::CIPHER_AES256_GCM_CHUNKED) return decryptChunks();
     try
     {
         clear.clear();
         CryptoPP::GCM<CryptoPP::AES>::Decryption dec;
-        dec.SetKeyWithIV(key, sizeof(key), iv, sizeof(iv)); // Initialize cipher
-        CryptoPP::AuthenticatedDecryptionFilter adf(dec, new CryptoPP::StringSink(clear), CryptoPP::AuthenticatedDecryptionFilter::DEFAULT_FLAGS, TAG_SIZE);    // Initialize authentication filter
-        CryptoPP::StringSource src(cipher, true, new CryptoPP::Redirector(adf));    // Redirector feeds cipher into authenticator
+        dec.SetKeyWithIV(key, key.size(), iv, ivLength); // Initialize cipher
+        CryptoPP::AuthenticatedDecryptionFilter adf(dec, new CryptoPP::StringSinkTemplate<SecureString>(clear), CryptoPP::AuthenticatedDecryptionFilter::DEFAULT_FLAGS, TAG_SIZE);    // Initialize authentication filter
+        CryptoPP::ArraySource src(payload, payloadSize, true, new CryptoPP::Redirector(adf));    // Redirector feeds cipher into authenticator
     }
     catch (CryptoPP::Exception& ex) // Will catch if integrity check fails, or other issue
     {
-        setStatus(FAILED);
-        if (ex.GetErrorType() == CryptoPP::Exception::DATA_INTEGRITY_CHECK_FAILED) notify(QMessageBox::Critical, ERROR_TITLE, DECRYPT_ERROR, INTEGRITY_ERROR);
-        else    // Some other odd exception
+        if (ex.GetErrorType() == CryptoPP::Exception::DATA_INTEGRITY_CHECK_FAILED) report(QMessageBox::Critical, DECRYPT_ERROR, INTEGRITY_ERROR);
+        else report(QMessageBox::Warning, DECRYPT_ERROR, QString(ex.what()), true);  // Some other odd exception
+        return false;
+    }
+    return true;
+}
+
+int Authenticator::decryptChunks()  // Perform chunked authenticated AES-256 decryption in GCM-AE mode, straight from the mapped file, then decompress
+{
+    bool parsed = true;
+    bool valid;
+    staging->beginRead(payloadSize);    // Cleartext is about the ciphertext size, so the entry arena is sized once
+    try
+    {
+        ChunkedCipher dec(key, key.size(), header.nonce(), header.associatedData(), header.chunkSize());
+        Compressor::Sink consume = [this, &parsed](const char* data, size_t length) -> bool
         {
-            notify(QMessageBox::Warning, ERROR_TITLE, DECRYPT_ERROR, QString(ex.what()));
-            this->clean();
-            this->hide();
-        }
+            return parsed = staging->readChunk(data, length);   // Entries are decoded as each chunk is authenticated
+        };
+        Decompressor inflate(consume);
+        bool deflated = (header.compression() == VaultHeader::COMPRESSION_DEFLATE);
+        quint64 done = 0;
+        valid = dec.decrypt(payload, payloadSize, [this, &consume, &inflate, &parsed, &done, deflated](const byte* data, size_t length) -> bool
+        {
+            if (!proceed()) return false;   // Checked between chunks
+            done += length;
+            progress.store((int) qMin((quint64) 100, done * 100 / payloadSize));
+            if (!deflated) return consume((const char*) data, length);
+            if (inflate.put((const char*) data, length)) return true;
+            parsed = false; // Authentic, so the compressed stream itself is malformed
+            return false;
+        });
+        if (valid && deflated && !inflate.finish()) parsed = false;
+        if (valid && parsed) parsed = staging->endRead();
+    }
+    catch (CryptoPP::Exception& ex)
+    {
+        staging->clear();
+        fail(DECRYPT_ERROR, QString(ex.what()));
+        return false;
+    }
+    if (!proceed()) // Cancelled part way, nothing read is kept
+    {
+        staging->clear();
+        return false;
+    }
+    if (!parsed)    // Authentic, but not something this version understands
+    {
+        staging->clear();
+        fail(DECRYPT_ERROR, RECORD_ERROR);
+        return false;
+    }
+    if (!valid) // Tag mismatch or a missing final chunk
+    {
+        staging->clear();
+        report(QMessageBox::Critical, DECRYPT_ERROR, INTEGRITY_ERROR);
         return false;
     }
-    setStatus(COMPLETE);
     return true;
 }
 
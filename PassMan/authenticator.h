@@ -3,7 +3,9 @@
  *              Handles secure file encryption/decryption operations.
  *              Utilizes AES-256 in GCM-AE mode.
  *              Two factors are used for the key: A user password, and their YubiKey's HMAC-SHA1 response.
- *              They are combined to a single master key via PBKDF2-SHA512.
+ *              They are combined to a single master key via Argon2id or PBKDF2-SHA512, which wraps a random data key.
+ *              Saves while a database is unlocked reuse the data key, so only opening or changing credentials derives a key.
+ *              The YubiKey is answered, and the key derived and the file decrypted or encrypted, without blocking the interface.
  * Author:      Adam Coffee
  * Licensed under the three-clause BSD license, found in the LICENSE file.
  */
@@ -15,16 +17,34 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QFile>
+#include <QSaveFile>
 #include <QLabel>
 #include <QMessageBox>
+#include <QSettings>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QTimer>
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QtConcurrent>
+#include <QCloseEvent>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <crypto++/osrng.h>
 #include <crypto++/filters.h>
 #include <crypto++/aes.h>
 #include <crypto++/gcm.h>
 #include <crypto++/cryptlib.h>
-#include <crypto++/pwdbased.h>
 #include "yubikey.h"
 #include "database.h"
+#include "vaultheader.h"
+#include "chunkedcipher.h"
+#include "journal.h"
+#include "argon2.h"
+#include "pbkdf2.h"
+#include "kdfpolicy.h"
+#include "compressor.h"
+#include "securememory.h"
 #include <QDebug> //TESTING!
 
 namespace Ui
@@ -40,8 +60,10 @@ class Authenticator : public QMainWindow
         explicit Authenticator(YubiKey* yk, QWidget *parent = 0);
         ~Authenticator();
 
-        void open(const QString& filename, Database* db);    // Decrypt a file
-        void save(const QString& filename, Database* db);    // Encrypt a file
+        void open(const QString& filename, Database* db, bool readOnly = false);    // Decrypt a file, a read-only one is never upgraded nor left unlocked for saves
+        void save(const QString& filename, Database* db, bool keepKey = false); // Encrypt a file under new credentials, keeping the data key if it is unlocked
+        void append(Database* db);  // Save only the edits since the last save, compacting when the journal grows large
+        bool isUnlocked(const QString& filename) const; // Whether a save to this file can reuse the current data key
         void clean();   // Reset authenticator and wipe any sensitive data
 
     private slots:
@@ -51,36 +73,117 @@ class Authenticator : public QMainWindow
         void on_masterPasswordLineEdit_returnPressed();
         void on_slotOneRadioButton_clicked();
         void on_slotTwoRadioButton_clicked();
+        void challengeDone(const QByteArray& hmac); // Combine the response with the password, and hand the rest to a worker thread
+        void workDone();    // Hand over the database, or report why not, once the worker is finished
+        void updateProgress();  // Show the worker's stage and progress in the status bar
+        void cancel();  // Abandon the operation, the worker stops at its next check
+        void timeLimitReached();    // Cancel an operation that has run too long
 
 private:
         static const char FILE_PORTION_SEPARATOR;   // Commonly used values
-        static const double MIN_PBKDF_TIME;
         static const int TAG_SIZE, DECRYPT_MODE, ENCRYPT_MODE;
-        static const int IV_SIZE = CryptoPP::AES::BLOCKSIZE * 16;   // Bytes in tag for GCM-AE
-        static const int SALT_SIZE = 16;
-        static const QString WAITING, BUSY_YUBIKEY, BUSY_KEY, COMPLETE, FAILED, ERROR_TITLE, ENCRYPT_ERROR, DECRYPT_ERROR,
+        static const int KEY_SIZE = VaultHeader::DATA_KEY_SIZE;
+        static const int LEGACY_IV_SIZE = CryptoPP::AES::BLOCKSIZE * 16;    // Bytes in IV of the original text file format
+        static const int SALT_SIZE = VaultHeader::SALT_SIZE;
+        static const int DEFAULT_JOURNAL_LIMIT = 1024 * 1024;   // Journal bytes allowed before the snapshot is rewritten
+        static const int DEFAULT_TIME_LIMIT = 120;  // Seconds the worker may take once the YubiKey has answered, when none is configured
+        static const int PROGRESS_INTERVAL = 100;   // Milliseconds between progress updates
+        static const QString JOURNAL_LIMIT_KEY, TIME_LIMIT_KEY, ARGON2_NAME, PBKDF2_NAME;
+        static const QString WAITING, BUSY_YUBIKEY, BUSY_KEY, BENCHMARKING, DECRYPTING, ENCRYPTING, CANCEL, CANCELLED, COMPLETE, FAILED,
+                             ERROR_TITLE, ENCRYPT_ERROR, DECRYPT_ERROR,
                              DB_ERROR, FILE_ERROR, PIECES_ERROR, HMAC_ERROR, IV_ERROR, CIPHER_ERROR, INTEGRITY_ERROR,
-                             YUBIKEY_ERROR, YUBIKEY_HMAC_ERROR, YUBIKEY_PRESENT_ERROR, SALT_ERROR, ITERATION_ERROR;
+                             YUBIKEY_ERROR, YUBIKEY_HMAC_ERROR, YUBIKEY_PRESENT_ERROR, SALT_ERROR, ITERATION_ERROR,
+                             VERSION_ERROR, PARAMETER_ERROR, WRITE_ERROR, RECORD_ERROR, JOURNAL_TITLE, JOURNAL_TORN, MEMORY_ERROR,
+                             TIME_LIMIT_ERROR, UPGRADE_TITLE, UPGRADE_QUESTION, UPGRADE_DETAIL;
+        enum Stage { IDLE_STAGE, CHALLENGE_STAGE, BENCHMARK_STAGE, DERIVE_STAGE, DECRYPT_STAGE, ENCRYPT_STAGE };  // Step an operation is on
+        struct Report   // Issue found during an operation, shown once back on the GUI thread
+        {
+            QMessageBox::Icon icon;
+            QString text;
+            QString detailText;
+            bool abandon;   // Whether the operation is given up, rather than left open to try again
+        };
         Ui::Authenticator *ui;
         YubiKey* yubikey;
         Database* db;
+        Database* staging;  // Decoded into by the worker, and only swapped into db once the file has opened
         QLabel* yubikeyState;
+        QProgressBar* progressBar;
+        QPushButton* cancelButton;
         bool canChallenge;
+        bool busy;  // Whether an operation is under way, from the challenge until the worker is done
+        bool upgrading; // Whether the worker is rewriting a just opened file at a stronger key derivation
+        bool compacting;    // Whether the worker is rewriting an unlocked file's snapshot, which needs no key derivation
+        bool timedOut;
+        QFutureWatcher<bool> work;  // Key derivation and cipher work, run on a worker thread
+        QTimer ticker;  // Polls the worker's progress
+        QTimer deadline;    // Cancels work that runs past the time limit
+        QAtomicInt stage;   // Shared with the worker, which touches no widgets
+        QAtomicInt progress;    // Percent of the file decrypted or encrypted
+        QAtomicInt cancelled;
+        QList<Report> reports;  // Issues noted since they were last shown
+        VaultHeader previous;   // Parameters to fall back to if an upgrade fails
         QString fileName;
+        VaultHeader header; // Parameters of the file being opened or saved
+        QFile vault;    // File being opened, kept mapped until decrypted
+        const char* vaultData;
+        qint64 vaultSize;
+        QByteArray vaultCopy;   // Only used where the file can't be mapped
         bool operationMode; // Whether in decryption or encryption mode
+        bool readOnly;  // Whether the file being opened is only read, such as a copy being merged in
+        bool unlocked;  // Whether the data key and header describe fileName, so later saves can reuse them
+        qint64 journalEnd;  // File size after the snapshot and its journal segments
+        quint64 journalSequence;    // Number of journal segments in the file
 
-        byte key[CryptoPP::AES::MAX_KEYLENGTH]; // Crypto-related values
-        byte iv[IV_SIZE];
+        SecureBlock key;    // Crypto-related values, the data key encrypting the file
+        SecureBlock masterKey;  // Derived from the credentials, only held while wrapping or unwrapping the data key
+        byte keyNonce[VaultHeader::NONCE_SIZE];
+        byte wrappedKey[VaultHeader::WRAPPED_KEY_SIZE];
+        byte iv[LEGACY_IV_SIZE];    // Large enough for either file format's IV
+        int ivLength;
         byte salt[SALT_SIZE];
-        int iterations;
+        int kdfType;
+        int iterations; // PBKDF2 iterations, or Argon2id passes
+        quint32 memoryCost; // Argon2id memory in KiB
+        quint32 lanes;
         QByteArray challenge;
-        QByteArray response;
-        std::string clear;
-        std::string cipher;
+        SecureBlock response;   // YubiKey response followed by the password, the KDF's input
+        SecureString clear; // Cleartext of files that aren't decoded as it is decrypted, or of the snapshot being encrypted
+        std::string cipher; // Ciphertext decoded from an original text file
+        const byte* payload;    // Ciphertext to decrypt, within the mapping or the decoded text
+        quint64 payloadSize;
 
-        void formKey(); // Create master key and do operation
-        int encrypt();  // Perform authenticated AES-256 encryption in GCM-AE mode
+        bool mapVault();    // Map the file read-only, so the header and ciphertext are used in place
+        void releaseVault();    // Unmap and close the file
+        bool readVault();   // Validate the binary file header in place
+        bool readLegacy();  // Load parameters and ciphertext from an original text file
+        bool readJournal(); // Apply the journal segments that follow the snapshot
+        int appendJournal(QFile* file, const QByteArray& batch);    // Seal a batch of edits as a new segment at the end of the file
+        void compact(); // Start rewriting the snapshot under the current key on the worker, folding in the journal
+        int journalLimit() const;   // Configured journal size that triggers compaction
+        void fail(const QString& text, const QString& detailText);  // Note an error that abandons the operation
+        void report(QMessageBox::Icon icon, const QString& text, const QString& detailText, bool abandon = false);  // Note an issue for the user, as the worker can't show it
+        void showReports(); // Show the issues noted during an operation, abandoning it if one was fatal
+        void formKey(); // Challenge the YubiKey, the operation continues once it answers
+        void startWork();   // Run the key derivation and cipher work on a worker thread
+        void abandonWork(); // Stop any operation under way, waiting for the worker, whose result is then ignored
+        bool doWork();  // On the worker thread: derive the master key, then decrypt and decode, or encrypt, or only encrypt to compact
+        bool proceed() const;   // Whether the worker should carry on, false once cancelled
+        void setBusy(bool on);  // Lock the inputs and show progress while an operation is under way
+        void closeEvent(QCloseEvent* event);    // Closing the window cancels any operation
+        int timeLimit() const;  // Configured seconds the worker may take, 0 for no limit
+        void applyPolicy(const KdfPolicy& policy);  // Take this machine's calibrated cost for the selected KDF
+        bool deriveKey();   // Derive the master key with the selected KDF and cost
+        bool offerUpgrade();    // Ask to rederive a weak vault's master key at the calibrated cost, and start rewriting it, false if it isn't
+        void snapshot(Database* from);  // Serialize a database on the GUI thread, so the worker never reads it while it can be edited
+        void handOver();    // Swap the opened database into db and announce it, wiping the one it replaces
+        bool wrapKey(); // Seal the data key under the master key for the header
+        bool unwrapKey();   // Recover the data key with the master key, text files use the master key directly
+        bool newDataKey();  // Generate a random data key, wrapped under the master key
+        VaultHeader describe() const;   // Header for the current parameters, before the ciphertext length is known
+        int encrypt();  // Perform chunked authenticated AES-256 encryption in GCM-AE mode of the snapshot, compressing and streaming to the file
         int decrypt();  // Perform authenticated AES-256 decryption in GCM-AE mode
+        int decryptChunks();    // Perform chunked authenticated AES-256 decryption in GCM-AE mode, straight from the mapped file, then decompress
         void setStatus(const QString& status);  // Set authenticator status
         int notify(QMessageBox::Icon, const QString& title, const QString& text, const QString& detailText);    // Notify user of some issue
 };
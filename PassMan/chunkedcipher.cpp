@@ -0,0 +1,104 @@
+/*
+ * Description: Implementation of the ChunkedCipher class.
+ *              Streams authenticated AES-256 GCM-AE encryption/decryption over fixed-size chunks.
+ *              Each chunk carries its own tag, and its nonce is derived from the chunk counter and a final-chunk flag.
+ *              Memory use is bounded by one chunk, and truncation or reordering of chunks is detected.
+ *              Ciphertext is read in place, so a mapped file is decrypted without intermediate copies.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Chunk nonce: 7-byte random prefix | 32-bit big-endian chunk counter | final flag (1 on the last chunk, else 0)
+ * Chunk layout: ciphertext (same length as the cleartext) | 16-byte tag
+ */
+
+#include "chunkedcipher.h"
+#include <cstring>
+
+ChunkedCipher::ChunkedCipher(const byte* key, size_t keyLength, const char* nonce, const QByteArray& aad, int chunkSize)
+    : associated(aad), counter(0), chunk(chunkSize), total(0), pending(chunkSize), pendingLength(0), buffer(chunkSize + TAG_SIZE)
+{
+    memcpy(prefix, nonce, PREFIX_SIZE);
+    byte first[NONCE_SIZE];
+    chunkNonce(first, false);
+    enc.SetKeyWithIV(key, keyLength, first, NONCE_SIZE);    // Key schedule and GHASH tables are set up once, each chunk only resynchronizes
+    dec.SetKeyWithIV(key, keyLength, first, NONCE_SIZE);
+}
+
+ChunkedCipher::~ChunkedCipher() { associated.fill(0); }
+
+void ChunkedCipher::chunkNonce(byte* nonce, bool final) const   // Derive the nonce of the current chunk
+{
+    memcpy(nonce, prefix, PREFIX_SIZE);
+    nonce[PREFIX_SIZE] = (byte) (counter >> 24);
+    nonce[PREFIX_SIZE + 1] = (byte) (counter >> 16);
+    nonce[PREFIX_SIZE + 2] = (byte) (counter >> 8);
+    nonce[PREFIX_SIZE + 3] = (byte) counter;
+    nonce[PREFIX_SIZE + 4] = final ? 1 : 0;
+}
+
+bool ChunkedCipher::put(const char* data, size_t length, QIODevice* out)   // Buffer cleartext, sealing and writing each completed chunk
+{
+    while (length > 0)
+    {
+        if (pendingLength == (size_t) chunk && !seal(false, out)) return false; // A full chunk is only sealed once more data shows it isn't the last
+        size_t n = qMin(length, chunk - pendingLength);
+        memcpy(pending.BytePtr() + pendingLength, data, n);
+        pendingLength += n;
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool ChunkedCipher::finish(QIODevice* out) { return seal(true, out); }  // Seal and write the final chunk
+
+quint64 ChunkedCipher::written() const { return total; }    // Ciphertext bytes written so far
+
+bool ChunkedCipher::seal(bool final, QIODevice* out)    // Encrypt the pending cleartext as one chunk
+{
+    if (counter == 0xFFFFFFFF) return false;    // Nonce space exhausted
+    byte nonce[NONCE_SIZE];
+    chunkNonce(nonce, final);
+    enc.EncryptAndAuthenticate(buffer.BytePtr(), buffer.BytePtr() + pendingLength, TAG_SIZE, nonce, NONCE_SIZE,
+                               (const byte*) associated.constData(), associated.size(), pending.BytePtr(), pendingLength);
+    qint64 n = pendingLength + TAG_SIZE;
+    if (out->write((const char*) buffer.BytePtr(), n) != n) return false;
+    total += n;
+    counter++;
+    pendingLength = 0;
+    return true;
+}
+
+bool ChunkedCipher::decrypt(const byte* in, quint64 length, const Sink& sink)  // Authenticate and decrypt a payload in place
+{
+    counter = 0;
+    quint64 remaining = length;
+    const quint64 sealed = chunk + TAG_SIZE;
+    do
+    {
+        size_t n = (size_t) qMin(remaining, sealed);
+        if (n < (size_t) TAG_SIZE) return false;    // Not even room for a tag
+        remaining -= n;
+        if (!open(in, n, remaining == 0, sink)) return false;
+        in += n;
+    } while (remaining > 0);
+    return true;
+}
+
+bool ChunkedCipher::open(const byte* in, size_t length, bool final, const Sink& sink) // Authenticate and decrypt one chunk
+{
+    byte nonce[NONCE_SIZE];
+    chunkNonce(nonce, final);   // A dropped tail leaves a non-final chunk last, which then fails to authenticate
+    size_t clearLength = length - TAG_SIZE;
+    bool valid = dec.DecryptAndVerify(pending.BytePtr(), in + clearLength, TAG_SIZE, nonce, NONCE_SIZE,
+                                      (const byte*) associated.constData(), associated.size(), in, clearLength);
+    counter++;
+    if (!valid) return false;
+    return sink(pending.BytePtr(), clearLength);
+}
+
+quint64 ChunkedCipher::cipherLength(quint64 clearLength, int chunkSize) // Ciphertext size for a given cleartext size
+{
+    quint64 chunks = (clearLength == 0) ? 1 : (clearLength + chunkSize - 1) / chunkSize;
+    return clearLength + chunks * TAG_SIZE;
+}
@@ -0,0 +1,56 @@
+/*
+ * Description: Definition of the ChunkedCipher class.
+ *              Streams authenticated AES-256 GCM-AE encryption/decryption over fixed-size chunks.
+ *              Each chunk carries its own tag, and its nonce is derived from the chunk counter and a final-chunk flag.
+ *              Memory use is bounded by one chunk, and truncation or reordering of chunks is detected.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef CHUNKEDCIPHER_H
+#define CHUNKEDCIPHER_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <functional>
+#include <crypto++/aes.h>
+#include <crypto++/gcm.h>
+#include <crypto++/secblock.h>
+#include "securememory.h"
+
+class ChunkedCipher
+{
+    public:
+        typedef std::function<bool(const byte* data, size_t length)> Sink;  // Receives each decrypted chunk, returns false to stop
+        static const int CHUNK_SIZE = 64 * 1024;    // Default cleartext bytes per chunk
+        static const int TAG_SIZE = 16;
+        static const int NONCE_SIZE = 12;
+        static const int PREFIX_SIZE = 7;   // Random nonce bytes shared by all chunks, followed by counter and flag
+
+        ChunkedCipher(const byte* key, size_t keyLength, const char* nonce, const QByteArray& aad, int chunkSize = CHUNK_SIZE);
+        ~ChunkedCipher();
+
+        bool put(const char* data, size_t length, QIODevice* out); // Buffer cleartext, sealing and writing each completed chunk
+        bool finish(QIODevice* out);    // Seal and write the final chunk
+        quint64 written() const;    // Ciphertext bytes written so far
+        bool decrypt(const byte* in, quint64 length, const Sink& sink); // Authenticate and decrypt a payload in place
+        static quint64 cipherLength(quint64 clearLength, int chunkSize = CHUNK_SIZE);   // Ciphertext size for a given cleartext size
+
+    private:
+        CryptoPP::GCM<CryptoPP::AES>::Encryption enc;
+        CryptoPP::GCM<CryptoPP::AES>::Decryption dec;
+        QByteArray associated;
+        byte prefix[PREFIX_SIZE];
+        quint32 counter;
+        int chunk;
+        quint64 total;
+        SecureBlock pending; // Cleartext waiting to be sealed
+        size_t pendingLength;
+        SecureBlock buffer;  // Working space for sealing one chunk
+
+        void chunkNonce(byte* nonce, bool final) const; // Derive the nonce of the current chunk
+        bool seal(bool final, QIODevice* out);  // Encrypt the pending cleartext as one chunk
+        bool open(const byte* in, size_t length, bool final, const Sink& sink); // Authenticate and decrypt one chunk
+};
+
+#endif // CHUNKEDCIPHER_H
@@ -0,0 +1,58 @@
+/*
+ * Description: Implementation of the Chunker class.
+ *              Finds content-defined chunk boundaries (FastCDC), so a file is split at the same places wherever its bytes sit.
+ *              An edit only changes the chunks around it, and the same file always splits into the same chunks.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * A gear hash rolls over the bytes, shifting left and adding a random value for each byte, so its top bits depend on
+ * the last 64 bytes only.  A boundary falls where the top bits under a mask are all zero.  The first MIN_SIZE bytes of
+ * a chunk aren't searched, a stricter mask applies until the average size and a looser one after it, which keeps most
+ * chunks close to the average, and MAX_SIZE bounds the rest.  The gear table comes from a fixed seed, as changing it
+ * would move every boundary and stop new chunks matching the ones already stored.
+ */
+
+#include "chunker.h"
+
+int Chunker::boundary(const byte* data, int length) // Length of the chunk starting here, given at least MAX_SIZE bytes unless the data ends sooner
+{
+    if (length <= MIN_SIZE) return length;
+    const quint64* table = gear();
+    int normal = qMin(length, (int) AVERAGE_SIZE);
+    int end = qMin(length, (int) MAX_SIZE);
+    quint64 hash = 0;
+    int i = MIN_SIZE;
+    for (; i < normal; i++)
+    {
+        hash = (hash << 1) + table[data[i]];
+        if (!(hash & STRICT_MASK)) return i + 1;
+    }
+    for (; i < end; i++)
+    {
+        hash = (hash << 1) + table[data[i]];
+        if (!(hash & LOOSE_MASK)) return i + 1;
+    }
+    return end;
+}
+
+const quint64* Chunker::gear()  // Random value for each byte value, the same in every build
+{
+    struct Table
+    {
+        quint64 values[256];
+
+        Table()
+        {
+            quint64 state = 0x5061737344616E21ull;  // SplitMix64 from a fixed seed
+            for (int b = 0; b < 256; b++)
+            {
+                quint64 z = (state += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                values[b] = z ^ (z >> 31);
+            }
+        }
+    };
+    static const Table table;   // Built once, on first use
+    return table.values;
+}
@@ -0,0 +1,31 @@
+/*
+ * Description: Definition of the Chunker class.
+ *              Finds content-defined chunk boundaries (FastCDC), so a file is split at the same places wherever its bytes sit.
+ *              An edit only changes the chunks around it, and the same file always splits into the same chunks.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <QtGlobal>
+#include <crypto++/secblock.h>
+
+class Chunker
+{
+    public:
+        static const int MIN_SIZE = 2 * 1024;   // Bytes before a boundary is looked for
+        static const int AVERAGE_SIZE = 8 * 1024;
+        static const int MAX_SIZE = 64 * 1024;  // Boundary forced where none is found
+
+        static int boundary(const byte* data, int length);  // Length of the chunk starting here, given at least MAX_SIZE bytes unless the data ends sooner
+
+    private:
+        static const quint64 STRICT_MASK = 0xFFFE000000000000ull;   // 15 bits, below the average size
+        static const quint64 LOOSE_MASK = 0xFFE0000000000000ull;    // 11 bits, past it
+
+        static const quint64* gear();   // Random value for each byte value, the same in every build
+};
+
+#endif // CHUNKER_H
@@ -0,0 +1,98 @@
+/*
+ * Description: Implementation of the ChunkStore class.
+ *              Holds the contents of attached files as sealed chunks, each addressed by the digest of its contents.
+ *              A chunk is held once however many attachments use it, so copies and edited versions of a file share storage.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Chunk record: digest | sealed chunk, under SEALED_FIELD or DEFLATED_FIELD
+ * The digest is BLAKE2b-256 of the chunk's contents before compression and sealing, so putting a chunk that is already
+ * held costs one hash and nothing else.  Chunks are sealed like notes, compressed first when that makes them smaller,
+ * and only decrypted one at a time as an attachment is written out.  The store doesn't count references: a chunk no
+ * entry uses any more is simply left out of the next snapshot, and is gone once the database is read again.
+ */
+
+#include "chunkstore.h"
+
+ChunkStore::ChunkStore() { }
+
+ChunkStore::~ChunkStore() { clear(); }
+
+QByteArray ChunkStore::put(const char* data, int length, const FieldCipher& cipher, int level) // Seal a chunk unless one with the same contents is held, returning its digest
+{
+    QByteArray digest(DIGEST_SIZE, 0);
+    CryptoPP::BLAKE2b hash(false, DIGEST_SIZE);
+    hash.Update((const byte*) data, length);
+    hash.Final((byte*) digest.data());
+    if (chunks.contains(digest)) return digest; // Already held, whichever attachment brought it
+    Chunk chunk;
+    SecureBlock packed;
+    chunk.deflated = Compressor::compress(data, length, level, packed);
+    if (chunk.deflated) chunk.sealed = cipher.seal((const char*) packed.BytePtr(), (int) packed.size(), EntryStore::DEFLATED_CHUNK_FIELD);
+    else chunk.sealed = cipher.seal(data, length, EntryStore::CHUNK_FIELD);
+    chunk.stored = false;
+    chunks.insert(digest, chunk);
+    return digest;
+}
+
+bool ChunkStore::get(const QByteArray& digest, const FieldCipher& cipher, SecureBlock& clear) const    // Decrypt a chunk, false if it isn't held or fails to open
+{
+    QHash<QByteArray, Chunk>::const_iterator chunk = chunks.constFind(digest);
+    if (chunk == chunks.constEnd()) return false;
+    if (!chunk->deflated) return cipher.open(chunk->sealed, EntryStore::CHUNK_FIELD, clear);
+    SecureBlock packed;
+    return cipher.open(chunk->sealed, EntryStore::DEFLATED_CHUNK_FIELD, packed) && Compressor::decompress(packed.BytePtr(), packed.size(), clear);
+}
+
+bool ChunkStore::contains(const QByteArray& digest) const { return chunks.contains(digest); }
+
+bool ChunkStore::read(RecordReader& in) // Add a chunk from a binary record, as already stored, false if malformed
+{
+    QByteArray digest;
+    Chunk chunk;
+    chunk.deflated = false;
+    chunk.stored = true;
+    while (!in.atEnd())
+    {
+        quint64 tag;
+        const char* value;
+        int length;
+        if (!in.field(tag, value, length)) return false;
+        if (tag == DIGEST_FIELD) digest = QByteArray(value, length);
+        if (tag == SEALED_FIELD || tag == DEFLATED_FIELD)
+        {
+            chunk.sealed = QByteArray(value, length);
+            chunk.deflated = (tag == DEFLATED_FIELD);
+        }
+    }
+    if (digest.size() != DIGEST_SIZE || chunk.sealed.isEmpty()) return false;
+    chunks.insert(digest, chunk);
+    return true;
+}
+
+void ChunkStore::write(const QByteArray& digest, RecordWriter& out) const  // Store a chunk as a binary record
+{
+    const Chunk& chunk = *chunks.constFind(digest);
+    out.field(DIGEST_FIELD, digest);
+    out.field(chunk.deflated ? DEFLATED_FIELD : SEALED_FIELD, chunk.sealed);
+}
+
+bool ChunkStore::isStored(const QByteArray& digest) const  // Whether the file, or the changes waiting to be saved, hold a chunk
+{
+    QHash<QByteArray, Chunk>::const_iterator chunk = chunks.constFind(digest);
+    return chunk != chunks.constEnd() && chunk->stored;
+}
+
+void ChunkStore::setStored(const QByteArray& digest, bool stored)
+{
+    QHash<QByteArray, Chunk>::iterator chunk = chunks.find(digest);
+    if (chunk != chunks.end()) chunk->stored = stored;
+}
+
+void ChunkStore::clearStored() { for (QHash<QByteArray, Chunk>::iterator chunk = chunks.begin(); chunk != chunks.end(); ++chunk) chunk->stored = false; }  // Note that no chunk is stored, before marking the ones a new snapshot holds
+
+int ChunkStore::count() const { return chunks.size(); }
+
+void ChunkStore::clear() { chunks.clear(); }    // Only sealed bytes, so nothing to wipe
+
+void ChunkStore::swap(ChunkStore& other) { chunks.swap(other.chunks); }
@@ -0,0 +1,52 @@
+/*
+ * Description: Definition of the ChunkStore class.
+ *              Holds the contents of attached files as sealed chunks, each addressed by the digest of its contents.
+ *              A chunk is held once however many attachments use it, so copies and edited versions of a file share storage.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <crypto++/blake2.h>
+#include "securememory.h"
+#include "record.h"
+#include "fieldcipher.h"
+#include "compressor.h"
+#include "entrystore.h"
+
+class ChunkStore
+{
+    public:
+        static const int DIGEST_SIZE = 32;
+
+        ChunkStore();
+        ~ChunkStore();
+
+        QByteArray put(const char* data, int length, const FieldCipher& cipher, int level);    // Seal a chunk unless one with the same contents is held, returning its digest
+        bool get(const QByteArray& digest, const FieldCipher& cipher, SecureBlock& clear) const;    // Decrypt a chunk, false if it isn't held or fails to open
+        bool contains(const QByteArray& digest) const;
+        bool read(RecordReader& in);    // Add a chunk from a binary record, as already stored, false if malformed
+        void write(const QByteArray& digest, RecordWriter& out) const;  // Store a chunk as a binary record
+        bool isStored(const QByteArray& digest) const;  // Whether the file, or the changes waiting to be saved, hold a chunk
+        void setStored(const QByteArray& digest, bool stored);
+        void clearStored(); // Note that no chunk is stored, before marking the ones a new snapshot holds
+        int count() const;
+        void clear();
+        void swap(ChunkStore& other);
+
+    private:
+        enum Field { DIGEST_FIELD = 1, SEALED_FIELD, DEFLATED_FIELD };  // Tags in a chunk record
+        struct Chunk
+        {
+            QByteArray sealed;
+            bool deflated;  // Compressed before sealing, and sealed under its own tag so the flag can't be stripped
+            bool stored;
+        };
+        QHash<QByteArray, Chunk> chunks;    // By digest
+};
+
+#endif // CHUNKSTORE_H
@@ -0,0 +1,113 @@
+/*
+ * Description: Implementation of the Compressor and Decompressor classes.
+ *              Stream raw DEFLATE (RFC 1951) compression between serialization and encryption.
+ *              Also compresses single values, such as long notes, before they are sealed.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Both directions run on Crypto++'s Deflator and Inflator, whose working buffers are wiped when released.
+ * Output is handed on as it is produced, so a database is never held whole, compressed or not.
+ */
+
+#include "compressor.h"
+
+const QString Compressor::LEVEL_KEY = "compression/level";
+
+class SinkAdapter : public CryptoPP::Bufferless<CryptoPP::Sink>   // Passes filter output to a callback
+{
+    public:
+        SinkAdapter(const Compressor::Sink& sink) : sink(sink), stopped(false) { }
+
+        size_t Put2(const byte* data, size_t length, int, bool)
+        {
+            if (!stopped && length > 0) stopped = !sink((const char*) data, length);
+            return 0;
+        }
+
+        bool isStopped() const { return stopped; }  // Whether the callback refused some output
+
+    private:
+        Compressor::Sink sink;
+        bool stopped;
+};
+
+Compressor::Compressor(int level, const Sink& sink) : forward(new SinkAdapter(sink)), deflator(forward, level) { }
+
+bool Compressor::put(const char* data, size_t length)   // Compress data, passing output to the sink
+{
+    deflator.Put((const byte*) data, length);
+    return !forward->isStopped();
+}
+
+bool Compressor::finish()   // Flush the end of the stream
+{
+    deflator.MessageEnd();
+    return !forward->isStopped();
+}
+
+int Compressor::configuredLevel()   // Level from the settings file, clamped to the valid range
+{
+    int level = QSettings().value(LEVEL_KEY, DEFAULT_LEVEL).toInt();
+    if (level < NO_COMPRESSION) return NO_COMPRESSION;
+    return (level > MAX_LEVEL) ? MAX_LEVEL : level;
+}
+
+bool Compressor::compress(const char* data, size_t length, int level, SecureBlock& out)   // Compress a single value, false if it doesn't shrink
+{
+    if (level == NO_COMPRESSION || length < (size_t) MIN_VALUE_SIZE) return false;
+    out.CleanNew(length);
+    size_t used = 0;
+    Compressor deflate(level, [&out, &used](const char* packed, size_t n) -> bool
+    {
+        if (used + n >= out.size()) return false;   // No smaller than the value itself, give up early
+        memcpy(out.BytePtr() + used, packed, n);
+        used += n;
+        return true;
+    });
+    if (!deflate.put(data, length) || !deflate.finish()) return false;
+    out.resize(used);
+    return true;
+}
+
+bool Compressor::decompress(const byte* data, size_t length, SecureBlock& out)  // Expand a single value, false if it is malformed
+{
+    out.CleanNew(0);
+    Decompressor inflate([&out](const char* clear, size_t n) -> bool
+    {
+        size_t used = out.size();
+        out.resize(used + n);   // Keeps the contents, and wipes the old buffer
+        memcpy(out.BytePtr() + used, clear, n);
+        return true;
+    });
+    return inflate.put((const char*) data, length) && inflate.finish();
+}
+
+Decompressor::Decompressor(const Compressor::Sink& sink) : forward(new SinkAdapter(sink)), malformed(false), inflator(forward) { }
+
+bool Decompressor::put(const char* data, size_t length) // Expand data, passing output to the sink, false if it is malformed
+{
+    if (malformed) return false;
+    try
+    {
+        inflator.Put((const byte*) data, length);
+    }
+    catch (CryptoPP::Exception&)    // Inflator reports bad data by throwing
+    {
+        malformed = true;
+    }
+    return !malformed && !forward->isStopped();
+}
+
+bool Decompressor::finish() // Check the stream ended cleanly
+{
+    if (malformed) return false;
+    try
+    {
+        inflator.MessageEnd();
+    }
+    catch (CryptoPP::Exception&)    // Cut short
+    {
+        malformed = true;
+    }
+    return !malformed && !forward->isStopped();
+}
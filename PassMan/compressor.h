@@ -0,0 +1,61 @@
+/*
+ * Description: Definition of the Compressor and Decompressor classes.
+ *              Stream raw DEFLATE (RFC 1951) compression between serialization and encryption.
+ *              Also compresses single values, such as long notes, before they are sealed.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include <QSettings>
+#include <QString>
+#include <functional>
+#include <crypto++/cryptlib.h>
+#include <crypto++/filters.h>
+#include <crypto++/secblock.h>
+#include "securememory.h"
+#include <crypto++/zdeflate.h>
+#include <crypto++/zinflate.h>
+
+class SinkAdapter;
+
+class Compressor
+{
+    public:
+        typedef std::function<bool(const char* data, size_t length)> Sink;  // Receives output as it is produced, returns false to stop
+        static const int NO_COMPRESSION = 0;    // Level that turns compression off
+        static const int DEFAULT_LEVEL = 6;
+        static const int MAX_LEVEL = 9;
+        static const int MIN_VALUE_SIZE = 128;  // Bytes below which a single value isn't worth compressing
+
+        Compressor(int level, const Sink& sink);
+
+        bool put(const char* data, size_t length);  // Compress data, passing output to the sink
+        bool finish();  // Flush the end of the stream
+        static int configuredLevel();   // Level from the settings file, clamped to the valid range
+        static bool compress(const char* data, size_t length, int level, SecureBlock& out);    // Compress a single value, false if it doesn't shrink
+        static bool decompress(const byte* data, size_t length, SecureBlock& out); // Expand a single value, false if it is malformed
+
+    private:
+        static const QString LEVEL_KEY;
+        SinkAdapter* forward;   // Owned by the deflator
+        CryptoPP::Deflator deflator;
+};
+
+class Decompressor
+{
+    public:
+        Decompressor(const Compressor::Sink& sink);
+
+        bool put(const char* data, size_t length);  // Expand data, passing output to the sink, false if it is malformed
+        bool finish();  // Check the stream ended cleanly
+
+    private:
+        SinkAdapter* forward;   // Owned by the inflator
+        bool malformed;
+        CryptoPP::Inflator inflator;
+};
+
+#endif // COMPRESSOR_H
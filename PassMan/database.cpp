@@ -1,92 +1,949 @@
 /*
  * Description: Implementation of the Database class.
  *              Manages internal representation and manipulation of user data.
- *              Export functionality is provided for JSON storage.
+ *              Storage uses compact binary records, saving only the edits since the last save, and export is provided for JSON.
  * Author:      Adam Coffee
  * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Snapshot stream: varint schema version | database record | chunk record... | entry record...
+ * Change stream: varint schema version | change record...
+ * Each record is a varint byte length followed by tagged fields (see RecordWriter).
+ * A change record holds its kind, the id of the entry it applies to, and for adds and updates an entry record,
+ * which for updates carries only the edited field, or every field when undo or redo puts a whole entry back.
+ * Adds take the id from their entry record.
+ * The database record carries the data key, and entry records hold sealed passwords and notes (see FieldCipher), so
+ * loading copies them without decrypting.  Each entry record also carries the entry's id, group path and tags, the
+ * history of replaced values (see EntryStore), when each field was last set, and its list of attachments.  An update
+ * to a username, password or notes carries the history along with the field, and every update carries the times.
+ * The database record counts the chunk records that follow it (see ChunkStore).  A snapshot holds only the chunks
+ * its entries use, and a change record adds each chunk ahead of the first change that uses it, so an appended save
+ * holds just the chunks that are new.
+ * Databases from before the binary format are JSON inside the original text file, and are read by readJson().
+ * Entries live in one arena (see EntryStore), which is wiped and freed in one step when the database is cleared, and
+ * are addressed by a random id kept in the file, which stays valid as other entries come and go.
+ * Removing an entry only empties its slot, so ids keep finding the others in constant time.  Once most slots are
+ * empty they are closed up, and the id table and the indexes are rebuilt, which is linear but only follows as
+ * many removals.
+ * Undo history keeps entries as encoded records, so stepping back reads one over the entry much as loading does, and
+ * an entry whose removal is undone comes back after the last one, as an add replays.  Setting a field to the value it
+ * already holds is ignored, so reselecting an entry doesn't make an undo step or a change record.
+ * A field's value goes into the entry's history when a run of typing into it starts, much as an undo step does, so
+ * a new password typed a key at a time is kept once, as the one it replaced.  Retention applies as values are kept.
+ * Earlier usernames are only indexed when configured, and kept passwords and notes stay sealed like current ones.
+ * Names and usernames are kept folded in a SearchIndex, and group and tag membership in a GroupIndex, so filtering
+ * doesn't decode every entry.  Entries can be digested into a DigestTree, so merging with another copy only compares
+ * the entries that differ.
  */
 
 #include "database.h"
 
 const QString Database::NEW_ENTRY_NAME = "New Entry "; // Common values
+const QString Database::ID_KEY = "id";
 const QString Database::NAME_KEY = "name";
 const QString Database::USERNAME_KEY = "username";
 const QString Database::PASSWORD_KEY = "password";
 const QString Database::NOTES_KEY = "notes";
+const QString Database::GROUP_KEY = "group";
+const QString Database::TAGS_KEY = "tags";
 const QString Database::ENTRIES_KEY = "entries";
 const QString Database::VERSION_KEY = "version";
+const QString Database::REVISIONS_KEY = "history/count";  // Settings file keys
+const QString Database::REVISION_DAYS_KEY = "history/days";
+const QString Database::REVISION_SEARCH_KEY = "history/searchable";
 
 Database::Database(const QString& version)
 {
     this->version = version;
     newEntryCount = 1;
+    compressionLevel = Compressor::configuredLevel();
+    readStage = READ_SCHEMA;
+    snapshotSchema = 0;
+    lastChangeField = 0;
+    revisionCount = configuredRevisions();
+    revisionDays = configuredRevisionDays();
+    searchRevisions = configuredRevisionSearch();
+    revisedField = 0;
+    chunksLeft = 0;
+    snapshotWritten = false;
 }
 
 Database::~Database() { }
 
-void Database::read(const QJsonObject &json) // Extracts entry information from JSON object
+void Database::readJson(const QJsonObject &json) // Extracts entry information from JSON object (databases saved before binary records)
 {
-    entries.clear();
+    clear();
     QJsonArray entryArray = json.value(ENTRIES_KEY).toArray();
     for (int i = 0; i < entryArray.size(); i++)
     {
         QJsonObject entryObj = entryArray.at(i).toObject();
-        entries.append(new Entry(entryObj.value(NAME_KEY).toString(), entryObj.value(USERNAME_KEY).toString(),
-                             entryObj.value(PASSWORD_KEY).toString(), entryObj.value(NOTES_KEY).toString()));
+        EntryId id = EntryId::fromString(entryObj.value(ID_KEY).toString());
+        if (id.isNull() || slotOf.find(id) >= 0) id = EntryId::generate();  // Older files have no ids, and copies can't share one
+        int e = entries.append(id, entryObj.value(NAME_KEY).toString(), entryObj.value(USERNAME_KEY).toString());
+        slotOf.insert(id, e);
+        entries.setPassword(e, entryObj.value(PASSWORD_KEY).toString(), cipher);
+        entries.setNotes(e, entryObj.value(NOTES_KEY).toString(), cipher, compressionLevel);
+        entries.setGroup(e, GroupIndex::normalGroup(entryObj.value(GROUP_KEY).toString()));
+        QStringList tags;
+        foreach (const QJsonValue& tag, entryObj.value(TAGS_KEY).toArray()) tags.append(tag.toString());
+        entries.setTags(e, GroupIndex::normalTags(tags));
     }
     version = json.value(VERSION_KEY).toString();
-    emit readNewData(); // Notify watchers that database is loaded
+    buildIndex();   // Watchers are notified by finishRead, once the caller is done with the file
 }
 
-void Database::write(QJsonObject& json) // Serialize entry information to JSON object
+void Database::writeJson(QJsonObject& json) const   // Serialize entry information to JSON object for export
 {
     QJsonArray entryArray;
-    foreach (Entry* e, entries)
+    for (int e = 0; e < entries.size(); e++)
     {
-        QJsonObject entryObj;
-        e->write(entryObj);
+        if (!entries.contains(e)) continue;
+        QJsonObject entryObj;   // The same keys readJson takes
+        entryObj.insert(ID_KEY, entries.id(e).toString());
+        entryObj.insert(NAME_KEY, entries.name(e));
+        entryObj.insert(USERNAME_KEY, entries.username(e));
+        entryObj.insert(PASSWORD_KEY, entries.password(e, cipher));
+        entryObj.insert(NOTES_KEY, entries.notes(e, cipher));
+        entryObj.insert(GROUP_KEY, entries.group(e));
+        entryObj.insert(TAGS_KEY, QJsonArray::fromStringList(entries.tags(e)));
         entryArray.append(entryObj);
     }
     json.insert(ENTRIES_KEY, entryArray);
     json.insert(VERSION_KEY, version);
+}
+
+void Database::beginRead(quint64 sizeHint)   // Prepare to decode binary records, discarding current entries
+{
+    clear();
+    entries.reserve((int) qMin(sizeHint, (quint64) INT_MAX));   // Entries land in one arena, sized once for the whole snapshot
+    pending.fill(0);
+    pending.clear();
+    readStage = READ_SCHEMA;
+    chunksLeft = 0;
+}
+
+bool Database::readChunk(const char* data, size_t length)   // Decode any complete records in the next piece of cleartext
+{
+    pending.append(data, (int) length);
+    RecordReader in(pending.constData(), pending.size());
+    int consumed = 0;
+    bool valid = true;
+    while (valid)
+    {
+        if (readStage == READ_SCHEMA)
+        {
+            quint64 schema;
+            if (!in.varint(schema)) break;  // Wait for more data
+            valid = (schema == SCHEMA_VERSION);
+            snapshotSchema = schema;
+            readStage = READ_DATABASE;
+        }
+        else
+        {
+            quint64 size;
+            if (!in.varint(size)) break;    // Length not complete yet
+            if (size > (quint64) MAX_RECORD_SIZE)
+            {
+                valid = false;
+                break;
+            }
+            if ((quint64) in.remaining() < size) break; // Record not complete yet
+            RecordReader body(in.current(), (int) size);
+            in.skip((int) size);
+            if (readStage == READ_DATABASE)
+            {
+                valid = readDatabaseRecord(body);
+                readStage = (chunksLeft > 0) ? READ_CHUNKS : READ_ENTRIES;
+            }
+            else if (readStage == READ_CHUNKS)
+            {
+                valid = chunks.read(body);
+                if (--chunksLeft == 0) readStage = READ_ENTRIES;
+            }
+            else valid = readEntry(body) >= 0;
+        }
+        if (valid) consumed = in.position();
+    }
+    QByteArray rest = pending.mid(consumed);    // Keep only the partial record, wiping what was decoded
+    pending.fill(0);
+    pending = rest;
+    return valid;
+}
+
+bool Database::endRead()    // Finish decoding the snapshot, false if the records were incomplete
+{
+    bool complete = pending.isEmpty() && readStage == READ_ENTRIES;
+    pending.fill(0);
+    pending.clear();
+    readStage = READ_SCHEMA;
+    if (!complete)
+    {
+        clear();
+        return false;
+    }
+    buildIndex();   // Later journal changes update it one entry at a time
+    return true;
+}
+
+void Database::finishRead() { emit readNewData(); } // Notify watchers once the snapshot and any changes after it are applied
+
+
+bool Database::readDatabaseRecord(RecordReader& in) // Decode the leading database record
+{
+    while (!in.atEnd())
+    {
+        quint64 tag;
+        const char* value;
+        int length;
+        if (!in.field(tag, value, length)) return false;
+        if (tag == VERSION_FIELD) version = QString::fromUtf8(value, length);
+        if (tag == DATA_KEY_FIELD && !cipher.setKey(value, length)) return false;
+        if (tag == CHUNK_COUNT_FIELD && !RecordReader::integer(value, length, chunksLeft)) return false;
+    }
+    return true;
+}
+
+int Database::readEntry(RecordReader& in)   // Decode an entry record into a new slot, returning the slot, or -1 if malformed
+{
+    int e = entries.append(EntryId(), "", "");
+    bool valid = entries.read(e, in) && !entries.id(e).isNull();
+    if (!valid || !slotOf.insert(entries.id(e), e)) // Ids must be unique
+    {
+        entries.remove(e);
+        return -1;
+    }
+    return e;
+}
+
+bool Database::write(const Sink& sink)  // Serialize entry information as binary records
+{
+    RecordWriter out;
+    out.varint(SCHEMA_VERSION);
+    snapshotSchema = SCHEMA_VERSION;
+    snapshotChunks.clear();
+    snapshotWritten = false;
+    QSet<QByteArray> used;
+    for (int e = 0; e < entries.size(); e++)    // Only chunks some entry uses are kept
+    {
+        if (!entries.contains(e)) continue;
+        foreach (const EntryStore::Attachment& file, entries.attachments(e))
+        {
+            for (int offset = 0; offset + ChunkStore::DIGEST_SIZE <= file.chunks.size(); offset += ChunkStore::DIGEST_SIZE)
+            {
+                QByteArray digest = file.chunks.mid(offset, ChunkStore::DIGEST_SIZE);
+                if (!chunks.contains(digest) || used.contains(digest)) continue;
+                used.insert(digest);
+                snapshotChunks.append(digest);
+            }
+        }
+    }
+    RecordWriter header;
+    header.field(VERSION_FIELD, version);
+    header.field(DATA_KEY_FIELD, cipher.key(), FieldCipher::KEY_SIZE);
+    header.integer(CHUNK_COUNT_FIELD, snapshotChunks.size());
+    out.record(header);
+    for (int i = 0; i < snapshotChunks.size() + entries.size(); i++)    // Chunks first, then entries
+    {
+        RecordWriter body;
+        if (i < snapshotChunks.size()) chunks.write(snapshotChunks.at(i), body);
+        else if (entries.contains(i - snapshotChunks.size())) entries.write(i - snapshotChunks.size(), body);
+        else continue;
+        out.record(body);
+        if (out.size() >= FLUSH_SIZE)   // Hand out bounded batches rather than one large buffer
+        {
+            if (!sink(out.bytes().constData(), out.size())) return false;
+            out.clear();
+        }
+    }
+    snapshotWritten = (out.size() == 0 || sink(out.bytes().constData(), out.size()));    // Its chunks count as stored once it is committed
+    return snapshotWritten;
+}
+
+bool Database::hasChanges() const { return !changes.isEmpty(); }    // Whether anything was edited since the last save
+
+bool Database::canAppend() const { return snapshotSchema == SCHEMA_VERSION; }  // Whether the stored snapshot has the current layout, so changes can be appended to it
+
+bool Database::writeChanges(const Sink& sink)   // Serialize the edits since the last save as change records
+{
+    RecordWriter out;
+    out.varint(SCHEMA_VERSION);
+    foreach (const QByteArray& change, changes) out.append(change);
+    return sink(out.bytes().constData(), out.size());
+}
+
+void Database::commitChanges()  // Forget recorded edits once they are stored
+{
+    if (snapshotWritten)    // The file now holds just the snapshot's chunks
+    {
+        chunks.clearStored();
+        foreach (const QByteArray& digest, snapshotChunks) chunks.setStored(digest, true);
+        snapshotChunks.clear();
+        snapshotWritten = false;
+    }
+    wipeChanges();
     emit writeNewData();    // Notify watchers that database saved
 }
 
-QString Database::name(int e) { return (entries.size() > e && e >= 0) ? entries.at(e)->name() : ""; } // Retrieve information:
+bool Database::readChanges(const char* data, size_t length)   // Apply a batch of change records on top of the loaded entries
+{
+    RecordReader in(data, (int) length);
+    quint64 schema;
+    if (!in.varint(schema) || schema != SCHEMA_VERSION) return false;
+    while (!in.atEnd())
+    {
+        quint64 size;
+        if (!in.varint(size) || size > (quint64) in.remaining()) return false;
+        RecordReader body(in.current(), (int) size);
+        in.skip((int) size);
+        if (!readChangeRecord(body)) return false;
+    }
+    return true;
+}
+
+bool Database::readChangeRecord(RecordReader& in) // Apply one change record
+{
+    quint64 change = 0;
+    EntryId id;
+    const char* entry = 0;
+    int entryLength = 0;
+    const char* chunk = 0;
+    int chunkLength = 0;
+    while (!in.atEnd())
+    {
+        quint64 tag;
+        const char* value;
+        int length;
+        if (!in.field(tag, value, length)) return false;
+        if (tag == CHANGE_FIELD && !RecordReader::integer(value, length, change)) return false;
+        if (tag == ID_FIELD) id = EntryId::fromBytes(value, length);
+        if (tag == ENTRY_FIELD)
+        {
+            entry = value;
+            entryLength = length;
+        }
+        if (tag == CHUNK_FIELD)
+        {
+            chunk = value;
+            chunkLength = length;
+        }
+    }
+    if (change == CHUNK_CHANGE)
+    {
+        RecordReader body(chunk, chunkLength);
+        return chunks.read(body);
+    }
+    int e = slotOf.find(id);
+    RecordReader fields(entry, entryLength);
+    switch (change)
+    {
+        case ADD_CHANGE:
+            e = readEntry(fields);
+            if (e < 0) return false;
+            appendIndex(e);
+            return true;
+        case UPDATE_CHANGE:
+            if (e < 0) return false;
+            id = entries.id(e);
+            if (!entries.read(e, fields) || entries.id(e) != id) return false;  // An update can't move an entry to another id
+            updateIndex(e);
+            return true;
+        case REMOVE_CHANGE:
+            if (e < 0) return false;
+            removeSlot(e);
+            return true;
+        default:    // Unknown changes can't be skipped without the entries drifting out of step
+            return false;
+    }
+}
+
+void Database::recordChange(int change, int e, int field)   // Remember an edit for the next save
+{
+    EntryId id = entries.id(e);
+    if (change == UPDATE_CHANGE && !changes.isEmpty() && id == lastChangeId && field == lastChangeField)
+    {
+        changes.last().fill(0); // Typing into one field keeps replacing a single change
+        changes.removeLast();
+    }
+    if (change == ADD_CHANGE || (change == UPDATE_CHANGE && (field == 0 || field == EntryStore::ATTACHMENTS_FIELD))) recordChunks(e);
+    RecordWriter body;
+    body.integer(CHANGE_FIELD, change);
+    if (change != ADD_CHANGE) body.field(ID_FIELD, id.toBytes());   // Adds carry it in their entry record
+    if (change != REMOVE_CHANGE)
+    {
+        RecordWriter fields;
+        if (change == ADD_CHANGE || field == 0) entries.write(e, fields);  // An update without a field replaces the whole entry
+        else entries.write(e, fields, field);
+        body.field(ENTRY_FIELD, fields.bytes());
+    }
+    RecordWriter record;
+    record.record(body);
+    changes.append(record.bytes());
+    lastChangeId = (change == UPDATE_CHANGE) ? id : EntryId();
+    lastChangeField = (change == UPDATE_CHANGE) ? field : 0;
+}
+
+void Database::recordChunks(int e)  // Remember the chunks an entry's attachments use that aren't stored yet
+{
+    foreach (const EntryStore::Attachment& file, entries.attachments(e))
+    {
+        for (int offset = 0; offset + ChunkStore::DIGEST_SIZE <= file.chunks.size(); offset += ChunkStore::DIGEST_SIZE)
+        {
+            QByteArray digest = file.chunks.mid(offset, ChunkStore::DIGEST_SIZE);
+            if (!chunks.contains(digest) || chunks.isStored(digest)) continue;
+            RecordWriter contents;
+            chunks.write(digest, contents);
+            RecordWriter body;
+            body.integer(CHANGE_FIELD, CHUNK_CHANGE);
+            body.field(CHUNK_FIELD, contents.bytes());
+            RecordWriter record;
+            record.record(body);
+            changes.append(record.bytes());
+            chunks.setStored(digest, true); // Saved with these changes, or with a snapshot that replaces them
+        }
+    }
+}
+
+void Database::wipeChanges()    // Wipe and discard recorded edits
+{
+    for (int i = 0; i < changes.size(); i++) changes[i].fill(0);
+    changes.clear();
+    lastChangeId = EntryId();
+    lastChangeField = 0;
+}
+
+QVector<EntryId> Database::ids() const  // Every entry, in list order
+{
+    QVector<EntryId> list;
+    list.reserve(entries.count());
+    for (int e = 0; e < entries.size(); e++) if (entries.contains(e)) list.append(entries.id(e));
+    return list;
+}
+
+bool Database::contains(const EntryId& id) const { return slotOf.find(id) >= 0; } // Whether an entry has this id
+
+QString Database::name(const EntryId& id)   // Retrieve information:
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.name(e) : "";
+}
+
+QString Database::username(const EntryId& id)
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.username(e) : "";
+}
+
+QString Database::password(const EntryId& id)
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.password(e, cipher) : "";
+}
+
+QString Database::notes(const EntryId& id)
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.notes(e, cipher) : "";
+}
+
+QString Database::group(const EntryId& id)
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.group(e) : "";
+}
+
+QStringList Database::tags(const EntryId& id)
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.tags(e) : QStringList();
+}
+
+QString Database::value(const EntryId& id, int field) const   // Any of those by its EntryStore field, tags one to a line, attachments one to a line with their size and chunk digests
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? value(e, field) : "";
+}
+
+qint64 Database::modified(const EntryId& id, int field) const  // When a field was last set, in milliseconds since the epoch, 0 if unknown
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.modified(e, field) : 0;
+}
+
+void Database::setName(const QString &n, const EntryId& id) { setValue(EntryStore::NAME_FIELD, n, id); }    // Set information:
+
+void Database::setUsername(const QString &un, const EntryId& id) { setValue(EntryStore::USERNAME_FIELD, un, id); }
+
+void Database::setPassword(const QString &pw, const EntryId& id) { setValue(EntryStore::PASSWORD_FIELD, pw, id); }
+
+void Database::setNotes(const QString &nt, const EntryId& id) { setValue(EntryStore::NOTES_FIELD, nt, id); }
+
+void Database::setGroup(const QString& g, const EntryId& id) { setValue(EntryStore::GROUP_FIELD, g, id); }   // Slash-separated path, tidied of blank levels
+
+void Database::setTags(const QStringList& t, const EntryId& id) { setValue(EntryStore::TAGS_FIELD, GroupIndex::normalTags(t).join(QChar('\n')), id); }   // Tidied of blanks and repeats
+
+void Database::setValue(int field, const QString& v, const EntryId& id, qint64 time)  // Any of those by its EntryStore field, noting the time it was set, now unless given
+{
+    int e = slotOf.find(id);
+    if (e < 0) return;
+    QString value = v;
+    if (field == EntryStore::GROUP_FIELD) value = GroupIndex::normalGroup(v);
+    else if (field == EntryStore::TAGS_FIELD) value = GroupIndex::normalTags(v.split(QChar('\n'), QString::SkipEmptyParts)).join(QChar('\n'));
+    if (this->value(e, field) == value) return; // Unchanged values make no change record or undo step, and sealing again would differ even for the same password
+    QByteArray before = encode(e);
+    switch (field)
+    {
+        case EntryStore::NAME_FIELD:
+            entries.setName(e, value);
+            break;
+        case EntryStore::USERNAME_FIELD:
+            revise(e, field);
+            entries.setUsername(e, value);
+            break;
+        case EntryStore::PASSWORD_FIELD:
+            revise(e, field);
+            entries.setPassword(e, value, cipher);
+            break;
+        case EntryStore::NOTES_FIELD:
+            revise(e, field);
+            entries.setNotes(e, value, cipher, compressionLevel);
+            break;
+        case EntryStore::GROUP_FIELD:
+            entries.setGroup(e, value);
+            break;
+        case EntryStore::TAGS_FIELD:
+            entries.setTags(e, value.split(QChar('\n'), QString::SkipEmptyParts));
+            break;
+        default:
+            return;
+    }
+    entries.touch(e, field, (time > 0) ? time : QDateTime::currentMSecsSinceEpoch());
+    if (field != EntryStore::PASSWORD_FIELD && field != EntryStore::NOTES_FIELD) updateIndex(e);    // Secrets aren't indexed
+    recordChange(UPDATE_CHANGE, e, field);
+    history.record(id, before, encode(e), field);
+}
+
+QVector<EntryStore::Revision> Database::revisions(const EntryId& id) const   // Values the entry's username, password and notes held before, newest first
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.revisions(e) : QVector<EntryStore::Revision>();
+}
 
-QString Database::username(int e) { return (entries.size() > e && e >= 0) ? entries.at(e)->username() : ""; }
+QString Database::revision(const EntryId& id, int r)    // One of those values, decrypted on request
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.revision(e, r, cipher) : "";
+}
 
-QString Database::password(int e) { return (entries.size() > e && e >= 0) ? entries.at(e)->password() : ""; }
+void Database::revert(const EntryId& id, int r) // Put one of those values back, keeping the one it replaces, as its own undo step
+{
+    int e = slotOf.find(id);
+    if (e < 0 || r < 0 || r >= entries.revisions(e).size()) return;
+    int field = entries.revisions(e).at(r).field;
+    QString value = entries.revision(e, r, cipher);
+    closeEdit();
+    if (field == EntryStore::USERNAME_FIELD) setUsername(value, id);
+    else if (field == EntryStore::PASSWORD_FIELD) setPassword(value, id);
+    else if (field == EntryStore::NOTES_FIELD) setNotes(value, id);
+    closeEdit();
+}
 
-QString Database::notes(int e) { return (entries.size() > e && e >= 0) ? entries.at(e)->notes() : ""; }
+int Database::configuredRevisions() // Replaced values of each field kept, from the settings file, 0 keeps none
+{
+    int count = QSettings().value(REVISIONS_KEY, DEFAULT_REVISIONS).toInt();
+    return (count < 0) ? 0 : count;
+}
 
-void Database::setName(const QString &n, int e) { if (entries.size() > e && e >= 0) entries.at(e)->setName(n); } // Set information:
+int Database::configuredRevisionDays()  // Days replaced values are kept, from the settings file, 0 for no limit
+{
+    int days = QSettings().value(REVISION_DAYS_KEY, 0).toInt();
+    return (days < 0) ? 0 : days;
+}
 
-void Database::setUsername(const QString &un, int e) { if (entries.size() > e && e >= 0) entries.at(e)->setUsername(un); }
+bool Database::configuredRevisionSearch() { return QSettings().value(REVISION_SEARCH_KEY, false).toBool(); }  // Whether entries are found by their earlier usernames, off unless configured
 
-void Database::setPassword(const QString &pw, int e) { if (entries.size() > e && e >= 0) entries.at(e)->setPassword(pw); }
+QVector<EntryStore::Attachment> Database::attachments(const EntryId& id) const  // Files attached to an entry
+{
+    int e = slotOf.find(id);
+    return (e >= 0) ? entries.attachments(e) : QVector<EntryStore::Attachment>();
+}
 
-void Database::setNotes(const QString &nt, int e) { if (entries.size() > e && e >= 0) entries.at(e)->setNotes(nt); }
+bool Database::attach(const EntryId& id, const QString& name, const Source& source)  // Read a file into an entry a chunk at a time, as its own undo step, false if reading fails
+{
+    int e = slotOf.find(id);
+    if (e < 0) return false;
+    EntryStore::Attachment file;
+    file.name = name;
+    file.size = 0;
+    SecureBlock buffer(Chunker::MAX_SIZE);  // Wiped when released, the contents may be a private key
+    int filled = 0;
+    bool ended = false;
+    while (true)
+    {
+        while (!ended && filled < Chunker::MAX_SIZE)    // A boundary can only be found with a whole chunk's worth in view
+        {
+            qint64 got = source((char*) buffer.BytePtr() + filled, Chunker::MAX_SIZE - filled);
+            if (got < 0) return false;  // Chunks already sealed are left out of the next snapshot
+            if (got == 0) ended = true;
+            filled += (int) got;
+        }
+        if (filled == 0) break;
+        int length = Chunker::boundary(buffer.BytePtr(), filled);
+        file.chunks.append(chunks.put((const char*) buffer.BytePtr(), length, cipher, compressionLevel));
+        file.size += length;
+        memmove(buffer.BytePtr(), buffer.BytePtr() + length, filled - length);
+        filled -= length;
+    }
+    closeEdit();
+    QByteArray before = encode(e);
+    QVector<EntryStore::Attachment> files = entries.attachments(e);
+    files.append(file);
+    entries.setAttachments(e, files);
+    entries.touch(e, EntryStore::ATTACHMENTS_FIELD, QDateTime::currentMSecsSinceEpoch());
+    recordChange(UPDATE_CHANGE, e, EntryStore::ATTACHMENTS_FIELD);
+    history.record(id, before, encode(e), EntryStore::ATTACHMENTS_FIELD);
+    closeEdit();
+    return true;
+}
 
-void Database::addNew() // Append new entry
+bool Database::extract(const EntryId& id, int a, const Sink& sink) const    // Write an attachment out a chunk at a time, false if a chunk is missing or fails to open
 {
-    entries.append(new Entry(QString(NEW_ENTRY_NAME).append(QString::number(newEntryCount)), "", "", ""));
+    int e = slotOf.find(id);
+    if (e < 0) return false;
+    QVector<EntryStore::Attachment> files = entries.attachments(e);
+    if (a < 0 || a >= files.size()) return false;
+    const QByteArray& list = files.at(a).chunks;
+    SecureBlock clear;
+    for (int offset = 0; offset + ChunkStore::DIGEST_SIZE <= list.size(); offset += ChunkStore::DIGEST_SIZE)
+    {
+        if (!chunks.get(list.mid(offset, ChunkStore::DIGEST_SIZE), cipher, clear)) return false;
+        if (!sink((const char*) clear.BytePtr(), clear.size())) return false;
+    }
+    return true;
+}
+
+void Database::detach(const EntryId& id, int a) // Remove an attachment, as its own undo step
+{
+    int e = slotOf.find(id);
+    if (e < 0) return;
+    QVector<EntryStore::Attachment> files = entries.attachments(e);
+    if (a < 0 || a >= files.size()) return;
+    closeEdit();
+    QByteArray before = encode(e);
+    files.remove(a);
+    entries.setAttachments(e, files);
+    entries.touch(e, EntryStore::ATTACHMENTS_FIELD, QDateTime::currentMSecsSinceEpoch());
+    recordChange(UPDATE_CHANGE, e, EntryStore::ATTACHMENTS_FIELD);
+    history.record(id, before, encode(e), EntryStore::ATTACHMENTS_FIELD);
+    closeEdit();
+}
+
+bool Database::copyAttachments(const EntryId& id, const Database& from, qint64 time)    // Give an entry the attachments another copy's entry holds, bringing over the chunks this one lacks, as its own undo step
+{
+    int e = slotOf.find(id);
+    int f = from.slotOf.find(id);
+    if (e < 0 || f < 0) return false;
+    QVector<EntryStore::Attachment> files = from.entries.attachments(f);
+    SecureBlock clear;
+    foreach (const EntryStore::Attachment& file, files)
+    {
+        for (int offset = 0; offset + ChunkStore::DIGEST_SIZE <= file.chunks.size(); offset += ChunkStore::DIGEST_SIZE)
+        {
+            QByteArray digest = file.chunks.mid(offset, ChunkStore::DIGEST_SIZE);
+            if (chunks.contains(digest)) continue;  // Digests cover the contents, so they match across copies whatever the key
+            if (!from.chunks.get(digest, from.cipher, clear)) return false; // Chunks already brought over are left out of the next snapshot
+            chunks.put((const char*) clear.BytePtr(), (int) clear.size(), cipher, compressionLevel);   // Sealed again under this copy's key
+        }
+    }
+    closeEdit();
+    QByteArray before = encode(e);
+    entries.setAttachments(e, files);
+    entries.touch(e, EntryStore::ATTACHMENTS_FIELD, (time > 0) ? time : QDateTime::currentMSecsSinceEpoch());
+    recordChange(UPDATE_CHANGE, e, EntryStore::ATTACHMENTS_FIELD);
+    history.record(id, before, encode(e), EntryStore::ATTACHMENTS_FIELD);
+    closeEdit();
+    return true;
+}
+
+EntryId Database::addNew()  // Append new entry, returning its id
+{
+    EntryId id = EntryId::generate();
+    int e = entries.append(id, QString(NEW_ENTRY_NAME).append(QString::number(newEntryCount)), "");
     newEntryCount++;
+    slotOf.insert(id, e);
+    appendIndex(e);
+    recordChange(ADD_CHANGE, e);
+    history.record(id, QByteArray(), encode(e));
+    return id;
+}
+
+bool Database::insert(const EntryId& id)    // Append an empty entry with this id, such as one merged in from another copy, false if the id is taken
+{
+    if (id.isNull() || slotOf.find(id) >= 0) return false;
+    int e = entries.append(id, "", "");
+    slotOf.insert(id, e);
+    appendIndex(e);
+    recordChange(ADD_CHANGE, e);
+    history.record(id, QByteArray(), encode(e));
+    return true;
+}
+
+void Database::remove(const EntryId& id)    // Remove entry
+{
+    int e = slotOf.find(id);
+    if (e >= 0)
+    {
+        history.record(id, encode(e), QByteArray());
+        recordChange(REMOVE_CHANGE, e);
+        removeSlot(e);
+    }
 }
 
-void Database::remove(int e)    // Remove entry
+bool Database::canUndo() const { return history.canUndo(); }   // Whether there is an edit to undo
+
+bool Database::canRedo() const { return history.canRedo(); }   // Whether there is an undone edit to redo
+
+EntryId Database::undo()    // Revert the newest edit step, returning the entry it touched
 {
-    if (entries.size() > e && e >= 0)
+    closeEdit();    // Typing after this starts a new run, keeping the value undo left
+    EntryId id;
+    QByteArray value;
+    if (!history.undo(id, value) || !restore(id, value)) return EntryId();
+    return id;
+}
+
+EntryId Database::redo()    // Reapply the newest undone step, returning the entry it touched
+{
+    closeEdit();
+    EntryId id;
+    QByteArray value;
+    if (!history.redo(id, value) || !restore(id, value)) return EntryId();
+    return id;
+}
+
+void Database::closeEdit()  // Stop coalescing, so the next edit starts a new undo step and keeps the value it replaces
+{
+    history.close();
+    revisedId = EntryId();
+    revisedField = 0;
+}
+
+bool Database::restore(const EntryId& id, const QByteArray& value)  // Put an entry back as history encoded it, empty if it shouldn't exist
+{
+    int e = slotOf.find(id);
+    RecordReader fields(value.constData(), value.size());
+    if (value.isEmpty())
+    {
+        if (e < 0) return false;
+        recordChange(REMOVE_CHANGE, e);
+        removeSlot(e);
+    }
+    else if (e >= 0)    // Every field is encoded, so reading them over the entry replaces it
+    {
+        if (!entries.read(e, fields)) return false;
+        updateIndex(e);
+        recordChange(UPDATE_CHANGE, e);
+    }
+    else    // Removed, it comes back after the last entry
     {
-        delete entries.at(e);
-        entries.removeAt(e);
+        e = readEntry(fields);
+        if (e < 0) return false;
+        appendIndex(e);
+        recordChange(ADD_CHANGE, e);
     }
+    return true;
+}
+
+void Database::revise(int e, int field)    // Keep a field's value before the first edit of a run of typing into it
+{
+    EntryId id = entries.id(e);
+    if (id == revisedId && field == revisedField) return;   // Kept when the run started
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    entries.keep(e, field, now, cipher);
+    entries.prune(e, revisionCount, (revisionDays > 0) ? now - revisionDays * MS_PER_DAY : 0);
+    revisedId = id;
+    revisedField = field;
+}
+
+void Database::removeSlot(int e)    // Remove the entry in this slot, compacting once most slots are empty
+{
+    slotOf.remove(entries.id(e));
+    entries.remove(e);
+    index.remove(e);
+    groups.remove(e);
+    int empty = entries.size() - entries.count();
+    if (empty < MIN_COMPACT_SLOTS || empty <= entries.count()) return;
+    entries.compact();  // Slots move, but nothing outside holds them
+    slotOf.clear();
+    slotOf.reserve(entries.count());
+    for (int slot = 0; slot < entries.size(); slot++) slotOf.insert(entries.id(slot), slot);
+    buildIndex();
 }
 
 void Database::clear()  // Clear all entries
 {
     newEntryCount = 1;
-    entries.clear();
+    snapshotSchema = 0;
+    entries.clear();    // Wipes and frees every entry
+    slotOf.clear();
+    index.clear();
+    groups.clear();
+    history.clear();
+    revisedId = EntryId();
+    revisedField = 0;
+    wipeChanges();
+    chunks.clear();
+    snapshotChunks.clear();
+    snapshotWritten = false;
+    cipher.generateKey();   // A new or freshly loaded database never shares the old data key
 }
 
-int Database::size() { return entries.size(); } // Return number of entries held
+void Database::swap(Database& other) // Exchange every entry, edit and key with another database, such as one read on another thread
+{
+    qSwap(newEntryCount, other.newEntryCount);
+    qSwap(snapshotSchema, other.snapshotSchema);
+    entries.swap(other.entries);
+    slotOf.swap(other.slotOf);
+    index.swap(other.index);
+    groups.swap(other.groups);
+    history.swap(other.history);
+    cipher.swap(other.cipher);
+    chunks.swap(other.chunks);
+    qSwap(chunksLeft, other.chunksLeft);
+    snapshotChunks.swap(other.snapshotChunks);
+    qSwap(snapshotWritten, other.snapshotWritten);
+    pending.swap(other.pending);
+    qSwap(readStage, other.readStage);
+    changes.swap(other.changes);
+    qSwap(lastChangeId, other.lastChangeId);
+    qSwap(lastChangeField, other.lastChangeField);
+    qSwap(revisedId, other.revisedId);
+    qSwap(revisedField, other.revisedField);
+}
+
+int Database::size() { return entries.count(); }    // Return number of entries held
+
+QVector<EntryId> Database::match(const QString& query) const { return idsOf(index.match(query)); } // Entries whose name or username holds the query's characters in order, best first
+
+QVector<EntryId> Database::match(const QString& query, const QVector<EntryId>& within) const   // The same, only among these entries, such as the last matches
+{
+    QVector<int> candidates;
+    candidates.reserve(within.size());
+    foreach (const EntryId& id, within)
+    {
+        int e = slotOf.find(id);
+        if (e >= 0) candidates.append(e);
+    }
+    return idsOf(index.match(query, candidates));
+}
+
+QStringList Database::subgroups(const QString& group) const { return groups.subgroups(group); }  // Groups directly inside this one that hold entries, sorted, the top level is empty
+
+QVector<EntryId> Database::members(const QString& group, const QStringList& tags) const    // Entries in this group or below carrying every tag, in list order
+{
+    return idsOf(groups.members(GroupIndex::normalGroup(group), GroupIndex::normalTags(tags)));
+}
+
+DigestTree Database::digests(int depth, bool sealed) const  // Every entry's digest, over its record as stored, or over its values for copies sealed under different keys
+{
+    DigestTree tree(depth);
+    for (int e = 0; e < entries.size(); e++)
+    {
+        if (!entries.contains(e)) continue;
+        RecordWriter fields;
+        if (sealed) entries.write(e, fields);   // Sealed values only match where they were copied unchanged
+        else
+        {
+            fields.field(EntryStore::NAME_FIELD, entries.name(e));
+            fields.field(EntryStore::USERNAME_FIELD, entries.username(e));
+            fields.field(EntryStore::PASSWORD_FIELD, entries.password(e, cipher));
+            fields.field(EntryStore::NOTES_FIELD, entries.notes(e, cipher));
+            fields.field(EntryStore::GROUP_FIELD, entries.group(e));
+            fields.field(EntryStore::TAGS_FIELD, entries.tags(e).join(QChar('\n')));
+            fields.field(EntryStore::ATTACHMENTS_FIELD, value(e, EntryStore::ATTACHMENTS_FIELD));   // Chunk digests cover the contents, not the key
+        }
+        tree.add(entries.id(e), fields.bytes().constData(), fields.size());
+        fields.clear();
+    }
+    tree.build();
+    return tree;
+}
+
+bool Database::sharesKey(const Database& other) const { return memcmp(cipher.key(), other.cipher.key(), FieldCipher::KEY_SIZE) == 0; } // Whether another database seals entries under the same data key, as copies of one file do
+
+QString Database::value(int e, int field) const    // A field's value by its EntryStore field
+{
+    switch (field)
+    {
+        case EntryStore::NAME_FIELD:
+            return entries.name(e);
+        case EntryStore::USERNAME_FIELD:
+            return entries.username(e);
+        case EntryStore::PASSWORD_FIELD:
+            return entries.password(e, cipher);
+        case EntryStore::NOTES_FIELD:
+            return entries.notes(e, cipher);
+        case EntryStore::GROUP_FIELD:
+            return entries.group(e);
+        case EntryStore::TAGS_FIELD:
+            return entries.tags(e).join(QChar('\n'));
+        case EntryStore::ATTACHMENTS_FIELD:
+        {
+            QStringList files;
+            foreach (const EntryStore::Attachment& file, entries.attachments(e)) files.append(file.name + QChar('\t') + QString::number(file.size) + QChar('\t') + QString::fromLatin1(file.chunks.toHex()));
+            return files.join(QChar('\n'));
+        }
+        default:
+            return QString();
+    }
+}
+
+QByteArray Database::encode(int e) const   // An entry's record, as undo history keeps it
+{
+    RecordWriter fields;
+    entries.write(e, fields);
+    return fields.bytes();
+}
+
+QString Database::indexText(int e) const    // Text an entry is found by, one field to a line
+{
+    QString text = entries.name(e) + QChar('\n') + entries.username(e);
+    if (!searchRevisions) return text;
+    QVector<EntryStore::Revision> kept = entries.revisions(e);
+    for (int r = 0; r < kept.size(); r++) if (kept.at(r).field == EntryStore::USERNAME_FIELD) text.append(QChar('\n')).append(entries.revision(e, r, cipher));
+    return text;
+}
+
+void Database::buildIndex() // Index every entry at once, after a database is read
+{
+    QStringList texts;
+    texts.reserve(entries.size());
+    for (int e = 0; e < entries.size(); e++) texts.append(indexText(e));
+    index.build(texts);
+    groups.clear();
+    for (int e = 0; e < entries.size(); e++) groups.append(entries.group(e), entries.tags(e));
+    for (int e = 0; e < entries.size(); e++)    // Slots stay numbered alike
+    {
+        if (entries.contains(e)) continue;
+        index.remove(e);
+        groups.remove(e);
+    }
+}
+
+void Database::appendIndex(int e)   // Index an entry just added after the last
+{
+    index.append(indexText(e));
+    groups.append(entries.group(e), entries.tags(e));
+}
+
+void Database::updateIndex(int e)   // Reindex an entry after an edit
+{
+    index.update(e, indexText(e));
+    groups.update(e, entries.group(e), entries.tags(e));
+}
+
+QVector<EntryId> Database::idsOf(const QVector<int>& found) const   // Ids of the entries in these slots
+{
+    QVector<EntryId> list;
+    list.reserve(found.size());
+    foreach (int e, found) list.append(entries.id(e));
+    return list;
+}
@@ -1,6 +1,7 @@
 /*
  * Description: Definition of the Database class.
  *              Manages internal representation and manipulation of user data.
+ *              Storage uses compact binary records, saving only the edits since the last save, and export is provided for JSON.
  * Author:      Adam Coffee
  * Licensed under the three-clause BSD license, found in the LICENSE file.
  */
@@ -13,7 +14,22 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QList>
-#include "entry.h"
+#include <QSet>
+#include <QDateTime>
+#include <QSettings>
+#include <functional>
+#include "entrystore.h"
+#include "searchindex.h"
+#include "entryid.h"
+#include "idtable.h"
+#include "undohistory.h"
+#include "groupindex.h"
+#include "digesttree.h"
+#include "chunkstore.h"
+#include "chunker.h"
+#include <climits>
+#include "record.h"
+#include "fieldcipher.h"
 #include <QDebug> //TESTING
 
 class Database : public QObject
@@ -21,33 +37,128 @@ class Database : public QObject
     Q_OBJECT
 
     public:
+        typedef std::function<bool(const char* data, size_t length)> Sink;  // Receives serialized bytes, returns false to stop
+        typedef std::function<qint64(char* data, qint64 length)> Source;    // Fills up to length bytes, returning how many, 0 at the end, or -1 on failure
+        static const quint64 SCHEMA_VERSION = 1;    // Version of the binary record layout
+        static const int DEFAULT_REVISIONS = 10;    // Replaced values of each field kept when no retention is configured
+
         Database(const QString& version);
         ~Database();
 
-        void read(const QJsonObject& json); // Extracts entry information from JSON object
-        void write(QJsonObject& json);  // Serialize entry information to JSON object
-        QString name(int e);    // Retrieve information:
-        QString username(int e);
-        QString password(int e);
-        QString notes(int e);
-        void setName(const QString& n, int e);  // Set information:
-        void setUsername(const QString& un, int e);
-        void setPassword(const QString& pw, int e);
-        void setNotes(const QString& nt, int e);
-        void addNew();  // Append new entry
-        void remove(int e); // Remove entry
+        void readJson(const QJsonObject& json); // Extracts entry information from JSON object (databases saved before binary records)
+        void writeJson(QJsonObject& json) const;    // Serialize entry information to JSON object for export
+        void beginRead(quint64 sizeHint = 0);   // Prepare to decode binary records, discarding current entries
+        bool readChunk(const char* data, size_t length);    // Decode any complete records in the next piece of cleartext
+        bool endRead(); // Finish decoding the snapshot, false if the records were incomplete
+        bool readChanges(const char* data, size_t length);  // Apply a batch of change records on top of the loaded entries
+        void finishRead();  // Notify watchers once the snapshot and any changes after it are applied
+        bool write(const Sink& sink);   // Serialize entry information as binary records
+        bool hasChanges() const;    // Whether anything was edited since the last save
+        bool canAppend() const; // Whether the stored snapshot has the current layout, so changes can be appended to it
+        bool writeChanges(const Sink& sink);    // Serialize the edits since the last save as change records
+        void commitChanges();   // Forget recorded edits once they are stored
+        QVector<EntryId> ids() const;   // Every entry, in list order
+        bool contains(const EntryId& id) const; // Whether an entry has this id
+        QString name(const EntryId& id);    // Retrieve information:
+        QString username(const EntryId& id);
+        QString password(const EntryId& id);    // Decrypted on request, only the selected entry's secrets are needed
+        QString notes(const EntryId& id);
+        QString group(const EntryId& id);   // Slash-separated path, empty for the top level
+        QStringList tags(const EntryId& id);
+        QString value(const EntryId& id, int field) const;  // Any of those by its EntryStore field, tags one to a line, attachments one to a line with their size and chunk digests
+        qint64 modified(const EntryId& id, int field) const;    // When a field was last set, in milliseconds since the epoch, 0 if unknown
+        void setName(const QString& n, const EntryId& id);  // Set information:
+        void setUsername(const QString& un, const EntryId& id);
+        void setPassword(const QString& pw, const EntryId& id);
+        void setNotes(const QString& nt, const EntryId& id);
+        void setGroup(const QString& g, const EntryId& id); // Slash-separated path, tidied of blank levels
+        void setTags(const QStringList& t, const EntryId& id);  // Tidied of blanks and repeats
+        void setValue(int field, const QString& v, const EntryId& id, qint64 time = 0); // Any of those by its EntryStore field, noting the time it was set, now unless given
+        QVector<EntryStore::Revision> revisions(const EntryId& id) const;   // Values the entry's username, password and notes held before, newest first
+        QString revision(const EntryId& id, int r); // One of those values, decrypted on request
+        void revert(const EntryId& id, int r);  // Put one of those values back, keeping the one it replaces, as its own undo step
+        static int configuredRevisions();   // Replaced values of each field kept, from the settings file, 0 keeps none
+        static int configuredRevisionDays();    // Days replaced values are kept, from the settings file, 0 for no limit
+        static bool configuredRevisionSearch(); // Whether entries are found by their earlier usernames, off unless configured
+        QVector<EntryStore::Attachment> attachments(const EntryId& id) const;   // Files attached to an entry
+        bool attach(const EntryId& id, const QString& name, const Source& source);  // Read a file into an entry a chunk at a time, as its own undo step, false if reading fails
+        bool extract(const EntryId& id, int a, const Sink& sink) const; // Write an attachment out a chunk at a time, false if a chunk is missing or fails to open
+        void detach(const EntryId& id, int a);  // Remove an attachment, as its own undo step
+        bool copyAttachments(const EntryId& id, const Database& from, qint64 time = 0); // Give an entry the attachments another copy's entry holds, bringing over the chunks this one lacks, as its own undo step
+        EntryId addNew();   // Append new entry, returning its id
+        bool insert(const EntryId& id); // Append an empty entry with this id, such as one merged in from another copy, false if the id is taken
+        void remove(const EntryId& id); // Remove entry
+        bool canUndo() const;   // Whether there is an edit to undo
+        bool canRedo() const;   // Whether there is an undone edit to redo
+        EntryId undo(); // Revert the newest edit step, returning the entry it touched
+        EntryId redo(); // Reapply the newest undone step, returning the entry it touched
+        void closeEdit();   // Stop coalescing, so the next edit starts a new undo step
         void clear();   // Clear all entries
+        void swap(Database& other); // Exchange every entry, edit and key with another database, such as one read on another thread
         int size(); // Return number of entries held
+        QVector<EntryId> match(const QString& query) const; // Entries whose name or username holds the query's characters in order, best first
+        QVector<EntryId> match(const QString& query, const QVector<EntryId>& within) const; // The same, only among these entries, such as the last matches
+        QStringList subgroups(const QString& group) const;  // Groups directly inside this one that hold entries, sorted, the top level is empty
+        QVector<EntryId> members(const QString& group, const QStringList& tags) const;  // Entries in this group or below carrying every tag, in list order
+        DigestTree digests(int depth, bool sealed) const;   // Every entry's digest, over its record as stored, or over its values for copies sealed under different keys
+        bool sharesKey(const Database& other) const;    // Whether another database seals entries under the same data key, as copies of one file do
 
     signals:
         void readNewData();
         void writeNewData();
 
     private:
-        static const QString NEW_ENTRY_NAME, NAME_KEY, USERNAME_KEY, PASSWORD_KEY, NOTES_KEY, ENTRIES_KEY, VERSION_KEY;  // Common values
+        enum ReadStage { READ_SCHEMA, READ_DATABASE, READ_CHUNKS, READ_ENTRIES };   // Position within a record stream
+        enum Field { VERSION_FIELD = 1, DATA_KEY_FIELD, CHUNK_COUNT_FIELD };    // Tags in the database record
+        enum Change { ADD_CHANGE = 1, UPDATE_CHANGE, REMOVE_CHANGE, CHUNK_CHANGE };  // Kinds of change record
+        enum ChangeField { CHANGE_FIELD = 1, ENTRY_FIELD, ID_FIELD, CHUNK_FIELD };   // Tags in a change record
+        static const QString NEW_ENTRY_NAME, ID_KEY, NAME_KEY, USERNAME_KEY, PASSWORD_KEY, NOTES_KEY, GROUP_KEY, TAGS_KEY, ENTRIES_KEY, VERSION_KEY;  // Common values
+        static const QString REVISIONS_KEY, REVISION_DAYS_KEY, REVISION_SEARCH_KEY; // Settings file keys
+        static const qint64 MS_PER_DAY = 24 * 60 * 60 * 1000;
+        static const int FLUSH_SIZE = 64 * 1024;    // Serialized bytes gathered before handing them to the sink
+        static const int MAX_RECORD_SIZE = 64 * 1024 * 1024;    // Bound on a single record, guards against corrupt lengths
+        static const int MIN_COMPACT_SLOTS = 1024;  // Empty entry slots tolerated before compacting, however few entries remain
         QString version;
-        QList<Entry*> entries;
+        EntryStore entries; // Every entry, in one arena
+        IdTable slotOf; // Entry slot for each id
+        SearchIndex index; // Names and usernames by entry slot, notes stay sealed and aren't searched
+        GroupIndex groups;  // Group and tag membership by entry slot
+        UndoHistory history;    // Recent states of the edited entries
+        FieldCipher cipher; // Seals entry passwords and notes
+        ChunkStore chunks;  // Contents of attached files
+        quint64 chunksLeft; // Chunk records still to read before the entries
+        QVector<QByteArray> snapshotChunks; // Chunks the snapshot being saved holds, stored once it is committed
+        bool snapshotWritten;
         int newEntryCount;
+        int compressionLevel;   // Applied to long notes as they are sealed
+        QByteArray pending; // Partial record carried between chunks
+        int readStage;
+        quint64 snapshotSchema; // Record layout of the snapshot last read or written, 0 for none
+        QList<QByteArray> changes;  // Encoded change records not yet saved
+        EntryId lastChangeId;   // Target of the newest update, so repeated edits to one field are coalesced
+        int lastChangeField;
+        int revisionCount;  // Replaced values of each field kept
+        int revisionDays;   // Days they are kept, 0 for no limit
+        bool searchRevisions;   // Whether earlier usernames are indexed
+        EntryId revisedId;  // Entry and field being typed into, whose value from before is already kept
+        int revisedField;
+
+        bool readDatabaseRecord(RecordReader& in);  // Decode the leading database record
+        int readEntry(RecordReader& in);    // Decode an entry record into a new slot, returning the slot, or -1 if malformed
+        bool readChangeRecord(RecordReader& in);    // Apply one change record
+        void recordChange(int change, int e, int field = 0);    // Remember an edit for the next save
+        void recordChunks(int e);   // Remember the chunks an entry's attachments use that aren't stored yet
+        void wipeChanges(); // Wipe and discard recorded edits
+        void removeSlot(int e); // Remove the entry in this slot, compacting once most slots are empty
+        bool restore(const EntryId& id, const QByteArray& value);   // Put an entry back as history encoded it, empty if it shouldn't exist
+        void revise(int e, int field);  // Keep a field's value before the first edit of a run of typing into it
+        QString value(int e, int field) const;  // A field's value by its EntryStore field
+        QByteArray encode(int e) const; // An entry's record, as undo history keeps it
+        QString indexText(int e) const; // Text an entry is found by
+        void appendIndex(int e);    // Index an entry just added after the last
+        void updateIndex(int e);    // Reindex an entry after an edit
+        void buildIndex();  // Index every entry at once, after a database is read or compacted
+        QVector<EntryId> idsOf(const QVector<int>& found) const;    // Ids of the entries in these slots
 };
 
 #endif // DATABASE_H
@@ -0,0 +1,62 @@
+/*
+ * Description: Definition of the DigestTree class.
+ *              A Merkle tree of entry content digests, arranged by entry id, for comparing copies of a database.
+ *              Subtrees whose hashes match hold the same entries with the same contents, so only differing ones are searched.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef DIGESTTREE_H
+#define DIGESTTREE_H
+
+#include <QVector>
+#include <algorithm>
+#include <cstring>
+#include <crypto++/blake2.h>
+#include "entryid.h"
+
+class DigestTree
+{
+    public:
+        static const int DIGEST_SIZE = 32;
+        static const int FANOUT = 16;   // Children of each node, one for each value of the next four id bits
+        static const int MAX_DEPTH = 4;
+        static const int BUCKET_SIZE = 16;  // Entries aimed for under each leaf node
+
+        DigestTree(int depth = 0);
+
+        static int depthFor(int count); // Depth that leaves about a bucket of entries under each leaf node, the same for trees that are compared
+        void add(const EntryId& id, const char* content, int length);   // Digest an entry's encoded contents
+        void build();   // Sort the entries and hash every node, once all are added
+        int depth() const;
+        int size() const;
+        bool contains(const EntryId& id) const;
+        bool same(const EntryId& id, const DigestTree& other) const;    // Whether both trees hold the entry with the same contents
+        QVector<EntryId> differences(const DigestTree& other) const;    // Entries one tree holds and the other doesn't, or holds with other contents, sorted by id
+
+    private:
+        struct Hash
+        {
+            byte bytes[DIGEST_SIZE];
+
+            bool operator==(const Hash& other) const { return memcmp(bytes, other.bytes, DIGEST_SIZE) == 0; }
+            bool operator!=(const Hash& other) const { return !(*this == other); }
+        };
+        struct Leaf
+        {
+            EntryId id;
+            Hash digest;
+
+            bool operator<(const Leaf& other) const { return id < other.id; }
+        };
+        int levels; // Depth of the leaf nodes, the root being 0
+        QVector<Leaf> leaves;   // Sorted by id once built, so each leaf node's entries are adjacent
+        QVector<int> starts;    // First entry under each leaf node, and the end after the last
+        QVector<Hash> nodes;    // Every level in turn from the root, all zero for a node without entries
+
+        static int offset(int level);   // Index of a level's first node
+        const Leaf* find(const EntryId& id) const;  // An entry's leaf, null if the tree doesn't hold it
+        void compare(const DigestTree& other, int level, int node, QVector<EntryId>& found) const;  // Descend into children whose hashes differ
+};
+
+#endif // DIGESTTREE_H
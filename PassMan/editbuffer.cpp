@@ -0,0 +1,55 @@
+/*
+ * Description: Implementation of the EditBuffer class.
+ *              Notes which fields of the entry being edited have changed, and commits them together after a pause in typing.
+ *              Each commit writes a field to the database once, however many keystrokes went into it.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Writing a field re-encrypts it, updates the search index and records an undo step, which for long notes costs far
+ * more than the keystroke that caused it.  Only which fields changed is kept here, never their text: the widgets
+ * still hold it, and are read once when the commit is made.  The timer restarts with each edit, so a commit follows
+ * the last keystroke of a burst, and anything that reads or replaces the entry flushes first rather than waiting.
+ */
+
+#include "editbuffer.h"
+
+const QString EditBuffer::DELAY_KEY = "editor/commitDelay";
+
+EditBuffer::EditBuffer(QObject* parent) : QObject(parent)
+{
+    fields = 0;
+    timer.setSingleShot(true);
+    timer.setInterval(configuredDelay());
+    connect(&timer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+int EditBuffer::configuredDelay()   // Delay from the settings file, 0 commits as soon as control returns to the event loop
+{
+    int delay = QSettings().value(DELAY_KEY, DEFAULT_DELAY).toInt();
+    return (delay < 0) ? 0 : delay;
+}
+
+void EditBuffer::edit(const EntryId& id, int field) // Note a field of this entry changed, committing another entry's edits first
+{
+    if (id.isNull()) return;
+    if (fields && entry != id) flush();
+    entry = id;
+    fields |= 1 << field;
+    timer.start();  // Restarted by every keystroke, so a burst of typing commits once
+}
+
+void EditBuffer::flush()    // Commit the edits now, such as before a save or when the entry or focus changes
+{
+    timer.stop();
+    if (!fields) return;
+    int edited = fields;
+    fields = 0; // Cleared first, so whatever the commit triggers doesn't commit again
+    emit commit(entry, edited);
+}
+
+void EditBuffer::discard()  // Forget the edits, such as once the database they belong to has closed
+{
+    timer.stop();
+    fields = 0;
+    entry = EntryId();
+}
@@ -0,0 +1,44 @@
+/*
+ * Description: Definition of the EditBuffer class.
+ *              Notes which fields of the entry being edited have changed, and commits them together after a pause in typing.
+ *              Each commit writes a field to the database once, however many keystrokes went into it.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef EDITBUFFER_H
+#define EDITBUFFER_H
+
+#include <QObject>
+#include <QSettings>
+#include <QString>
+#include <QTimer>
+#include "entryid.h"
+
+class EditBuffer : public QObject
+{
+    Q_OBJECT
+
+    public:
+        static const int DEFAULT_DELAY = 300;   // Milliseconds of quiet before edits are committed, when none is configured
+
+        EditBuffer(QObject* parent = 0);
+
+        static int configuredDelay();   // Delay from the settings file, 0 commits as soon as control returns to the event loop
+        void edit(const EntryId& id, int field);    // Note a field of this entry changed, committing another entry's edits first
+
+    public slots:
+        void flush();   // Commit the edits now, such as before a save or when the entry or focus changes
+        void discard(); // Forget the edits, such as once the database they belong to has closed
+
+    signals:
+        void commit(const EntryId& id, int fields); // Fields is a mask holding 1 << field for each EntryStore field edited
+
+    private:
+        static const QString DELAY_KEY;
+        QTimer timer;
+        EntryId entry;  // Entry the edits belong to, which may no longer be the selected one
+        int fields;
+};
+
+#endif // EDITBUFFER_H
@@ -0,0 +1,75 @@
+/*
+ * Description: Implementation of the EntryId class.
+ *              A random 128-bit identifier, given to an entry when it is created and kept with it in the file.
+ *              Unlike a position in the entry list, it stays valid as other entries are added and removed.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#include "entryid.h"
+
+EntryId::EntryId()  // The null identifier, which no entry has
+{
+    high = 0;
+    low = 0;
+}
+
+EntryId EntryId::generate() // A new random identifier
+{
+    EntryId id;
+    byte bytes[SIZE];
+    while (id.isNull())
+    {
+        CryptoPP::OS_GenerateRandomBlock(false, bytes, SIZE);   // Straight from the system, so no pool is seeded per entry
+        id = fromBytes((const char*) bytes, SIZE);
+    }
+    return id;
+}
+
+EntryId EntryId::fromBytes(const char* data, int length)    // Stored identifier, null if malformed
+{
+    EntryId id;
+    if (length != SIZE) return id;
+    id.high = qFromBigEndian<quint64>((const uchar*) data);
+    id.low = qFromBigEndian<quint64>((const uchar*) data + 8);
+    return id;
+}
+
+EntryId EntryId::fromString(const QString& text)    // Hexadecimal identifier, null if malformed
+{
+    QByteArray bytes = QByteArray::fromHex(text.toLatin1());
+    if (bytes.toHex() != text.toLatin1().toLower()) return EntryId();   // fromHex skips stray characters rather than failing
+    return fromBytes(bytes.constData(), bytes.size());
+}
+
+QByteArray EntryId::toBytes() const // Retrieve information:
+{
+    QByteArray bytes(SIZE, 0);
+    qToBigEndian<quint64>(high, (uchar*) bytes.data());
+    qToBigEndian<quint64>(low, (uchar*) bytes.data() + 8);
+    return bytes;
+}
+
+QString EntryId::toString() const { return QString::fromLatin1(toBytes().toHex()); }
+
+bool EntryId::isNull() const { return high == 0 && low == 0; }
+
+quint64 EntryId::hash(quint64 seed) const   // Well mixed, so ids chosen to collide still spread out under an unknown seed
+{
+    return mix(mix(high ^ seed) ^ low);
+}
+
+quint64 EntryId::leading(int bits) const { return (bits <= 0) ? 0 : high >> (64 - bits); }   // First bits, up to 64, which spread evenly as ids are random
+
+bool EntryId::operator==(const EntryId& other) const { return high == other.high && low == other.low; }
+
+bool EntryId::operator!=(const EntryId& other) const { return !(*this == other); }
+
+bool EntryId::operator<(const EntryId& other) const { return high < other.high || (high == other.high && low < other.low); } // Ordered as the stored bytes are, so sorting groups ids by their leading bits
+
+quint64 EntryId::mix(quint64 x) // Spread every input bit across the result
+{
+    x = (x ^ (x >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
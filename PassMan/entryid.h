@@ -0,0 +1,43 @@
+/*
+ * Description: Definition of the EntryId class.
+ *              A random 128-bit identifier, given to an entry when it is created and kept with it in the file.
+ *              Unlike a position in the entry list, it stays valid as other entries are added and removed.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef ENTRYID_H
+#define ENTRYID_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtEndian>
+#include <crypto++/osrng.h>
+
+class EntryId
+{
+    public:
+        static const int SIZE = 16; // Bytes when stored
+
+        EntryId();  // The null identifier, which no entry has
+
+        static EntryId generate();  // A new random identifier
+        static EntryId fromBytes(const char* data, int length); // Stored identifier, null if malformed
+        static EntryId fromString(const QString& text); // Hexadecimal identifier, null if malformed
+        QByteArray toBytes() const; // Retrieve information:
+        QString toString() const;
+        bool isNull() const;
+        quint64 hash(quint64 seed) const;   // Well mixed, so ids chosen to collide still spread out under an unknown seed
+        quint64 leading(int bits) const;    // First bits, up to 64, which spread evenly as ids are random
+        bool operator==(const EntryId& other) const;
+        bool operator!=(const EntryId& other) const;
+        bool operator<(const EntryId& other) const; // Ordered as the stored bytes are, so sorting groups ids by their leading bits
+
+    private:
+        quint64 high;
+        quint64 low;
+
+        static quint64 mix(quint64 x);  // Spread every input bit across the result
+};
+
+#endif // ENTRYID_H
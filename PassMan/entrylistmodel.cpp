@@ -0,0 +1,76 @@
+/*
+ * Description: Implementation of the EntryListModel class.
+ *              Lists the entries shown in the entry list, by id, with names read from the database as rows are drawn.
+ *              Adding, removing or renaming one entry signals just that row, so the view's work doesn't grow with the database.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * The model holds only ids, and the view asks for the names of the rows it draws, so listing a database allocates
+ * nothing for each entry.  A new filter or group swaps the whole list in one reset.
+ * Rows are found by id through a hash table, as edits refresh one entry's row on every commit.  Removing a row
+ * renumbers the rows after it, which is no worse than closing the gap in the list.
+ */
+
+#include "entrylistmodel.h"
+
+EntryListModel::EntryListModel(Database* db, QObject* parent) : QAbstractTableModel(parent)
+{
+    this->db = db;
+}
+
+int EntryListModel::rowCount(const QModelIndex& parent) const { return parent.isValid() ? 0 : rows.size(); }
+
+int EntryListModel::columnCount(const QModelIndex& parent) const { return parent.isValid() ? 0 : 1; }
+
+QVariant EntryListModel::data(const QModelIndex& index, int role) const    // Entry name, only read for rows the view draws
+{
+    if (role != Qt::DisplayRole || !index.isValid() || index.row() >= rows.size()) return QVariant();
+    return db->name(rows.at(index.row()));
+}
+
+void EntryListModel::setEntries(const QVector<EntryId>& ids)    // List other entries, such as the matches for a new filter
+{
+    beginResetModel();
+    rows = ids;
+    rowOf.clear();
+    rowOf.reserve(rows.size());
+    for (int r = 0; r < rows.size(); r++) rowOf.insert(rows.at(r), r);
+    endResetModel();
+}
+
+void EntryListModel::append(const EntryId& id)  // List an entry after the last
+{
+    beginInsertRows(QModelIndex(), rows.size(), rows.size());
+    rowOf.insert(id, rows.size());
+    rows.append(id);
+    endInsertRows();
+}
+
+void EntryListModel::remove(const EntryId& id)  // Stop listing an entry
+{
+    int r = row(id);
+    if (r < 0) return;
+    beginRemoveRows(QModelIndex(), r, r);
+    rows.remove(r);
+    rowOf.remove(id);
+    for (int later = r; later < rows.size(); later++)
+    {
+        rowOf.remove(rows.at(later));
+        rowOf.insert(rows.at(later), later);
+    }
+    endRemoveRows();
+}
+
+void EntryListModel::refresh(const EntryId& id) // Redraw an entry's row after its name changed
+{
+    int r = row(id);
+    if (r >= 0) emit dataChanged(index(r, 0), index(r, 0));
+}
+
+const QVector<EntryId>& EntryListModel::ids() const { return rows; }    // Entry in each row
+
+EntryId EntryListModel::id(int row) const { return rows.value(row); }  // Null if there is no such row
+
+int EntryListModel::row(const EntryId& id) const { return rowOf.find(id); }    // -1 if the entry isn't listed
+
+bool EntryListModel::isEmpty() const { return rows.isEmpty(); }
@@ -0,0 +1,43 @@
+/*
+ * Description: Definition of the EntryListModel class.
+ *              Lists the entries shown in the entry list, by id, with names read from the database as rows are drawn.
+ *              Adding, removing or renaming one entry signals just that row, so the view's work doesn't grow with the database.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef ENTRYLISTMODEL_H
+#define ENTRYLISTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include "database.h"
+#include "entryid.h"
+#include "idtable.h"
+
+class EntryListModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+    public:
+        EntryListModel(Database* db, QObject* parent = 0);
+
+        int rowCount(const QModelIndex& parent = QModelIndex()) const;
+        int columnCount(const QModelIndex& parent = QModelIndex()) const;
+        QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;  // Entry name, only read for rows the view draws
+        void setEntries(const QVector<EntryId>& ids);   // List other entries, such as the matches for a new filter
+        void append(const EntryId& id); // List an entry after the last
+        void remove(const EntryId& id); // Stop listing an entry
+        void refresh(const EntryId& id);    // Redraw an entry's row after its name changed
+        const QVector<EntryId>& ids() const;    // Entry in each row
+        EntryId id(int row) const;  // Null if there is no such row
+        int row(const EntryId& id) const;   // -1 if the entry isn't listed
+        bool isEmpty() const;
+
+    private:
+        Database* db;
+        QVector<EntryId> rows;
+        IdTable rowOf;  // Row of each listed entry, so finding one doesn't scan the list
+};
+
+#endif // ENTRYLISTMODEL_H
@@ -0,0 +1,145 @@
+/*
+ * Description: Implementation of the EntryMap class.
+ *              An immutable map from entry ids to encoded entries.  Changing it gives a new map that shares every node
+ *              off the changed path with the old one, so keeping many versions costs little more than keeping one.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * A hash trie: each level picks one of sixteen buckets by the next four bits of an id's seeded hash.  An id sits in
+ * the first bucket along its path that it doesn't share, and only moves down a level when another id arrives there.
+ * Inserting or removing copies the few nodes from the root to that bucket, and every other node is shared by
+ * reference, so a change costs a handful of small nodes however many ids the map holds.
+ * A value is wiped when the last node holding it is freed.
+ */
+
+#include "entrymap.h"
+
+EntryMap::EntryMap()
+{
+    count = 0;
+    CryptoPP::OS_GenerateRandomBlock(false, (byte*) &seed, sizeof(seed));
+}
+
+bool EntryMap::contains(const EntryId& id) const { return find(id) != 0; }  // Whether this id is mapped, even to an empty value
+
+QByteArray EntryMap::value(const EntryId& id) const // Value mapped to this id, empty if there is none
+{
+    const QByteArray* found = find(id);
+    return found ? *found : QByteArray();
+}
+
+EntryMap EntryMap::inserted(const EntryId& id, const QByteArray& value) const   // A copy with this id mapped to this value
+{
+    EntryMap copy(*this);
+    bool added = false;
+    copy.root = insert(root.data(), 0, id.hash(seed), id, value, added);
+    if (added) copy.count++;
+    return copy;
+}
+
+EntryMap EntryMap::removed(const EntryId& id) const // A copy without this id
+{
+    if (!contains(id)) return *this;    // Nothing to copy
+    EntryMap copy(*this);
+    bool found = false;
+    copy.root = remove(root.data(), 0, id.hash(seed), id, found);
+    copy.count--;
+    return copy;
+}
+
+int EntryMap::size() const { return count; }    // Number of ids mapped
+
+const QByteArray* EntryMap::find(const EntryId& id) const   // Value mapped to this id, null if there is none
+{
+    quint64 hash = id.hash(seed);
+    const Node* node = root.data();
+    for (int depth = 0; node; depth++)
+    {
+        if (depth == MAX_DEPTH)
+        {
+            int i = node->spilledIds.indexOf(id);
+            return (i >= 0) ? &node->spilledValues.at(i) : 0;
+        }
+        int b = bucket(hash, depth);
+        if (node->ids[b] == id && !id.isNull()) return &node->values[b];
+        node = node->children[b].data();
+    }
+    return 0;
+}
+
+EntryMap::NodePointer EntryMap::insert(const Node* node, int depth, quint64 hash, const EntryId& id, const QByteArray& value, bool& added) const  // Copy of the path to this id with it mapped
+{
+    NodePointer copy(node ? new Node(*node) : new Node);    // Shares the children it doesn't replace
+    if (depth == MAX_DEPTH) // Every bit of the hash matched, which only a chosen seed makes likely
+    {
+        int i = copy->spilledIds.indexOf(id);
+        if (i >= 0) copy->spilledValues[i] = value;
+        else
+        {
+            copy->spilledIds.append(id);
+            copy->spilledValues.append(value);
+            added = true;
+        }
+        return copy;
+    }
+    int b = bucket(hash, depth);
+    if (copy->ids[b] == id) copy->values[b] = value;
+    else if (copy->children[b]) copy->children[b] = insert(copy->children[b].data(), depth + 1, hash, id, value, added);
+    else if (copy->ids[b].isNull())
+    {
+        copy->ids[b] = id;
+        copy->values[b] = value;
+        added = true;
+    }
+    else    // Occupied by another id, so both move down a level
+    {
+        bool moved = false;
+        NodePointer child = insert(0, depth + 1, copy->ids[b].hash(seed), copy->ids[b], copy->values[b], moved);
+        copy->children[b] = insert(child.data(), depth + 1, hash, id, value, added);
+        copy->ids[b] = EntryId();
+        copy->values[b] = QByteArray();
+    }
+    return copy;
+}
+
+EntryMap::NodePointer EntryMap::remove(const Node* node, int depth, quint64 hash, const EntryId& id, bool& found) const   // Copy of the path to this id without it, null if the node empties
+{
+    NodePointer copy(new Node(*node));
+    if (depth == MAX_DEPTH)
+    {
+        int i = copy->spilledIds.indexOf(id);
+        if (i >= 0)
+        {
+            copy->spilledIds.remove(i);
+            copy->spilledValues.remove(i);
+            found = true;
+        }
+    }
+    else
+    {
+        int b = bucket(hash, depth);
+        if (copy->ids[b] == id)
+        {
+            copy->ids[b] = EntryId();
+            copy->values[b] = QByteArray();
+            found = true;
+        }
+        else if (copy->children[b]) copy->children[b] = remove(copy->children[b].data(), depth + 1, hash, id, found);
+    }
+    return copy->isEmpty() ? NodePointer() : copy;
+}
+
+int EntryMap::bucket(quint64 hash, int depth) { return (int) (hash >> (depth * BITS)) & (WIDTH - 1); }
+
+EntryMap::Node::~Node()
+{
+    for (int b = 0; b < WIDTH; b++) if (values[b].isDetached()) values[b].fill(0);   // Wiped once no other node shares it
+    for (int i = 0; i < spilledValues.size(); i++) if (spilledValues.at(i).isDetached()) spilledValues[i].fill(0);
+}
+
+bool EntryMap::Node::isEmpty() const
+{
+    if (!spilledIds.isEmpty()) return false;
+    for (int b = 0; b < WIDTH; b++) if (children[b] || !ids[b].isNull()) return false;
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * Description: Definition of the EntryMap class.
+ *              An immutable map from entry ids to encoded entries.  Changing it gives a new map that shares every node
+ *              off the changed path with the old one, so keeping many versions costs little more than keeping one.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef ENTRYMAP_H
+#define ENTRYMAP_H
+
+#include <QByteArray>
+#include <QExplicitlySharedDataPointer>
+#include <QSharedData>
+#include <QVector>
+#include "entryid.h"
+
+class EntryMap
+{
+    public:
+        EntryMap(); // An empty map
+
+        bool contains(const EntryId& id) const; // Whether this id is mapped, even to an empty value
+        QByteArray value(const EntryId& id) const;  // Value mapped to this id, empty if there is none
+        EntryMap inserted(const EntryId& id, const QByteArray& value) const;    // A copy with this id mapped to this value
+        EntryMap removed(const EntryId& id) const;  // A copy without this id
+        int size() const;   // Number of ids mapped
+
+    private:
+        static const int BITS = 4;  // Hash bits consumed at each level
+        static const int WIDTH = 1 << BITS; // Buckets in a node
+        static const int MAX_DEPTH = 64 / BITS; // Levels before the hash runs out
+        struct Node : public QSharedData   // Never changed once another map can see it
+        {
+            QExplicitlySharedDataPointer<Node> children[WIDTH];
+            EntryId ids[WIDTH]; // Id held directly in each bucket, null where there is none
+            QByteArray values[WIDTH];
+            QVector<EntryId> spilledIds;    // Ids whose whole hash matched another's, only below the deepest level
+            QVector<QByteArray> spilledValues;
+            ~Node();
+            bool isEmpty() const;
+        };
+        typedef QExplicitlySharedDataPointer<Node> NodePointer;
+        NodePointer root;
+        quint64 seed;   // Random per family of maps, so a file can't choose ids that pile up in one bucket
+        int count;
+
+        const QByteArray* find(const EntryId& id) const;    // Value mapped to this id, null if there is none
+        NodePointer insert(const Node* node, int depth, quint64 hash, const EntryId& id, const QByteArray& value, bool& added) const;  // Copy of the path to this id with it mapped
+        NodePointer remove(const Node* node, int depth, quint64 hash, const EntryId& id, bool& found) const;   // Copy of the path to this id without it, null if the node empties
+        static int bucket(quint64 hash, int depth);
+};
+
+#endif // ENTRYMAP_H
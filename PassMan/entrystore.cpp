@@ -0,0 +1,556 @@
+/*
+ * Description: Implementation of the EntryStore class.  Holds the user data of every entry in the database.
+ *              Values are kept as UTF-8 in a single wiped arena of locked memory, and each entry is a fixed-size record of offsets into it.
+ *              Entries are addressed by slot.  Removing one empties its slot in place, and compact() closes the gaps.
+ *              Provides binary record methods for storage, and JSON methods for export.
+ *              Passwords and notes are held sealed, and only decrypted on request.  Long notes are compressed before sealing.
+ *              Each entry also has a group path and a set of tags, kept in the open like its name.
+ *              Replaced usernames, passwords and notes are kept in a history, with notes held as edits of the newer value.
+ *              Each field also records when it was last modified, for merging copies that were edited apart.
+ *              Attached files are listed by name and size, with the digests of the chunks holding their contents (see ChunkStore).
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Edited values are written to the end of the arena, and the bytes they replace are wiped on the spot.  Once the
+ * arena is full its live values are copied into a new one, leaving at least as much room again, and the old one is
+ * wiped as it is freed.  Loading a database needs just that one arena and the record array, however many entries.
+ * The history is one value of the entry, a run of length-prefixed records, newest first, each giving the field, when
+ * its value was replaced, and the value.  Passwords keep the sealed bytes they already had.  Notes are kept as a sealed
+ * edit (see ValueDelta) of the next newer notes, the newest against the current ones, so only the current notes are
+ * held whole.  Replacing the notes rewrites that newest edit against the new value, and dropping the oldest breaks
+ * nothing, as no newer one depends on it.
+ * Modification times are another value, a run of integer fields tagged like the entry's own fields.
+ * The attachment list is another run of length-prefixed records, one for each file.  The contents live in the
+ * database's chunk store, so an entry only holds 32 bytes for each chunk, and copying a list copies no contents.
+ */
+
+#include "entrystore.h"
+
+EntryStore::EntryStore()
+{
+    used = 0;
+    garbage = 0;
+    removed = 0;
+}
+
+EntryStore::~EntryStore() { clear(); }
+
+void EntryStore::reserve(int bytes) // Size the arena up front, such as for a database about to be read
+{
+    quint64 live = used - garbage;
+    if (bytes > 0 && live + bytes > arena.size()) reclaim(bytes);
+}
+
+int EntryStore::append(const EntryId& id, const QString& name, const QString& username)  // Add an entry in a new slot after the last, returning the slot
+{
+    Record empty;
+    memset(empty.spans, 0, sizeof(empty.spans));
+    empty.flags = 0;
+    empty.id = id;
+    records.append(empty);
+    int e = records.size() - 1;
+    setName(e, name);
+    setUsername(e, username);
+    return e;
+}
+
+void EntryStore::remove(int e)  // Remove an entry, wiping its values and leaving its slot empty
+{
+    Record& record = records[e];
+    if (record.flags & REMOVED) return;
+    for (int slot = 0; slot < SLOT_COUNT; slot++) release(record.spans[slot]);
+    memset(record.spans, 0, sizeof(record.spans));
+    record.flags = REMOVED;
+    record.id = EntryId();
+    removed++;
+}
+
+void EntryStore::compact()  // Close up the empty slots, keeping the other entries in order
+{
+    int kept = 0;
+    for (int e = 0; e < records.size(); e++)
+    {
+        if (records.at(e).flags & REMOVED) continue;
+        if (kept != e) records[kept] = records.at(e);
+        kept++;
+    }
+    records.resize(kept);
+    removed = 0;
+}
+
+void EntryStore::swap(EntryStore& other)    // Exchange every entry with another store, without copying the arenas
+{
+    arena.swap(other.arena);
+    qSwap(used, other.used);
+    qSwap(garbage, other.garbage);
+    records.swap(other.records);
+    qSwap(removed, other.removed);
+}
+
+void EntryStore::clear()    // Wipe and free every entry at once
+{
+    if (used > 0) memset(arena.BytePtr(), 0, used);
+    arena.New(0);   // Freed straight away, rather than kept for the next database
+    records.clear();
+    used = 0;
+    garbage = 0;
+    removed = 0;
+}
+
+int EntryStore::size() const { return records.size(); }    // Number of slots, empty ones included
+
+int EntryStore::count() const { return records.size() - removed; } // Number of entries held
+
+bool EntryStore::contains(int e) const { return e >= 0 && e < records.size() && !(records.at(e).flags & REMOVED); }   // Whether a slot holds an entry
+
+bool EntryStore::read(int e, RecordReader& in)  // Apply a binary record's fields to an entry, false if malformed
+{
+    while (!in.atEnd())
+    {
+        quint64 tag;
+        const char* value;
+        int length;
+        if (!in.field(tag, value, length)) return false;
+        switch (tag)
+        {
+            case NAME_FIELD:
+                store(e, NAME_SLOT, value, length);
+                break;
+            case USERNAME_FIELD:
+                store(e, USERNAME_SLOT, value, length);
+                break;
+            case PASSWORD_FIELD:    // Secrets are never stored in the clear
+            case NOTES_FIELD:
+                return false;
+            case SEALED_PASSWORD_FIELD: // Kept sealed, nothing is decrypted while loading
+                store(e, PASSWORD_SLOT, value, length);
+                break;
+            case SEALED_NOTES_FIELD:
+                store(e, NOTES_SLOT, value, length);
+                records[e].flags &= ~NOTES_DEFLATED;
+                break;
+            case DEFLATED_NOTES_FIELD:  // Sealed under its own tag, so the flag can't be stripped
+                store(e, NOTES_SLOT, value, length);
+                records[e].flags |= NOTES_DEFLATED;
+                break;
+            case GROUP_FIELD:
+                store(e, GROUP_SLOT, value, length);
+                break;
+            case TAGS_FIELD:
+                store(e, TAGS_SLOT, value, length);
+                break;
+            case REVISIONS_FIELD:
+                store(e, REVISIONS_SLOT, value, length);
+                break;
+            case MODIFIED_FIELD:
+                store(e, MODIFIED_SLOT, value, length);
+                break;
+            case ATTACHMENTS_FIELD:
+                store(e, ATTACHMENTS_SLOT, value, length);
+                break;
+            case ID_FIELD:
+                records[e].id = EntryId::fromBytes(value, length);
+                if (records.at(e).id.isNull()) return false;
+                break;
+            default:    // Field from a newer version, skip it
+                break;
+        }
+    }
+    return true;
+}
+
+void EntryStore::write(int e, RecordWriter& out) const  // Store an entry as a binary record
+{
+    out.field(ID_FIELD, records.at(e).id.toBytes());
+    out.field(NAME_FIELD, view(e, NAME_SLOT));
+    out.field(USERNAME_FIELD, view(e, USERNAME_SLOT));
+    out.field(SEALED_PASSWORD_FIELD, view(e, PASSWORD_SLOT));
+    out.field((records.at(e).flags & NOTES_DEFLATED) ? DEFLATED_NOTES_FIELD : SEALED_NOTES_FIELD, view(e, NOTES_SLOT));
+    out.field(GROUP_FIELD, view(e, GROUP_SLOT));
+    out.field(TAGS_FIELD, view(e, TAGS_SLOT));
+    out.field(REVISIONS_FIELD, view(e, REVISIONS_SLOT));
+    out.field(MODIFIED_FIELD, view(e, MODIFIED_SLOT));
+    out.field(ATTACHMENTS_FIELD, view(e, ATTACHMENTS_SLOT));
+}
+
+void EntryStore::write(int e, RecordWriter& out, int field) const   // Store a single field, which read() applies on top of existing data
+{
+    switch (field)  // Fields with a history carry it too, as replacing them may have added to it, and every field carries the modification times
+    {
+        case NAME_FIELD:
+            out.field(NAME_FIELD, view(e, NAME_SLOT));
+            break;
+        case USERNAME_FIELD:
+            out.field(USERNAME_FIELD, view(e, USERNAME_SLOT));
+            out.field(REVISIONS_FIELD, view(e, REVISIONS_SLOT));
+            break;
+        case PASSWORD_FIELD:
+            out.field(SEALED_PASSWORD_FIELD, view(e, PASSWORD_SLOT));
+            out.field(REVISIONS_FIELD, view(e, REVISIONS_SLOT));
+            break;
+        case NOTES_FIELD:
+            out.field((records.at(e).flags & NOTES_DEFLATED) ? DEFLATED_NOTES_FIELD : SEALED_NOTES_FIELD, view(e, NOTES_SLOT));
+            out.field(REVISIONS_FIELD, view(e, REVISIONS_SLOT));
+            break;
+        case GROUP_FIELD:
+            out.field(GROUP_FIELD, view(e, GROUP_SLOT));
+            break;
+        case TAGS_FIELD:
+            out.field(TAGS_FIELD, view(e, TAGS_SLOT));
+            break;
+        case ATTACHMENTS_FIELD:
+            out.field(ATTACHMENTS_FIELD, view(e, ATTACHMENTS_SLOT));
+            break;
+    }
+    out.field(MODIFIED_FIELD, view(e, MODIFIED_SLOT));
+}
+
+EntryId EntryStore::id(int e) const { return records.at(e).id; }  // Retrieve information:
+
+QString EntryStore::name(int e) const { return text(e, NAME_SLOT); }
+
+QString EntryStore::username(int e) const { return text(e, USERNAME_SLOT); }
+
+QString EntryStore::password(int e, const FieldCipher& cipher) const { return cipher.open(view(e, PASSWORD_SLOT), PASSWORD_FIELD); }   // Decrypted on each call, callers shouldn't keep it around
+
+QString EntryStore::notes(int e, const FieldCipher& cipher) const
+{
+    SecureBlock clear;   // Wiped when released
+    if (!notes(e, cipher, clear)) return QString();
+    return QString::fromUtf8((const char*) clear.BytePtr(), (int) clear.size());
+}
+
+QString EntryStore::group(int e) const { return text(e, GROUP_SLOT); }   // Slash-separated path, empty for the top level
+
+QStringList EntryStore::tags(int e) const
+{
+    QString joined = text(e, TAGS_SLOT);
+    return joined.isEmpty() ? QStringList() : joined.split(QChar('\n'));
+}
+
+qint64 EntryStore::modified(int e, int field) const // When a field was last set, in milliseconds since the epoch, 0 if unknown
+{
+    QByteArray times = view(e, MODIFIED_SLOT);
+    RecordReader in(times.constData(), times.size());
+    while (!in.atEnd())
+    {
+        quint64 tag, time;
+        const char* value;
+        int length;
+        if (!in.field(tag, value, length)) break;
+        if (tag == (quint64) field && RecordReader::integer(value, length, time)) return (qint64) time;
+    }
+    return 0;
+}
+
+QVector<EntryStore::Attachment> EntryStore::attachments(int e) const    // Files attached to the entry, in the order they were attached
+{
+    QVector<Attachment> list;
+    QByteArray all = view(e, ATTACHMENTS_SLOT);
+    RecordReader in(all.constData(), all.size());
+    while (!in.atEnd())
+    {
+        quint64 size;
+        if (!in.varint(size) || size > (quint64) in.remaining()) break;
+        RecordReader body(in.current(), (int) size);
+        in.skip((int) size);
+        Attachment file;
+        file.size = 0;
+        while (!body.atEnd())
+        {
+            quint64 tag;
+            const char* value;
+            int length;
+            if (!body.field(tag, value, length)) return list;
+            if (tag == FILE_NAME_FIELD) file.name = QString::fromUtf8(value, length);
+            if (tag == FILE_SIZE_FIELD) RecordReader::integer(value, length, file.size);
+            if (tag == CHUNKS_FIELD) file.chunks = QByteArray(value, length);
+        }
+        list.append(file);
+    }
+    return list;
+}
+
+QVector<EntryStore::Revision> EntryStore::revisions(int e) const    // Values the entry's fields held before, newest first, without decrypting any
+{
+    QVector<Revision> list;
+    foreach (const Kept& k, kept(e)) list.append(k.revision);
+    return list;
+}
+
+QString EntryStore::revision(int e, int r, const FieldCipher& cipher) const // One of those values, decrypted on each call like the current ones
+{
+    QVector<Kept> history = kept(e);
+    if (r < 0 || r >= history.size()) return QString();
+    const Kept& k = history.at(r);
+    if (k.revision.field == USERNAME_FIELD) return QString::fromUtf8(k.value);
+    if (k.revision.field == PASSWORD_FIELD) return cipher.open(k.value, PASSWORD_FIELD);
+    SecureBlock value, delta, older;
+    if (!notes(e, cipher, value)) return QString();
+    for (int i = 0; i <= r; i++)    // Each kept notes value is an edit of the next newer one
+    {
+        if (history.at(i).revision.field != NOTES_FIELD) continue;
+        if (!cipher.open(history.at(i).value, NOTES_DELTA_FIELD, delta) || !ValueDelta::apply(value.BytePtr(), value.size(), delta.BytePtr(), delta.size(), older)) return QString();
+        value.swap(older);
+    }
+    return QString::fromUtf8((const char*) value.BytePtr(), (int) value.size());
+}
+
+void EntryStore::keep(int e, int field, qint64 time, const FieldCipher& cipher)    // Put a field's value at the front of the history as it is about to be replaced, nothing for an empty one
+{
+    Revision revision;
+    revision.field = field;
+    revision.time = time;
+    QByteArray value;
+    switch (field)
+    {
+        case USERNAME_FIELD:
+            value = view(e, USERNAME_SLOT);
+            break;
+        case PASSWORD_FIELD:    // Already sealed, so kept without decrypting
+            value = view(e, PASSWORD_SLOT);
+            break;
+        case NOTES_FIELD:   // The same as the current notes, until setNotes() replaces them
+        {
+            if (view(e, NOTES_SLOT).isEmpty()) return;
+            SecureBlock delta;
+            ValueDelta::identity(delta);
+            value = cipher.seal((const char*) delta.BytePtr(), (int) delta.size(), NOTES_DELTA_FIELD);
+            break;
+        }
+        default:
+            return;
+    }
+    if (value.isEmpty()) return;    // Empty values stay empty when sealed
+    QByteArray history = encodeRevision(revision, value);   // Copied out, as storing wipes the old history first
+    history.append(view(e, REVISIONS_SLOT));
+    store(e, REVISIONS_SLOT, history.constData(), history.size());
+}
+
+void EntryStore::prune(int e, int count, qint64 since)  // Drop values of each field past the newest count, or replaced before this time
+{
+    QVector<Kept> history = kept(e);
+    QByteArray left;
+    int seen[NOTES_FIELD + 1] = { 0 };
+    bool dropped[NOTES_FIELD + 1] = { false };  // Once one value of a field goes, every older one does, so notes edits stay chained
+    foreach (const Kept& k, history)
+    {
+        int field = k.revision.field;
+        if (field < USERNAME_FIELD || field > NOTES_FIELD) continue;
+        seen[field]++;
+        if (dropped[field] || seen[field] > count || k.revision.time < since) dropped[field] = true;
+        else left.append(k.encoded);
+    }
+    if (left.size() != view(e, REVISIONS_SLOT).size()) store(e, REVISIONS_SLOT, left.constData(), left.size());
+}
+
+void EntryStore::setId(int e, const EntryId& id) { records[e].id = id; }  // Set information:
+
+void EntryStore::setName(int e, const QString& name)
+{
+    QByteArray utf8 = name.toUtf8();
+    store(e, NAME_SLOT, utf8.constData(), utf8.size());
+}
+
+void EntryStore::setUsername(int e, const QString& username)
+{
+    QByteArray utf8 = username.toUtf8();
+    store(e, USERNAME_SLOT, utf8.constData(), utf8.size());
+}
+
+void EntryStore::setPassword(int e, const QString& password, const FieldCipher& cipher)    // Sealed straight away
+{
+    QByteArray sealed = cipher.seal(password, PASSWORD_FIELD);
+    store(e, PASSWORD_SLOT, sealed.constData(), sealed.size());
+}
+
+void EntryStore::setNotes(int e, const QString& notes, const FieldCipher& cipher, int level)   // Compressed at this level first when that makes them smaller, as are kept notes
+{
+    QByteArray utf8 = notes.toUtf8();
+    QVector<Kept> history = kept(e);
+    int newest = 0;
+    while (newest < history.size() && history.at(newest).revision.field != NOTES_FIELD) newest++;
+    if (newest < history.size())    // The newest kept notes are an edit of these, so rewrite it against the new ones
+    {
+        SecureBlock current, delta, older;
+        QByteArray rebased;
+        if (this->notes(e, cipher, current) && cipher.open(history.at(newest).value, NOTES_DELTA_FIELD, delta) && ValueDelta::apply(current.BytePtr(), current.size(), delta.BytePtr(), delta.size(), older))
+        {
+            ValueDelta::make((const byte*) utf8.constData(), utf8.size(), older.BytePtr(), older.size(), level, delta);
+            rebased = encodeRevision(history.at(newest).revision, cipher.seal((const char*) delta.BytePtr(), (int) delta.size(), NOTES_DELTA_FIELD));
+        }
+        QByteArray left;    // Kept notes that can't be rebuilt are dropped along with any older
+        for (int i = 0; i < history.size(); i++)
+        {
+            if (i == newest) left.append(rebased);
+            else if (i < newest || history.at(i).revision.field != NOTES_FIELD || !rebased.isEmpty()) left.append(history.at(i).encoded);
+        }
+        store(e, REVISIONS_SLOT, left.constData(), left.size());
+    }
+    SecureBlock packed;
+    bool deflated = Compressor::compress(utf8.constData(), utf8.size(), level, packed);
+    QByteArray sealed;
+    if (deflated) sealed = cipher.seal((const char*) packed.BytePtr(), (int) packed.size(), DEFLATED_NOTES_FIELD);
+    else sealed = cipher.seal(utf8.constData(), utf8.size(), NOTES_FIELD);
+    utf8.fill(0);
+    store(e, NOTES_SLOT, sealed.constData(), sealed.size());
+    if (deflated) records[e].flags |= NOTES_DEFLATED;
+    else records[e].flags &= ~NOTES_DEFLATED;
+}
+
+void EntryStore::setGroup(int e, const QString& group)
+{
+    QByteArray utf8 = group.toUtf8();
+    store(e, GROUP_SLOT, utf8.constData(), utf8.size());
+}
+
+void EntryStore::setTags(int e, const QStringList& tags)    // Tags can't hold line breaks, which separate them when stored
+{
+    QByteArray utf8 = tags.join(QChar('\n')).toUtf8();
+    store(e, TAGS_SLOT, utf8.constData(), utf8.size());
+}
+
+void EntryStore::setAttachments(int e, const QVector<Attachment>& attachments)
+{
+    RecordWriter out;
+    foreach (const Attachment& file, attachments)
+    {
+        RecordWriter body;
+        body.field(FILE_NAME_FIELD, file.name);
+        body.integer(FILE_SIZE_FIELD, file.size);
+        body.field(CHUNKS_FIELD, file.chunks);
+        out.record(body);
+    }
+    store(e, ATTACHMENTS_SLOT, out.bytes().constData(), out.size());
+}
+
+void EntryStore::touch(int e, int field, qint64 time)  // Note when a field was set
+{
+    QByteArray times = view(e, MODIFIED_SLOT);
+    RecordReader in(times.constData(), times.size());
+    RecordWriter out;
+    out.integer(field, (quint64) time);
+    while (!in.atEnd())
+    {
+        quint64 tag;
+        const char* value;
+        int length;
+        if (!in.field(tag, value, length)) break;
+        if (tag != (quint64) field) out.field(tag, value, length);
+    }
+    store(e, MODIFIED_SLOT, out.bytes().constData(), out.size());
+}
+
+void EntryStore::store(int e, int slot, const char* data, int length)  // Copy a value to the end of the arena, wiping the one it replaces
+{
+    release(records.at(e).spans[slot]);
+    records[e].spans[slot].offset = 0;
+    records[e].spans[slot].length = 0;
+    if (length <= 0) return;
+    if ((quint64) used + length > arena.size()) reclaim(length);
+    memcpy(arena.BytePtr() + used, data, length);
+    records[e].spans[slot].offset = used;
+    records[e].spans[slot].length = length;
+    used += length;
+}
+
+void EntryStore::release(const Span& span)  // Wipe a value that is no longer referenced
+{
+    if (span.length == 0) return;
+    memset(arena.BytePtr() + span.offset, 0, span.length);
+    garbage += span.length;
+}
+
+QString EntryStore::text(int e, int slot) const    // Decode a UTF-8 value
+{
+    const Span& span = records.at(e).spans[slot];
+    return QString::fromUtf8((const char*) arena.BytePtr() + span.offset, span.length);
+}
+
+QByteArray EntryStore::view(int e, int slot) const  // Raw value in place, only valid until the arena next changes
+{
+    const Span& span = records.at(e).spans[slot];
+    return QByteArray::fromRawData((const char*) arena.BytePtr() + span.offset, span.length);
+}
+
+bool EntryStore::notes(int e, const FieldCipher& cipher, SecureBlock& clear) const // Decrypt notes to UTF-8, false if they fail to open
+{
+    QByteArray sealed = view(e, NOTES_SLOT);
+    if (sealed.isEmpty())   // Empty values stay empty when sealed
+    {
+        clear.New(0);
+        return true;
+    }
+    if (!(records.at(e).flags & NOTES_DEFLATED)) return cipher.open(sealed, NOTES_FIELD, clear);
+    SecureBlock packed;
+    return cipher.open(sealed, DEFLATED_NOTES_FIELD, packed) && Compressor::decompress(packed.BytePtr(), packed.size(), clear);
+}
+
+QVector<EntryStore::Kept> EntryStore::kept(int e) const    // Decode the history, stopping at anything malformed
+{
+    QVector<Kept> history;
+    QByteArray all = view(e, REVISIONS_SLOT);
+    RecordReader in(all.constData(), all.size());
+    while (!in.atEnd())
+    {
+        int start = in.position();
+        quint64 size;
+        if (!in.varint(size) || size > (quint64) in.remaining()) break;
+        RecordReader body(in.current(), (int) size);
+        in.skip((int) size);
+        Kept k;
+        k.revision.field = 0;
+        k.revision.time = 0;
+        while (!body.atEnd())
+        {
+            quint64 tag, number;
+            const char* value;
+            int length;
+            if (!body.field(tag, value, length)) return history;
+            if (tag == REVISED_FIELD && RecordReader::integer(value, length, number)) k.revision.field = (int) number;
+            if (tag == TIME_FIELD && RecordReader::integer(value, length, number)) k.revision.time = (qint64) number;
+            if (tag == VALUE_FIELD) k.value = QByteArray::fromRawData(value, length);
+        }
+        k.encoded = QByteArray::fromRawData(all.constData() + start, in.position() - start);
+        history.append(k);
+    }
+    return history;
+}
+
+QByteArray EntryStore::encodeRevision(const Revision& revision, const QByteArray& value)   // History record for a kept value
+{
+    RecordWriter body;
+    body.integer(REVISED_FIELD, revision.field);
+    body.integer(TIME_FIELD, (quint64) revision.time);
+    body.field(VALUE_FIELD, value);
+    RecordWriter out;
+    out.record(body);
+    return out.bytes();
+}
+
+void EntryStore::reclaim(quint64 needed)    // Compact or grow the arena so this many more bytes fit
+{
+    quint64 live = used - garbage;
+    quint64 size = MIN_ARENA_SIZE;
+    while (size < 2 * (live + needed)) size *= 2;   // Room for as much again, so copies stay rare as the arena fills
+    if (size > 0xFFFFFFFFu) size = 0xFFFFFFFFu; // Offsets are 32-bit
+    if (live + needed > size) throw std::bad_alloc();
+    SecureBlock fresh(size);
+    quint32 written = 0;
+    for (int e = 0; e < records.size(); e++)    // Live values move over in entry order
+    {
+        Record& record = records[e];
+        for (int slot = 0; slot < SLOT_COUNT; slot++)
+        {
+            Span& span = record.spans[slot];
+            if (span.length == 0) continue;
+            memcpy(fresh.BytePtr() + written, arena.BytePtr() + span.offset, span.length);
+            span.offset = written;
+            written += span.length;
+        }
+    }
+    if (used > 0) memset(arena.BytePtr(), 0, used);
+    arena.swap(fresh);  // The old arena is freed with fresh
+    used = written;
+    garbage = 0;
+}
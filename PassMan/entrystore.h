@@ -0,0 +1,123 @@
+/*
+ * Description: Definition of the EntryStore class.  Holds the user data of every entry in the database.
+ *              Values are kept as UTF-8 in a single wiped arena of locked memory, and each entry is a fixed-size record of offsets into it.
+ *              Entries are addressed by slot.  Removing one empties its slot in place, and compact() closes the gaps.
+ *              Provides binary record methods for storage, and JSON methods for export.
+ *              Passwords and notes are held sealed, and only decrypted on request.  Long notes are compressed before sealing.
+ *              Each entry also has a group path and a set of tags, kept in the open like its name.
+ *              Replaced usernames, passwords and notes are kept in a history, with notes held as edits of the newer value.
+ *              Each field also records when it was last modified, for merging copies that were edited apart.
+ *              Attached files are listed by name and size, with the digests of the chunks holding their contents (see ChunkStore).
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef ENTRYSTORE_H
+#define ENTRYSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <new>
+#include <crypto++/secblock.h>
+#include "securememory.h"
+#include "record.h"
+#include "fieldcipher.h"
+#include "compressor.h"
+#include "entryid.h"
+#include "valuedelta.h"
+
+class EntryStore
+{
+    public:
+        enum Field { NAME_FIELD = 1, USERNAME_FIELD, PASSWORD_FIELD, NOTES_FIELD, SEALED_PASSWORD_FIELD, SEALED_NOTES_FIELD, DEFLATED_NOTES_FIELD, ID_FIELD, GROUP_FIELD, TAGS_FIELD, REVISIONS_FIELD, NOTES_DELTA_FIELD, MODIFIED_FIELD, ATTACHMENTS_FIELD, CHUNK_FIELD, DEFLATED_CHUNK_FIELD };  // Tags in the binary record encoding, secrets are only stored under the sealed tags, and the delta and chunk tags only seal values
+        struct Revision // A replaced value kept in an entry's history
+        {
+            int field;  // USERNAME_FIELD, PASSWORD_FIELD or NOTES_FIELD
+            qint64 time;    // When it was replaced, in milliseconds since the epoch
+        };
+        struct Attachment   // A file attached to an entry
+        {
+            QString name;
+            quint64 size;
+            QByteArray chunks;  // Digests of the chunks holding its contents, in order and back to back
+        };
+
+        EntryStore();
+        ~EntryStore();
+
+        void reserve(int bytes);    // Size the arena up front, such as for a database about to be read
+        int append(const EntryId& id, const QString& name, const QString& username);  // Add an entry in a new slot after the last, returning the slot
+        void remove(int e); // Remove an entry, wiping its values and leaving its slot empty
+        void compact(); // Close up the empty slots, keeping the other entries in order
+        void clear();   // Wipe and free every entry at once
+        void swap(EntryStore& other);   // Exchange every entry with another store, without copying the arenas
+        int size() const;   // Number of slots, empty ones included
+        int count() const;  // Number of entries held
+        bool contains(int e) const; // Whether a slot holds an entry
+        bool read(int e, RecordReader& in); // Apply a binary record's fields to an entry, false if malformed
+        void write(int e, RecordWriter& out) const; // Store an entry as a binary record
+        void write(int e, RecordWriter& out, int field) const;  // Store a single field, which read() applies on top of existing data
+        EntryId id(int e) const;    // Retrieve information:
+        QString name(int e) const;
+        QString username(int e) const;
+        QString password(int e, const FieldCipher& cipher) const;   // Decrypted on each call, callers shouldn't keep it around
+        QString notes(int e, const FieldCipher& cipher) const;
+        QString group(int e) const; // Slash-separated path, empty for the top level
+        QStringList tags(int e) const;
+        qint64 modified(int e, int field) const;    // When a field was last set, in milliseconds since the epoch, 0 if unknown
+        QVector<Attachment> attachments(int e) const;   // Files attached to the entry, in the order they were attached
+        QVector<Revision> revisions(int e) const;   // Values the entry's fields held before, newest first, without decrypting any
+        QString revision(int e, int r, const FieldCipher& cipher) const;    // One of those values, decrypted on each call like the current ones
+        void keep(int e, int field, qint64 time, const FieldCipher& cipher);    // Put a field's value at the front of the history as it is about to be replaced, nothing for an empty one
+        void prune(int e, int count, qint64 since); // Drop values of each field past the newest count, or replaced before this time
+        void setId(int e, const EntryId& id);   // Set information:
+        void setName(int e, const QString& name);
+        void setUsername(int e, const QString& username);
+        void setPassword(int e, const QString& password, const FieldCipher& cipher);    // Sealed straight away
+        void setNotes(int e, const QString& notes, const FieldCipher& cipher, int level);   // Compressed at this level first when that makes them smaller, as are kept notes
+        void setGroup(int e, const QString& group);
+        void setTags(int e, const QStringList& tags);   // Tags can't hold line breaks, which separate them when stored
+        void setAttachments(int e, const QVector<Attachment>& attachments);
+        void touch(int e, int field, qint64 time);  // Note when a field was set
+
+    private:
+        enum Slot { NAME_SLOT, USERNAME_SLOT, PASSWORD_SLOT, NOTES_SLOT, GROUP_SLOT, TAGS_SLOT, REVISIONS_SLOT, MODIFIED_SLOT, ATTACHMENTS_SLOT, SLOT_COUNT };   // Values held for each entry
+        enum Flag { NOTES_DEFLATED = 1, REMOVED = 2 };  // sealed notes hold compressed text, or the slot is empty
+        enum RevisionField { REVISED_FIELD = 1, TIME_FIELD, VALUE_FIELD };  // Tags in each record of the history
+        enum AttachmentField { FILE_NAME_FIELD = 1, FILE_SIZE_FIELD, CHUNKS_FIELD };    // Tags in each record of the attachment list
+        static const int MIN_ARENA_SIZE = 64 * 1024;
+        struct Span // Location of one value within the arena
+        {
+            quint32 offset;
+            quint32 length;
+        };
+        struct Record   // Fixed-size entry
+        {
+            Span spans[SLOT_COUNT];
+            quint32 flags;
+            EntryId id;
+        };
+        struct Kept // A history record in place, only valid until the arena next changes
+        {
+            Revision revision;
+            QByteArray value;   // Username, sealed password, or sealed edit of the next newer notes
+            QByteArray encoded; // Whole record, length included
+        };
+        SecureBlock arena;   // Values of every entry, back to back
+        quint32 used;   // Arena bytes written so far
+        quint32 garbage;    // Bytes of replaced or removed values, already wiped
+        QVector<Record> records;
+        int removed;    // Slots left empty by removed entries
+
+        void store(int e, int slot, const char* data, int length); // Copy a value to the end of the arena, wiping the one it replaces
+        void release(const Span& span); // Wipe a value that is no longer referenced
+        QString text(int e, int slot) const;    // Decode a UTF-8 value
+        QByteArray view(int e, int slot) const; // Raw value in place, only valid until the arena next changes
+        bool notes(int e, const FieldCipher& cipher, SecureBlock& clear) const;    // Decrypt notes to UTF-8, false if they fail to open
+        QVector<Kept> kept(int e) const;    // Decode the history, stopping at anything malformed
+        static QByteArray encodeRevision(const Revision& revision, const QByteArray& value);   // History record for a kept value
+        void reclaim(quint64 needed);   // Compact or grow the arena so this many more bytes fit
+};
+
+#endif // ENTRYSTORE_H
@@ -0,0 +1,84 @@
+/*
+ * Description: Implementation of the FieldCipher class.
+ *              Seals individual entry fields under the database's data key, using AES-256 in GCM-AE mode.
+ *              Passwords and notes stay sealed in memory, and are only decrypted when an entry is shown or exported.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Sealed value: 12-byte random nonce | ciphertext (same length as the UTF-8 value) | 16-byte tag
+ * The field tag is authenticated alongside, so a sealed password can't be passed off as notes.
+ */
+
+#include "fieldcipher.h"
+
+FieldCipher::FieldCipher() : dataKey(KEY_SIZE) { generateKey(); }
+
+FieldCipher::~FieldCipher() { clear(); }
+
+void FieldCipher::generateKey() // Start using a new random data key
+{
+    prng.GenerateBlock(dataKey.BytePtr(), KEY_SIZE);
+    schedule();
+}
+
+bool FieldCipher::setKey(const char* key, int length)   // Use a data key read from storage
+{
+    if (length != KEY_SIZE) return false;
+    memcpy(dataKey.BytePtr(), key, KEY_SIZE);
+    schedule();
+    return true;
+}
+
+const char* FieldCipher::key() const { return (const char*) dataKey.BytePtr(); } // Current data key, for storage inside the encrypted database
+
+void FieldCipher::schedule()    // Set up the ciphers for the current key
+{
+    byte nonce[NONCE_SIZE] = { 0 };   // Placeholder, every seal supplies its own nonce
+    enc.SetKeyWithIV(dataKey.BytePtr(), KEY_SIZE, nonce, NONCE_SIZE);
+    dec.SetKeyWithIV(dataKey.BytePtr(), KEY_SIZE, nonce, NONCE_SIZE);
+}
+
+QByteArray FieldCipher::seal(const QString& clear, int field) const    // Encrypt a field value, empty values stay empty
+{
+    QByteArray utf8 = clear.toUtf8();
+    QByteArray sealed = seal(utf8.constData(), utf8.size(), field);
+    utf8.fill(0);
+    return sealed;
+}
+
+QByteArray FieldCipher::seal(const char* utf8, int length, int field) const
+{
+    if (length == 0) return QByteArray();
+    QByteArray sealed(NONCE_SIZE + length + TAG_SIZE, 0);
+    byte* out = (byte*) sealed.data();
+    byte aad = (byte) field;
+    prng.GenerateBlock(out, NONCE_SIZE);    // Generate new random nonce for each seal!
+    enc.EncryptAndAuthenticate(out + NONCE_SIZE, out + NONCE_SIZE + length, TAG_SIZE, out, NONCE_SIZE, &aad, 1, (const byte*) utf8, length);
+    return sealed;
+}
+
+QString FieldCipher::open(const QByteArray& sealed, int field) const   // Decrypt a sealed field value, empty if it fails to authenticate
+{
+    SecureBlock clear;   // Wiped when released
+    if (!open(sealed, field, clear)) return QString();
+    return QString::fromUtf8((const char*) clear.BytePtr(), (int) clear.size());
+}
+
+bool FieldCipher::open(const QByteArray& sealed, int field, SecureBlock& clear) const  // Decrypt to raw bytes, false if it fails to authenticate
+{
+    int length = sealed.size() - NONCE_SIZE - TAG_SIZE;
+    if (length < 1) return false;
+    const byte* in = (const byte*) sealed.constData();
+    byte aad = (byte) field;
+    clear.CleanNew(length);
+    return dec.DecryptAndVerify(clear.BytePtr(), in + NONCE_SIZE + length, TAG_SIZE, in, NONCE_SIZE, &aad, 1, in + NONCE_SIZE, length);
+}
+
+void FieldCipher::clear() { memset(dataKey.BytePtr(), 0, KEY_SIZE); }  // Wipe the data key
+
+void FieldCipher::swap(FieldCipher& other)  // Exchange data keys with another cipher
+{
+    dataKey.swap(other.dataKey);
+    schedule();
+    other.schedule();
+}
@@ -0,0 +1,49 @@
+/*
+ * Description: Definition of the FieldCipher class.
+ *              Seals individual entry fields under the database's data key, using AES-256 in GCM-AE mode.
+ *              Passwords and notes stay sealed in memory, and are only decrypted when an entry is shown or exported.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef FIELDCIPHER_H
+#define FIELDCIPHER_H
+
+#include <QByteArray>
+#include <QString>
+#include <crypto++/aes.h>
+#include <crypto++/gcm.h>
+#include <crypto++/osrng.h>
+#include <crypto++/secblock.h>
+#include "securememory.h"
+
+class FieldCipher
+{
+    public:
+        static const int KEY_SIZE = 32;
+        static const int NONCE_SIZE = 12;
+        static const int TAG_SIZE = 16;
+
+        FieldCipher();
+        ~FieldCipher();
+
+        void generateKey(); // Start using a new random data key
+        bool setKey(const char* key, int length);   // Use a data key read from storage
+        const char* key() const;    // Current data key, for storage inside the encrypted database
+        QByteArray seal(const QString& clear, int field) const; // Encrypt a field value, empty values stay empty
+        QByteArray seal(const char* utf8, int length, int field) const;
+        QString open(const QByteArray& sealed, int field) const;    // Decrypt a sealed field value, empty if it fails to authenticate
+        bool open(const QByteArray& sealed, int field, SecureBlock& clear) const;   // Decrypt to raw bytes, false if it fails to authenticate
+        void clear();   // Wipe the data key
+        void swap(FieldCipher& other);  // Exchange data keys with another cipher
+
+    private:
+        SecureBlock dataKey;
+        mutable CryptoPP::GCM<CryptoPP::AES>::Encryption enc;
+        mutable CryptoPP::GCM<CryptoPP::AES>::Decryption dec;
+        mutable CryptoPP::AutoSeededRandomPool prng;
+
+        void schedule();    // Set up the ciphers for the current key
+};
+
+#endif // FIELDCIPHER_H
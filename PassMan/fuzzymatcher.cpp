@@ -0,0 +1,77 @@
+/*
+ * Description: Implementation of the FuzzyMatcher class.
+ *              Scores how well text matches a query whose characters appear in it in order, not necessarily together.
+ *              Matches at the start, at the start of a word, and of consecutive characters score higher.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Text only matches if it holds every character of the query, so a 64-bit signature of the characters in each text
+ * rejects most candidates with a single AND, and only the rest are scored.  Letters and digits get a bit each, and
+ * other bytes share the remaining bits.  Scoring tries each place the first query character appears, matching the
+ * rest as early as possible from there, and keeps the best.
+ */
+
+#include "fuzzymatcher.h"
+
+FuzzyMatcher::FuzzyMatcher(const QString& query)
+{
+    this->query = fold(query);
+    needed = signature(this->query);
+}
+
+QByteArray FuzzyMatcher::fold(const QString& text) { return text.toCaseFolded().toUtf8(); }    // Case-folded UTF-8, as matched
+
+quint64 FuzzyMatcher::signature(const QByteArray& folded)   // Set of the characters in folded text, as one bit each
+{
+    quint64 bits = 0;
+    for (int i = 0; i < folded.size(); i++)
+    {
+        uchar c = folded.at(i);
+        if (c >= 'a' && c <= 'z') bits |= Q_UINT64_C(1) << (c - 'a');
+        else if (c >= '0' && c <= '9') bits |= Q_UINT64_C(1) << (26 + c - '0');
+        else bits |= Q_UINT64_C(1) << (36 + c % 28);
+    }
+    return bits;
+}
+
+quint64 FuzzyMatcher::signature() const { return needed; } // Retrieve information:
+
+bool FuzzyMatcher::isEmpty() const { return query.isEmpty(); }
+
+int FuzzyMatcher::score(const QByteArray& folded) const // Quality of the best match in folded text, or -1 if there is none
+{
+    const char* text = folded.constData();
+    const char* q = query.constData();
+    int n = folded.size(), m = query.size();
+    int best = -1;
+    if (m == 0) return 0;
+    for (int start = 0; start + m <= n; start++)
+    {
+        if (text[start] != q[0]) continue;
+        int total = 0, last = -1, j = 0;
+        for (int i = start; i < n && j < m; i++)
+        {
+            if (text[i] != q[j]) continue;
+            total += MATCH_SCORE;
+            if (i == 0) total += PREFIX_BONUS;
+            else if (isBoundary(text[i - 1])) total += BOUNDARY_BONUS;
+            if (j > 0 && i == last + 1) total += CONSECUTIVE_BONUS;
+            else if (j > 0)
+            {
+                int gap = GAP_PENALTY + i - last - 2;
+                total -= gap < MAX_GAP_PENALTY ? gap : MAX_GAP_PENALTY;
+            }
+            last = i;
+            j++;
+        }
+        if (j < m) break;   // Starting any later can't match either
+        if (total > best) best = total;
+    }
+    return best;
+}
+
+bool FuzzyMatcher::isBoundary(char previous)    // Whether a character after this one starts a word
+{
+    uchar c = previous;
+    return c < 0x80 && !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'));   // Bytes of multibyte characters count as letters
+}
@@ -0,0 +1,41 @@
+/*
+ * Description: Definition of the FuzzyMatcher class.
+ *              Scores how well text matches a query whose characters appear in it in order, not necessarily together.
+ *              Matches at the start, at the start of a word, and of consecutive characters score higher.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+class FuzzyMatcher
+{
+    public:
+        static const int MATCH_SCORE = 16;  // Each query character matched
+        static const int PREFIX_BONUS = 32; // Character matched at the very start of the text
+        static const int BOUNDARY_BONUS = 16;   // Character matched at the start of a word
+        static const int CONSECUTIVE_BONUS = 12;    // Character matched right after the previous one
+        static const int GAP_PENALTY = 3;   // Skipping text between matched characters, plus one per further byte skipped
+        static const int MAX_GAP_PENALTY = 16;
+
+        explicit FuzzyMatcher(const QString& query);
+
+        static QByteArray fold(const QString& text);    // Case-folded UTF-8, as matched
+        static quint64 signature(const QByteArray& folded); // Set of the characters in folded text, as one bit each
+        quint64 signature() const;  // Retrieve information: characters any match must contain
+        bool isEmpty() const;
+        int score(const QByteArray& folded) const;  // Quality of the best match in folded text, or -1 if there is none
+
+    private:
+        QByteArray query;   // Case-folded UTF-8
+        quint64 needed;
+
+        static bool isBoundary(char previous);  // Whether a character after this one starts a word
+};
+
+#endif // FUZZYMATCHER_H
@@ -0,0 +1,210 @@
+/*
+ * Description: Implementation of the GroupIndex class.
+ *              Keeps the entries of each group in a sorted list and the entries with each tag in a bitmap.
+ *              Filtering by a group and any tags is a merge of lists and an AND of bitmaps, rather than a scan.
+ *              Also tracks which groups are nested in which, for browsing them as a tree.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Documents are numbered by entry slot, as in SearchIndex, so lists built in order stay sorted with plain appends.
+ * A group's members are those directly in it and in every group below it, so its list is merged with theirs.
+ * Tag bitmaps are ANDed a word at a time, and a group's members are then tested against the result bit by bit.
+ * Each group counts the documents in it and below, so a group disappears from the tree with its last entry.
+ */
+
+#include "groupindex.h"
+
+const QChar GroupIndex::SEPARATOR = QChar('/');
+
+GroupIndex::GroupIndex() { }
+
+GroupIndex::~GroupIndex() { clear(); }
+
+QString GroupIndex::normalGroup(const QString& group)  // Path without blank levels or padding, empty for the top level
+{
+    QStringList levels;
+    foreach (const QString& level, group.split(SEPARATOR))
+    {
+        QString trimmed = level.simplified();   // Line breaks can't survive either
+        if (!trimmed.isEmpty()) levels.append(trimmed);
+    }
+    return levels.join(SEPARATOR);
+}
+
+QStringList GroupIndex::normalTags(const QStringList& tags) // Trimmed, without blanks, line breaks or repeats ignoring case
+{
+    QStringList normal, seen;
+    foreach (const QString& tag, tags)
+    {
+        QString trimmed = tag.simplified();
+        if (trimmed.isEmpty() || seen.contains(fold(trimmed))) continue;
+        seen.append(fold(trimmed));
+        normal.append(trimmed);
+    }
+    return normal;
+}
+
+void GroupIndex::append(const QString& group, const QStringList& tags)  // Index a new document, numbered after the last
+{
+    groupOf.append(group);
+    QStringList folded;
+    foreach (const QString& tag, tags) folded.append(fold(tag));
+    tagsOf.append(folded);
+    present.append(true);
+    join(present.size() - 1);
+}
+
+void GroupIndex::update(int document, const QString& group, const QStringList& tags)   // Reindex a document whose group or tags changed
+{
+    if (!present.at(document)) return;
+    QStringList folded;
+    foreach (const QString& tag, tags) folded.append(fold(tag));
+    if (group == groupOf.at(document) && folded == tagsOf.at(document)) return;    // Names and usernames change far more often
+    leave(document);
+    groupOf[document] = group;
+    tagsOf[document] = folded;
+    join(document);
+}
+
+void GroupIndex::remove(int document)   // Drop a document, its number isn't reused
+{
+    if (!present.at(document)) return;
+    leave(document);
+    groupOf[document].clear();
+    tagsOf[document].clear();
+    present[document] = false;
+}
+
+void GroupIndex::swap(GroupIndex& other)
+{
+    groupOf.swap(other.groupOf);
+    tagsOf.swap(other.tagsOf);
+    present.swap(other.present);
+    lists.swap(other.lists);
+    population.swap(other.population);
+    children.swap(other.children);
+    bitmaps.swap(other.bitmaps);
+}
+
+void GroupIndex::clear()
+{
+    groupOf.clear();
+    tagsOf.clear();
+    present.clear();
+    lists.clear();
+    population.clear();
+    children.clear();
+    bitmaps.clear();
+}
+
+QStringList GroupIndex::subgroups(const QString& group) const { return children.value(group); } // Groups directly inside this one that hold documents, sorted
+
+QVector<int> GroupIndex::members(const QString& group, const QStringList& tags) const  // Documents in this group or below carrying every tag, ascending
+{
+    QVector<int> found;
+    QVector<quint64> mask;
+    for (int t = 0; t < tags.size(); t++)   // Documents with every tag, a word at a time
+    {
+        QHash<QString, QVector<quint64> >::const_iterator bitmap = bitmaps.constFind(fold(tags.at(t)));
+        if (bitmap == bitmaps.constEnd()) return found; // No document has this tag
+        if (t == 0) mask = bitmap.value();
+        else
+        {
+            int words = qMin(mask.size(), bitmap.value().size());
+            mask.resize(words);
+            for (int w = 0; w < words; w++) mask[w] &= bitmap.value().at(w);
+        }
+    }
+    if (group.isEmpty())    // Every group
+    {
+        if (tags.isEmpty())
+        {
+            for (int d = 0; d < present.size(); d++) if (present.at(d)) found.append(d);
+            return found;
+        }
+        for (int w = 0; w < mask.size(); w++)
+        {
+            for (quint64 bits = mask.at(w); bits; bits &= bits - 1) found.append(w * WORD_BITS + qCountTrailingZeroBits(bits));
+        }
+        return found;
+    }
+    if (!population.contains(group)) return found;
+    QStringList pending(group);
+    while (!pending.isEmpty())  // Merge the lists of this group and every group below it
+    {
+        QString next = pending.takeLast();
+        pending.append(children.value(next));
+        const QVector<int> list = lists.value(next);
+        int middle = found.size();
+        found += list;
+        std::inplace_merge(found.begin(), found.begin() + middle, found.end());
+    }
+    if (tags.isEmpty()) return found;
+    int kept = 0;
+    for (int i = 0; i < found.size(); i++)
+    {
+        int d = found.at(i);
+        int w = d / WORD_BITS;
+        if (w < mask.size() && (mask.at(w) >> (d % WORD_BITS) & 1)) found[kept++] = d;
+    }
+    found.resize(kept);
+    return found;
+}
+
+void GroupIndex::join(int document) // Add a document to the lists and bitmaps for its group and tags
+{
+    const QString& group = groupOf.at(document);
+    QVector<int>& list = lists[group];
+    if (list.isEmpty() || list.last() < document) list.append(document);    // Newest document, the usual case
+    else list.insert(std::lower_bound(list.begin(), list.end(), document) - list.begin(), document);
+    for (QString path = group; ; path = parentOf(path)) // Count it in this group and every one above
+    {
+        int& count = population[path];
+        count++;
+        if (path.isEmpty()) break;
+        if (count > 1) continue;
+        QStringList& siblings = children[parentOf(path)];   // First document here, so the group appears
+        siblings.insert(std::lower_bound(siblings.begin(), siblings.end(), path) - siblings.begin(), path);
+    }
+    foreach (const QString& tag, tagsOf.at(document))
+    {
+        QVector<quint64>& bitmap = bitmaps[tag];
+        int w = document / WORD_BITS;
+        if (bitmap.size() <= w) bitmap.resize(w + 1);
+        bitmap[w] |= Q_UINT64_C(1) << (document % WORD_BITS);
+    }
+}
+
+void GroupIndex::leave(int document)    // Take a document out of them again
+{
+    const QString& group = groupOf.at(document);
+    QVector<int>& list = lists[group];
+    QVector<int>::iterator at = std::lower_bound(list.begin(), list.end(), document);
+    if (at != list.end() && *at == document) list.erase(at);
+    if (list.isEmpty()) lists.remove(group);
+    for (QString path = group; ; path = parentOf(path)) // Uncount it, dropping groups that empty
+    {
+        int& count = population[path];
+        count--;
+        if (path.isEmpty()) break;
+        if (count > 0) continue;
+        population.remove(path);
+        QString parent = parentOf(path);
+        children[parent].removeOne(path);
+        if (children.value(parent).isEmpty()) children.remove(parent);
+    }
+    foreach (const QString& tag, tagsOf.at(document))
+    {
+        QVector<quint64>& bitmap = bitmaps[tag];
+        int w = document / WORD_BITS;
+        if (w < bitmap.size()) bitmap[w] &= ~(Q_UINT64_C(1) << (document % WORD_BITS));
+    }
+}
+
+QString GroupIndex::parentOf(const QString& group)  // Group holding this one, empty at the top level
+{
+    int last = group.lastIndexOf(SEPARATOR);
+    return (last < 0) ? QString() : group.left(last);
+}
+
+QString GroupIndex::fold(const QString& tag) { return tag.toCaseFolded(); }    // Tags match ignoring case
@@ -0,0 +1,54 @@
+/*
+ * Description: Definition of the GroupIndex class.
+ *              Keeps the entries of each group in a sorted list and the entries with each tag in a bitmap.
+ *              Filtering by a group and any tags is a merge of lists and an AND of bitmaps, rather than a scan.
+ *              Also tracks which groups are nested in which, for browsing them as a tree.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef GROUPINDEX_H
+#define GROUPINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QtAlgorithms>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+
+class GroupIndex
+{
+    public:
+        static const QChar SEPARATOR;   // Between the levels of a group path
+
+        GroupIndex();
+        ~GroupIndex();
+
+        static QString normalGroup(const QString& group);   // Path without blank levels or padding, empty for the top level
+        static QStringList normalTags(const QStringList& tags); // Trimmed, without blanks, line breaks or repeats ignoring case
+        void append(const QString& group, const QStringList& tags); // Index a new document, numbered after the last
+        void update(int document, const QString& group, const QStringList& tags);   // Reindex a document whose group or tags changed
+        void remove(int document);  // Drop a document, its number isn't reused
+        void clear();
+        void swap(GroupIndex& other);
+        QStringList subgroups(const QString& group) const;  // Groups directly inside this one that hold documents, sorted
+        QVector<int> members(const QString& group, const QStringList& tags) const;  // Documents in this group or below carrying every tag, ascending
+
+    private:
+        static const int WORD_BITS = 64;
+        QVector<QString> groupOf;   // Group of each document
+        QVector<QStringList> tagsOf;    // Folded tags of each document
+        QVector<bool> present;  // Whether each document is still indexed
+        QHash<QString, QVector<int> > lists;    // Group to the sorted documents directly in it
+        QHash<QString, int> population; // Group to the documents in it and below, for groups that hold any
+        QHash<QString, QStringList> children;   // Group to the sorted groups directly inside it that hold documents
+        QHash<QString, QVector<quint64> > bitmaps;  // Folded tag to a bit per document
+
+        void join(int document);    // Add a document to the lists and bitmaps for its group and tags
+        void leave(int document);   // Take a document out of them again
+        static QString parentOf(const QString& group);  // Group holding this one, empty at the top level
+        static QString fold(const QString& tag);    // Tags match ignoring case
+};
+
+#endif // GROUPINDEX_H
@@ -0,0 +1,111 @@
+/*
+ * Description: Implementation of the IdTable class.
+ *              An open-addressing hash table from entry identifiers to the slots holding those entries.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Buckets are probed linearly from an id's home bucket, and the table grows before it is 70% full, so probes stay
+ * short.  Removal shifts back any later ids of the same run that would otherwise be cut off from their home bucket,
+ * rather than leaving a tombstone, so lookups never slow down as entries come and go.
+ */
+
+#include "idtable.h"
+
+IdTable::IdTable()
+{
+    count = 0;
+    CryptoPP::OS_GenerateRandomBlock(false, (byte*) &seed, sizeof(seed));
+    rehash(MIN_CAPACITY);
+}
+
+int IdTable::find(const EntryId& id) const  // Slot of the entry with this id, or -1
+{
+    int mask = values.size() - 1;
+    for (int i = home(id); values.at(i) >= 0; i = (i + 1) & mask)
+    {
+        if (keys.at(i) == id) return values.at(i);
+    }
+    return -1;
+}
+
+bool IdTable::insert(const EntryId& id, int slot)   // Map an id to a slot, false if it is already mapped
+{
+    if ((qint64) (count + 1) * 100 > (qint64) values.size() * MAX_LOAD) rehash(values.size() * 2);
+    int mask = values.size() - 1;
+    int i = home(id);
+    for (; values.at(i) >= 0; i = (i + 1) & mask)
+    {
+        if (keys.at(i) == id) return false;
+    }
+    keys[i] = id;
+    values[i] = slot;
+    count++;
+    return true;
+}
+
+void IdTable::remove(const EntryId& id) // Forget an id
+{
+    int mask = values.size() - 1;
+    int i = home(id);
+    for (; values.at(i) >= 0; i = (i + 1) & mask)
+    {
+        if (keys.at(i) == id) break;
+    }
+    if (values.at(i) < 0) return;   // Not present
+    for (int j = (i + 1) & mask; values.at(j) >= 0; j = (j + 1) & mask)    // Close the gap for the rest of the run
+    {
+        int k = home(keys.at(j));
+        bool reachable = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);  // Home lies after the gap, so it can stay
+        if (reachable) continue;
+        keys[i] = keys.at(j);
+        values[i] = values.at(j);
+        i = j;
+    }
+    keys[i] = EntryId();
+    values[i] = -1;
+    count--;
+}
+
+void IdTable::reserve(int ids)  // Make room for this many ids without growing
+{
+    int capacity = values.size();
+    while ((qint64) ids * 100 > (qint64) capacity * MAX_LOAD) capacity *= 2;
+    if (capacity > values.size()) rehash(capacity);
+}
+
+void IdTable::clear()
+{
+    keys.clear();
+    values.clear();
+    count = 0;
+    rehash(MIN_CAPACITY);
+}
+
+void IdTable::swap(IdTable& other)
+{
+    keys.swap(other.keys);
+    values.swap(other.values);
+    qSwap(count, other.count);
+    qSwap(seed, other.seed);
+}
+
+int IdTable::size() const { return count; } // Number of ids mapped
+
+int IdTable::home(const EntryId& id) const { return (int) (id.hash(seed) & (quint64) (values.size() - 1)); } // Bucket a probe for this id starts at
+
+void IdTable::rehash(int capacity)  // Move every id into this many buckets
+{
+    QVector<EntryId> oldKeys = keys;
+    QVector<int> oldValues = values;
+    keys = QVector<EntryId>(capacity);
+    values = QVector<int>(capacity, -1);
+    int mask = capacity - 1;
+    for (int b = 0; b < oldValues.size(); b++)
+    {
+        if (oldValues.at(b) < 0) continue;
+        int i = home(oldKeys.at(b));
+        while (values.at(i) >= 0) i = (i + 1) & mask;
+        keys[i] = oldKeys.at(b);
+        values[i] = oldValues.at(b);
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * Description: Definition of the IdTable class.
+ *              An open-addressing hash table from entry identifiers to the slots holding those entries.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef IDTABLE_H
+#define IDTABLE_H
+
+#include <QVector>
+#include "entryid.h"
+
+class IdTable
+{
+    public:
+        IdTable();
+
+        int find(const EntryId& id) const;  // Slot of the entry with this id, or -1
+        bool insert(const EntryId& id, int slot);   // Map an id to a slot, false if it is already mapped
+        void remove(const EntryId& id); // Forget an id
+        void reserve(int ids);  // Make room for this many ids without growing
+        void clear();
+        void swap(IdTable& other);
+        int size() const;   // Number of ids mapped
+
+    private:
+        static const int MIN_CAPACITY = 16; // Buckets, always a power of two
+        static const int MAX_LOAD = 70; // Percentage of buckets in use before growing
+        QVector<EntryId> keys;
+        QVector<int> values;    // Slot for each bucket, -1 where it is empty
+        int count;
+        quint64 seed;   // Random per table, so a file can't choose ids that collide
+
+        int home(const EntryId& id) const;  // Bucket a probe for this id starts at
+        void rehash(int capacity);  // Move every id into this many buckets
+};
+
+#endif // IDTABLE_H
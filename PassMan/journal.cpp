@@ -0,0 +1,70 @@
+/*
+ * Description: Implementation of the Journal class.
+ *              Seals and opens the change segments appended after a database snapshot.
+ *              Each segment is encrypted and authenticated on its own, bound to the snapshot header and its position.
+ *              Saving a few edits appends one small segment rather than rewriting the whole file.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Segment layout: 32-bit little-endian ciphertext length | 12-byte nonce | chunked ciphertext (see ChunkedCipher)
+ * Associated data: snapshot header | 64-bit little-endian segment sequence number | segment header
+ *
+ * A fresh random nonce is drawn for every segment.  The sequence number stops segments being dropped or reordered,
+ * and the snapshot header stops segments from an older snapshot being spliced in.  A segment cut short by an
+ * interrupted save is reported as torn, so the changes before it are kept.
+ */
+
+#include "journal.h"
+
+Journal::Journal(const byte* key, size_t keyLength, const VaultHeader& header, quint64 sequence)
+{
+    this->key = key;
+    this->keyLength = keyLength;
+    base = header.associatedData();
+    chunk = (header.chunkSize() > 0) ? header.chunkSize() : ChunkedCipher::CHUNK_SIZE;
+    count = sequence;
+}
+
+quint64 Journal::segmentLength(quint64 clearLength, int chunkSize) { return SEGMENT_HEADER_SIZE + ChunkedCipher::cipherLength(clearLength, chunkSize); } // File bytes taken by a segment of this much cleartext
+
+bool Journal::append(const char* data, int length, QIODevice* out)  // Seal one batch of changes as the next segment
+{
+    quint64 cipherLength = ChunkedCipher::cipherLength(length, chunk);
+    if (cipherLength > MAX_SEGMENT_SIZE) return false;
+    char segmentHeader[SEGMENT_HEADER_SIZE];
+    qToLittleEndian<quint32>((quint32) cipherLength, (uchar*) segmentHeader);
+    CryptoPP::AutoSeededRandomPool prng;
+    prng.GenerateBlock((byte*) segmentHeader + 4, VaultHeader::NONCE_SIZE);   // Generate new random nonce for each segment!
+    if (out->write(segmentHeader, SEGMENT_HEADER_SIZE) != SEGMENT_HEADER_SIZE) return false;
+    ChunkedCipher enc(key, keyLength, segmentHeader + 4, associatedData(segmentHeader), chunk);
+    if (!enc.put(data, length, out) || !enc.finish(out)) return false;
+    count++;
+    return true;
+}
+
+Journal::Status Journal::next(const char* data, qint64 size, qint64& offset, const ChunkedCipher::Sink& sink)  // Authenticate and decrypt the segment at offset
+{
+    if (offset >= size) return SEGMENT_END;
+    if (size - offset < SEGMENT_HEADER_SIZE) return SEGMENT_TORN;
+    const char* segmentHeader = data + offset;
+    quint32 cipherLength = qFromLittleEndian<quint32>((const uchar*) segmentHeader);
+    if (cipherLength < (quint32) ChunkedCipher::TAG_SIZE || cipherLength > MAX_SEGMENT_SIZE) return SEGMENT_INVALID;
+    if ((quint64) (size - offset - SEGMENT_HEADER_SIZE) < cipherLength) return SEGMENT_TORN;
+    ChunkedCipher dec(key, keyLength, segmentHeader + 4, associatedData(segmentHeader), chunk);
+    if (!dec.decrypt((const byte*) segmentHeader + SEGMENT_HEADER_SIZE, cipherLength, sink)) return SEGMENT_INVALID;
+    offset += SEGMENT_HEADER_SIZE + cipherLength;
+    count++;
+    return SEGMENT_VALID;
+}
+
+quint64 Journal::sequence() const { return count; } // Number of segments sealed or opened so far
+
+QByteArray Journal::associatedData(const char* segmentHeader) const    // Data authenticated alongside a segment
+{
+    QByteArray out(base);
+    char sequence[8];
+    qToLittleEndian<quint64>(count, (uchar*) sequence);
+    out.append(sequence, sizeof(sequence));
+    out.append(segmentHeader, SEGMENT_HEADER_SIZE);
+    return out;
+}
@@ -0,0 +1,43 @@
+/*
+ * Description: Definition of the Journal class.
+ *              Seals and opens the change segments appended after a database snapshot.
+ *              Each segment is encrypted and authenticated on its own, bound to the snapshot header and its position.
+ *              Saving a few edits appends one small segment rather than rewriting the whole file.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <crypto++/osrng.h>
+#include "vaultheader.h"
+#include "chunkedcipher.h"
+
+class Journal
+{
+    public:
+        enum Status { SEGMENT_VALID, SEGMENT_END, SEGMENT_TORN, SEGMENT_INVALID }; // Possible results of reading a segment
+        static const int SEGMENT_HEADER_SIZE = 4 + VaultHeader::NONCE_SIZE;   // Ciphertext length and nonce
+        static const quint32 MAX_SEGMENT_SIZE = 64 * 1024 * 1024;   // Bound on a single segment, guards against corrupt lengths
+
+        Journal(const byte* key, size_t keyLength, const VaultHeader& header, quint64 sequence = 0);
+
+        static quint64 segmentLength(quint64 clearLength, int chunkSize);  // File bytes taken by a segment of this much cleartext
+        bool append(const char* data, int length, QIODevice* out);  // Seal one batch of changes as the next segment
+        Status next(const char* data, qint64 size, qint64& offset, const ChunkedCipher::Sink& sink);   // Authenticate and decrypt the segment at offset
+        quint64 sequence() const;   // Number of segments sealed or opened so far
+
+    private:
+        const byte* key;
+        size_t keyLength;
+        QByteArray base;    // Snapshot header bytes every segment is bound to
+        int chunk;
+        quint64 count;
+
+        QByteArray associatedData(const char* segmentHeader) const;   // Data authenticated alongside a segment
+};
+
+#endif // JOURNAL_H
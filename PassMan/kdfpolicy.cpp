@@ -0,0 +1,82 @@
+/*
+ * Description: Implementation of the KdfPolicy class.
+ *              Holds the key derivation cost new vaults are saved with, measured once on this machine.
+ *              The measurements are kept in the persistent settings, so every save uses the same known cost.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * A vault counts as weak when its KDF falls clearly short of this machine's calibration for that same KDF: fewer
+ * PBKDF2 iterations, or less Argon2id memory or total work.  A PBKDF2 vault isn't weak merely because Argon2id is
+ * preferred, or declining the upgrade would be asked again on every open.  Benchmarks vary a little from run to run,
+ * so costs within WEAK_MARGIN of the policy are not flagged.
+ */
+
+#include "kdfpolicy.h"
+
+const double KdfPolicy::TARGET_TIME = 0.5;
+const double KdfPolicy::WEAK_MARGIN = 0.9;
+const QString KdfPolicy::KDF_KEY = "kdf/algorithm";
+const QString KdfPolicy::PBKDF2_ITERATIONS_KEY = "kdf/pbkdf2Iterations";
+const QString KdfPolicy::ARGON2_MEMORY_KEY = "kdf/argon2Memory";
+const QString KdfPolicy::ARGON2_PASSES_KEY = "kdf/argon2Passes";
+const QString KdfPolicy::ARGON2_LANES_KEY = "kdf/argon2Lanes";
+
+KdfPolicy::KdfPolicy()
+{
+    QSettings settings;
+    kdf = settings.value(KDF_KEY, VaultHeader::KDF_ARGON2ID).toInt();
+    if (kdf != VaultHeader::KDF_PBKDF2_SHA512) kdf = VaultHeader::KDF_ARGON2ID;
+    iterations = settings.value(PBKDF2_ITERATIONS_KEY, 0).toUInt();
+    memory = settings.value(ARGON2_MEMORY_KEY, 0).toUInt();
+    passes = settings.value(ARGON2_PASSES_KEY, 0).toUInt();
+    lanes = settings.value(ARGON2_LANES_KEY, 0).toUInt();
+}
+
+bool KdfPolicy::isCalibrated() const    // Whether usable costs are stored, hand-edited settings out of range are measured again
+{
+    if (iterations < 1 || iterations > (quint32) INT_MAX || passes < 1 || passes > (quint32) INT_MAX) return false;
+    if (lanes < Argon2::MIN_LANES || lanes > Argon2::MAX_LANES) return false;
+    return memory >= Argon2::MIN_MEMORY * lanes && memory <= VaultHeader::MAX_MEMORY_COST;
+}
+
+int KdfPolicy::preferredKdf() const { return kdf; }
+
+quint32 KdfPolicy::pbkdf2Iterations() const { return iterations; }
+
+quint32 KdfPolicy::argon2Memory() const { return memory; }
+
+quint32 KdfPolicy::argon2Passes() const { return passes; }
+
+quint32 KdfPolicy::argon2Lanes() const { return lanes; }
+
+bool KdfPolicy::isWeak(int kdf, quint32 iterations, quint32 memory) const   // Whether a vault's parameters fall below this policy
+{
+    if (!isCalibrated()) return false;  // Nothing to compare against yet
+    if (kdf == VaultHeader::KDF_ARGON2ID)
+    {
+        if (memory < WEAK_MARGIN * this->memory) return true;
+        return (double) memory * iterations < WEAK_MARGIN * this->memory * passes;
+    }
+    return iterations < WEAK_MARGIN * this->iterations;
+}
+
+void KdfPolicy::setPreferredKdf(int kdf)
+{
+    this->kdf = kdf;
+    QSettings().setValue(KDF_KEY, kdf);
+}
+
+void KdfPolicy::benchmark() // Measure both KDFs on this machine and store the results
+{
+    byte probe[32];
+    byte input[16] = { 0 };
+    iterations = Pbkdf2(input, sizeof(input)).deriveKey(probe, sizeof(probe), input, sizeof(input), 1, TARGET_TIME);
+    lanes = Argon2::defaultLanes();
+    Argon2::calibrate(TARGET_TIME, lanes, memory, passes);
+    memset(probe, 0, sizeof(probe));
+    QSettings settings;
+    settings.setValue(PBKDF2_ITERATIONS_KEY, iterations);
+    settings.setValue(ARGON2_MEMORY_KEY, memory);
+    settings.setValue(ARGON2_PASSES_KEY, passes);
+    settings.setValue(ARGON2_LANES_KEY, lanes);
+}
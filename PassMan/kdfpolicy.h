@@ -0,0 +1,49 @@
+/*
+ * Description: Definition of the KdfPolicy class.
+ *              Holds the key derivation cost new vaults are saved with, measured once on this machine.
+ *              The measurements are kept in the persistent settings, so every save uses the same known cost.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef KDFPOLICY_H
+#define KDFPOLICY_H
+
+#include <QSettings>
+#include <QString>
+#include <climits>
+#include "vaultheader.h"
+#include "argon2.h"
+#include "pbkdf2.h"
+
+class KdfPolicy
+{
+    public:
+        static const double TARGET_TIME;    // Seconds a key derivation should take on this machine
+
+        KdfPolicy();    // Load the stored policy
+
+        // Retrieve information:
+        bool isCalibrated() const;
+        int preferredKdf() const;
+        quint32 pbkdf2Iterations() const;
+        quint32 argon2Memory() const;   // KiB
+        quint32 argon2Passes() const;
+        quint32 argon2Lanes() const;
+        bool isWeak(int kdf, quint32 iterations, quint32 memory) const; // Whether a vault's parameters fall below this policy
+
+        // Set information:
+        void setPreferredKdf(int kdf);
+        void benchmark();   // Measure both KDFs on this machine and store the results
+
+    private:
+        static const QString KDF_KEY, PBKDF2_ITERATIONS_KEY, ARGON2_MEMORY_KEY, ARGON2_PASSES_KEY, ARGON2_LANES_KEY;
+        static const double WEAK_MARGIN;
+        int kdf;
+        quint32 iterations;
+        quint32 memory;
+        quint32 passes;
+        quint32 lanes;
+};
+
+#endif // KDFPOLICY_H
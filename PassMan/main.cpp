@@ -9,6 +9,8 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    QApplication::setOrganizationName("PassMan");   // Location of persistent settings
+    QApplication::setApplicationName("PassMan");
     PassMan w;
     w.show();
     return a.exec();
@@ -0,0 +1,133 @@
+/*
+ * Description: Implementation of the Merger class.
+ *              Merges another copy of a database into the open one, such as a copy a file syncer set aside.
+ *              With a copy from before the two diverged, each side's changes are found exactly, and only fields both changed conflict.
+ *              Without one, the field set most recently wins, and conflicts are fields whose times can't tell them apart.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Each copy is digested into a DigestTree of the same depth, and only the entries under differing subtrees are
+ * looked at, so copies of tens of thousands of entries that differ in a few merge in about the time it takes to
+ * digest them.  Copies of one file seal entries under the same data key, and their digests cover the sealed records,
+ * so nothing is decrypted until an entry is known to differ; otherwise the values are digested decrypted.
+ * An entry only one copy holds was added there, unless the common copy holds it, in which case the other removed it.
+ * Without a common copy that can't be told, so entries are only ever added.  Changes are applied as ordinary edits,
+ * so they are saved, and can be undone, like any other, and a password, username or notes taken from the other copy
+ * leaves this copy's in the entry's history.  An entry's attachments merge as one field: their names, sizes and chunk
+ * digests are compared, and taking the other copy's brings over, sealed under this copy's key, the chunks it lacks.
+ */
+
+#include "merger.h"
+
+const int Merger::FIELDS[FIELD_COUNT] = { EntryStore::NAME_FIELD, EntryStore::USERNAME_FIELD, EntryStore::PASSWORD_FIELD, EntryStore::NOTES_FIELD, EntryStore::GROUP_FIELD, EntryStore::TAGS_FIELD, EntryStore::ATTACHMENTS_FIELD };
+
+Merger::Merger(Database* local, Database* other, Database* base)
+{
+    this->local = local;
+    this->other = other;
+    this->base = base;
+    taken = 0;
+}
+
+QList<Merger::Conflict> Merger::merge() // Take the other copy's changes that don't conflict, returning the rest for the user to settle
+{
+    QList<Conflict> conflicts;
+    local->closeEdit(); // Values replaced by the merge are kept, whatever was being typed
+    int depth = DigestTree::depthFor(qMax(local->size(), other->size()));
+    bool sealed = local->sharesKey(*other) && (!base || local->sharesKey(*base));
+    DigestTree mine = local->digests(depth, sealed);
+    DigestTree theirs = other->digests(depth, sealed);
+    DigestTree original = base ? base->digests(depth, sealed) : DigestTree(depth);
+    if (!base) original.build();
+    foreach (const EntryId& id, mine.differences(theirs))
+    {
+        bool before = original.contains(id);
+        if (!theirs.contains(id))   // Added here, or removed there
+        {
+            if (!before) continue;
+            if (!mine.same(id, original)) conflicts.append(conflict(id, 0, false));
+            else
+            {
+                local->remove(id);
+                taken++;
+            }
+        }
+        else if (!mine.contains(id))    // Added there, or removed here
+        {
+            if (!before) copy(id);
+            else if (!theirs.same(id, original)) conflicts.append(conflict(id, 0, true));
+        }
+        else if (before && mine.same(id, original)) for (int f = 0; f < FIELD_COUNT; f++) take(id, FIELDS[f]); // Only changed there
+        else if (before && theirs.same(id, original)) continue; // Only changed here
+        else
+        {
+            for (int f = 0; f < FIELD_COUNT; f++)
+            {
+                int field = FIELDS[f];
+                QString mineValue = local->value(id, field), theirValue = other->value(id, field);
+                if (mineValue == theirValue) continue;
+                if (before)
+                {
+                    QString was = base->value(id, field);
+                    if (mineValue == was) take(id, field);
+                    else if (theirValue != was) conflicts.append(conflict(id, field));
+                }
+                else
+                {
+                    qint64 mineTime = local->modified(id, field), theirTime = other->modified(id, field);
+                    if (theirTime > mineTime) take(id, field);
+                    else if (theirTime == mineTime) conflicts.append(conflict(id, field));  // Unknown in both, or set at the same moment
+                }
+            }
+        }
+    }
+    local->closeEdit();
+    return conflicts;
+}
+
+void Merger::resolve(const Conflict& conflict, bool takeOther)  // Settle a conflict by taking the other copy's side, or keeping this one's
+{
+    if (!takeOther) return;
+    if (conflict.field != 0) take(conflict.id, conflict.field);
+    else if (conflict.removedHere) copy(conflict.id);
+    else
+    {
+        local->remove(conflict.id);
+        taken++;
+    }
+    local->closeEdit();
+}
+
+int Merger::changes() const { return taken; }   // Entries and fields taken from the other copy so far
+
+void Merger::take(const EntryId& id, int field) // Copy one field over, keeping the other copy's modification time
+{
+    if (local->value(id, field) == other->value(id, field)) return;
+    if (set(id, field)) taken++;
+}
+
+void Merger::copy(const EntryId& id)    // Add an entry only the other copy holds
+{
+    if (!local->insert(id)) return;
+    for (int f = 0; f < FIELD_COUNT; f++) set(id, FIELDS[f]);
+    local->closeEdit();
+    taken++;
+}
+
+bool Merger::set(const EntryId& id, int field)  // Give a field the other copy's value and modification time, attachments with the chunks they use
+{
+    if (field == EntryStore::ATTACHMENTS_FIELD) return local->copyAttachments(id, *other, other->modified(id, field));
+    local->setValue(field, other->value(id, field), id, other->modified(id, field));
+    return true;
+}
+
+Merger::Conflict Merger::conflict(const EntryId& id, int field, bool removedHere) const
+{
+    Conflict c;
+    c.id = id;
+    c.field = field;
+    c.removedHere = removedHere;
+    c.localTime = field ? local->modified(id, field) : 0;
+    c.otherTime = field ? other->modified(id, field) : 0;
+    return c;
+}
@@ -0,0 +1,51 @@
+/*
+ * Description: Definition of the Merger class.
+ *              Merges another copy of a database into the open one, such as a copy a file syncer set aside.
+ *              With a copy from before the two diverged, each side's changes are found exactly, and only fields both changed conflict.
+ *              Without one, the field set most recently wins, and conflicts are fields whose times can't tell them apart.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef MERGER_H
+#define MERGER_H
+
+#include <QList>
+#include <QString>
+#include "database.h"
+#include "digesttree.h"
+#include "entryid.h"
+
+class Merger
+{
+    public:
+        struct Conflict // A field both copies changed differently, or an entry one copy removed while the other changed it
+        {
+            EntryId id;
+            int field;  // EntryStore field, 0 when the entry was removed from one copy
+            bool removedHere;   // For a removal, whether this copy removed the entry rather than the other
+            qint64 localTime;   // When each copy last set the field, 0 if unknown
+            qint64 otherTime;
+        };
+
+        Merger(Database* local, Database* other, Database* base = 0);
+
+        QList<Conflict> merge();    // Take the other copy's changes that don't conflict, returning the rest for the user to settle
+        void resolve(const Conflict& conflict, bool takeOther); // Settle a conflict by taking the other copy's side, or keeping this one's
+        int changes() const;    // Entries and fields taken from the other copy so far
+
+    private:
+        static const int FIELD_COUNT = 7;
+        static const int FIELDS[FIELD_COUNT];   // Fields compared between copies, in the order conflicts are raised
+        Database* local;
+        Database* other;
+        Database* base; // Null when there is no common copy
+        int taken;
+
+        void take(const EntryId& id, int field);    // Copy one field over, keeping the other copy's modification time
+        void copy(const EntryId& id);   // Add an entry only the other copy holds
+        bool set(const EntryId& id, int field); // Give a field the other copy's value and modification time, attachments with the chunks they use
+        Conflict conflict(const EntryId& id, int field, bool removedHere = false) const;
+};
+
+#endif // MERGER_H
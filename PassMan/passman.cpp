@@ -20,21 +20,64 @@ const QString PassMan::CREATE_NEW_TITLE = "Create New PassMan Database";
 const QString PassMan::SAVE_AS_TITLE = "Save as New PassMan Database";
 const QString PassMan::LINEEDIT_WHITE_BG = "QLineEdit {}";
 const QString PassMan::LINEEDIT_YELLOW_BG = "QLineEdit {background-color: yellow;}";
+const QString PassMan::EXPORT_TITLE = "Export PassMan Database as JSON";
+const QString PassMan::EXPORT_WARNING = "The exported file is not encrypted, and will contain every password in plain text.";
+const QString PassMan::EXPORT_ERROR = "The export file could not be written.";
+const QString PassMan::JSON_FILTER = "JSON File (*.json)";
+const QString PassMan::JSON_EXTENSION = ".json";
+const QString PassMan::BENCHMARK_TITLE = "Benchmark KDF";
+const QString PassMan::BENCHMARK_RESULT = "Databases saved on this computer will use Argon2id with %1 MiB over %2 passes and %3 lanes, or %4 iterations of PBKDF2-SHA512.";
+const QString PassMan::SECRET_MEMORY = "Secrets held: %1 KiB, in %2 KiB of memory locked against swapping";
+const QString PassMan::UNLOCKED_MEMORY = "\n%1 KiB more could not be locked, raise the locked-memory limit (ulimit -l) to lock it";
+const QString PassMan::ALL_GROUPS = "All Entries";
+const QString PassMan::TAG_PREFIX = "#";
+const QString PassMan::TAG_SEPARATOR = ", ";
+const QString PassMan::HISTORY_TITLE = "Restore Earlier Value";
+const QString PassMan::HISTORY_PROMPT = "Value to put back, the current one is kept in its place:";
+const QString PassMan::NO_HISTORY = "This entry's username, password and notes haven't been changed.";
+const QString PassMan::REVISION_TIME_FORMAT = "yyyy-MM-dd hh:mm:ss";
+const QString PassMan::REVISED_USERNAME = "%1  Username: %2";
+const QString PassMan::REVISED_PASSWORD = "%1  Password";
+const QString PassMan::REVISED_NOTES = "%1  Notes";
+const QString PassMan::MERGE_TITLE = "Merge PassMan Database";
+const QString PassMan::MERGE_BASE_TITLE = "Choose Common PassMan Database";
+const QString PassMan::MERGE_BASE_QUESTION = "Is there a copy of the database from before the two were edited apart, such as a backup?  With one, each side's changes are found exactly.  Without one, the most recently set value of each field is kept.";
+const QString PassMan::MERGE_CONFLICT = "\"%1\" has a different %2 in each copy.";
+const QString PassMan::MERGE_TIMES = "Set here %1, and in the other copy %2.";
+const QString PassMan::UNKNOWN_TIME = "at an unknown time";
+const QString PassMan::MERGE_REMOVED_HERE = "\"%1\" was removed here, but changed in the other copy.";
+const QString PassMan::MERGE_REMOVED_THERE = "\"%1\" was changed here, but removed in the other copy.";
+const QString PassMan::KEEP_THIS = "Keep This Copy's";
+const QString PassMan::TAKE_OTHER = "Take Other Copy's";
+const QString PassMan::ATTACH_TITLE = "Attach File";
+const QString PassMan::ATTACH_ERROR = "The file couldn't be read, so nothing was attached.";
+const QString PassMan::SAVE_ATTACHMENT_TITLE = "Save Attachment";
+const QString PassMan::SAVE_ATTACHMENT_ERROR = "The attachment couldn't be written out.";
+const QString PassMan::REMOVE_ATTACHMENT_TITLE = "Remove Attachment";
+const QString PassMan::ATTACHMENT_PROMPT = "Attached file:";
+const QString PassMan::ATTACHMENT_ITEM = "%1  (%2 bytes)";
+const QString PassMan::NO_ATTACHMENTS = "This entry has no attached files.";
+const QString PassMan::MERGE_DONE = "%1 changes were taken from the other copy, and %2 conflicts settled.  Save the database to keep them.";
 
 PassMan::PassMan(QWidget *parent) : QMainWindow(parent), ui(new Ui::PassMan)
 {
     db = new Database(VERSION);
     yubikey = new YubiKey();
-    gen = new Generator();
     connect(yubikey, SIGNAL(yubiKeyChanged()), this, SLOT(updateStatusInfo()));
     connect(db, SIGNAL(readNewData()), this, SLOT(fileReadDone()));
     connect(db, SIGNAL(writeNewData()), this, SLOT(fileWriteDone()));
-    connect(gen, SIGNAL(passwordGenerated()), this, SLOT(passGenDone()));
-    tester = new YubiKeyTester(yubikey);
-    auth = new Authenticator(yubikey);
-    about = new About(VERSION);
-    help = new Help();
-    strength = new StrengthCalculator();
+    tester = 0; // Built on first use, so the main window comes up without waiting on them
+    auth = mergeAuth = 0;
+    gen = 0;
+    about = 0;
+    help = 0;
+    strength = 0;
+    mergeOther = new Database(VERSION);
+    mergeBase = new Database(VERSION);
+    mergeWithBase = false;
+    connect(mergeOther, SIGNAL(readNewData()), this, SLOT(mergeOtherRead()), Qt::QueuedConnection);   // Once the authenticator is done with the file
+    connect(mergeBase, SIGNAL(readNewData()), this, SLOT(mergeBaseRead()), Qt::QueuedConnection);
+    connect(&benchmark, SIGNAL(finished()), this, SLOT(benchmarkDone()));
     passMismatch = false;
     isSaved = true;
     isOpen = false;
@@ -43,26 +86,26 @@ PassMan::PassMan(QWidget *parent) : QMainWindow(parent), ui(new Ui::PassMan)
 
 PassMan::~PassMan()
 {
-    tester->hide(); // Don't leave other windows hanging around!
-    auth->hide();
-    about->hide();
-    gen->hide();
-    strength->hide();
-    help->hide();
+    hideWindows();  // Don't leave other windows hanging around!
+    benchmark.waitForFinished();    // It is still writing the settings
     delete db;
     delete ui;
     delete tester;
     delete yubikey;
     delete auth;
+    delete mergeAuth;
+    delete mergeOther;
+    delete mergeBase;
     delete about;
     delete gen;
     delete strength;
+    delete help;
 }
 
 void PassMan::fileReadDone()    // Update GUI and states after file operation
 {
     isOpen = isSaved = true;
-    updateListInfo(-1);
+    updateListInfo(EntryId());
     updateActions();
 }
 
@@ -75,7 +118,7 @@ void PassMan::open(bool existing)   // Open a database file
     {
         fileName = QFileDialog::getOpenFileName(ui->passManCentralWidget, OPEN_EXISTING_TITLE, "", filter, &filter);
         if (fileName.length() < 1) return;  // Failed to get filename (user cancelled)
-        auth->open(fileName, db);
+        authenticator()->open(fileName, db);
     }
     else    // Make new database file
     {
@@ -88,6 +131,7 @@ void PassMan::open(bool existing)   // Open a database file
 
 void PassMan::save(bool existing)   // Save a database file
 {
+    edits->flush();
     QString filter(FILE_FILTER);
     QFile file;
     if (!existing)  // Make new database file
@@ -97,7 +141,8 @@ void PassMan::save(bool existing)   // Save a database file
         if (!fileName.endsWith(FILE_EXTENSION)) fileName.append(FILE_EXTENSION);
     }
     file.setFileName(fileName);
-    auth->save(fileName, db);
+    if (existing && authenticator()->isUnlocked(fileName)) auth->append(db);    // Key is already known, so only the edits are written
+    else authenticator()->save(fileName, db);
 }
 
 void PassMan::configGUI()   // Initialize GUI components for proper interaction
@@ -114,14 +159,23 @@ void PassMan::configGUI()   // Initialize GUI components for proper interaction
     ui->actionSave_Database->setShortcut(QKeySequence::Save);
     ui->actionSaveas_Database->setShortcut(QKeySequence::SaveAs);
     ui->actionQuit->setShortcut(QKeySequence::Quit);
-    ui->entryTableWidget->setColumnCount(1);
-    ui->entryTableWidget->verticalHeader()->setVisible(false);  // Alter entry table to look cleaner and have simple interaction
-    ui->entryTableWidget->horizontalHeader()->setVisible(false);
-    ui->entryTableWidget->setSelectionMode(QAbstractItemView::SingleSelection);
-    ui->entryTableWidget->setSelectionBehavior(QAbstractItemView::SelectRows);
-    ui->entryTableWidget->setShowGrid(false);
-    ui->entryTableWidget->horizontalHeader()->setStretchLastSection(true);
-    ui->entryTableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    ui->actionUndo->setShortcut(QKeySequence::Undo);    // Text boxes keep these keys for their own undo while focused
+    ui->actionRedo->setShortcut(QKeySequence::Redo);
+    list = new EntryListModel(db, this);
+    ui->entryTableView->setModel(list);
+    ui->entryTableView->verticalHeader()->setVisible(false);  // Alter entry table to look cleaner and have simple interaction
+    ui->entryTableView->horizontalHeader()->setVisible(false);
+    ui->entryTableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);   // Uniform rows, so none is measured to lay out the list
+    ui->entryTableView->verticalHeader()->setDefaultSectionSize(ui->entryTableView->fontMetrics().height() + ROW_PADDING);
+    ui->entryTableView->setSelectionMode(QAbstractItemView::SingleSelection);
+    ui->entryTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    ui->entryTableView->setShowGrid(false);
+    ui->entryTableView->horizontalHeader()->setStretchLastSection(true);
+    ui->entryTableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    connect(ui->entryTableView->selectionModel(), SIGNAL(selectionChanged(QItemSelection,QItemSelection)), this, SLOT(entrySelectionChanged()));
+    edits = new EditBuffer(this);
+    connect(edits, SIGNAL(commit(EntryId,int)), this, SLOT(commitEdits(EntryId,int)));
+    connect(QApplication::instance(), SIGNAL(focusChanged(QWidget*,QWidget*)), edits, SLOT(flush()));  // Leaving a field commits it
     ui->passwordLineEdit->setEchoMode(QLineEdit::Password);     // By default, keep passwords obscured
     ui->repeatedPasswordLineEdit->setEchoMode(QLineEdit::Password);
     yubikeyState = new QLabel();
@@ -130,32 +184,77 @@ void PassMan::configGUI()   // Initialize GUI components for proper interaction
     ui->passwordStrengthBar->setMinimum(0);
     ui->passwordStrengthBar->setMaximum(StrengthCalculator::NAIVE_HIGH_STRENGTH_ENTROPY);
     ui->passwordStrengthBar->setFormat("%v bits");
-    yubikey->poll();
+    yubikey->poll();    // Runs in the background, the status bar fills in once it finishes
     updateStatusInfo();
 }
 
+Authenticator* PassMan::authenticator() // Authenticator for the open file, built on first use
+{
+    if (!auth) auth = new Authenticator(yubikey);
+    return auth;
+}
+
+Authenticator* PassMan::mergeAuthenticator()    // Authenticator for the copies being merged in, built on first use
+{
+    if (!mergeAuth) mergeAuth = new Authenticator(yubikey);
+    return mergeAuth;
+}
+
+Generator* PassMan::generator() // Password generator, built on first use
+{
+    if (!gen)
+    {
+        gen = new Generator();
+        connect(gen, SIGNAL(passwordGenerated()), this, SLOT(passGenDone()));
+    }
+    return gen;
+}
+
+void PassMan::hideWindows() // Hide whichever secondary windows have been built
+{
+    if (tester) tester->hide();
+    if (auth) auth->hide();
+    if (mergeAuth) mergeAuth->hide();
+    if (about) about->hide();
+    if (gen) gen->hide();
+    if (strength) strength->hide();
+    if (help) help->hide();
+}
+
 void PassMan::updateActions()   // Toggle menu actions based on program state
 {
+    updateStatusInfo();
     if (isOpen)
     {
-        statusBar()->showMessage(LOADED);
         ui->actionAdd_Entry->setEnabled(true);
         ui->actionNew_Database->setEnabled(false);
         ui->actionOpen_Database->setEnabled(false);
         ui->actionSaveas_Database->setEnabled(true);
         ui->actionSave_Database->setEnabled(true);
+        ui->actionExport_Database->setEnabled(true);
+        ui->actionMerge_Database->setEnabled(true);
+        ui->actionChange_Master_Password->setEnabled(true);
         ui->actionClose_Database->setEnabled(true);
+        ui->filterLineEdit->setEnabled(true);
+        ui->groupTreeWidget->setEnabled(true);
+        updateUndoActions();
         if (db->size() > 0)
         {
             ui->actionCopy_Entry_Username->setEnabled(true);
             ui->actionCopy_Entry_Password->setEnabled(true);
             ui->actionAuto_Type_Entry->setEnabled(true);
             ui->actionDelete_Entry->setEnabled(true);
+            ui->actionRestore_Earlier_Value->setEnabled(true);
+            ui->actionAttach_File->setEnabled(true);
+            ui->actionSave_Attachment->setEnabled(true);
+            ui->actionRemove_Attachment->setEnabled(true);
             ui->entryNameLineEdit->setEnabled(true);
             ui->usernameLineEdit->setEnabled(true);
             ui->passwordLineEdit->setEnabled(true);
             ui->repeatedPasswordLineEdit->setEnabled(true);
             ui->notesTextEdit->setEnabled(true);
+            ui->groupLineEdit->setEnabled(true);
+            ui->tagsLineEdit->setEnabled(true);
             ui->generatePasswordButton->setEnabled(true);
             ui->revealPasswordCheckBox->setEnabled(true);
         }
@@ -165,38 +264,62 @@ void PassMan::updateActions()   // Toggle menu actions based on program state
             ui->actionCopy_Entry_Password->setEnabled(false);
             ui->actionAuto_Type_Entry->setEnabled(false);
             ui->actionDelete_Entry->setEnabled(false);
+            ui->actionRestore_Earlier_Value->setEnabled(false);
+            ui->actionAttach_File->setEnabled(false);
+            ui->actionSave_Attachment->setEnabled(false);
+            ui->actionRemove_Attachment->setEnabled(false);
             ui->entryNameLineEdit->setEnabled(false);
             ui->usernameLineEdit->setEnabled(false);
             ui->passwordLineEdit->setEnabled(false);
             ui->repeatedPasswordLineEdit->setEnabled(false);
             ui->notesTextEdit->setEnabled(false);
+            ui->groupLineEdit->setEnabled(false);
+            ui->tagsLineEdit->setEnabled(false);
             ui->generatePasswordButton->setEnabled(false);
             ui->revealPasswordCheckBox->setEnabled(false);
         }
     }
     else
     {
-        statusBar()->showMessage(NOT_LOADED);
+        ui->actionUndo->setEnabled(false);
+        ui->actionRedo->setEnabled(false);
         ui->actionCopy_Entry_Username->setEnabled(false);
         ui->actionCopy_Entry_Password->setEnabled(false);
         ui->actionAdd_Entry->setEnabled(false);
         ui->actionAuto_Type_Entry->setEnabled(false);
         ui->actionDelete_Entry->setEnabled(false);
+        ui->actionRestore_Earlier_Value->setEnabled(false);
+        ui->actionAttach_File->setEnabled(false);
+        ui->actionSave_Attachment->setEnabled(false);
+        ui->actionRemove_Attachment->setEnabled(false);
         ui->actionNew_Database->setEnabled(true);
         ui->actionOpen_Database->setEnabled(true);
         ui->actionSaveas_Database->setEnabled(false);
         ui->actionSave_Database->setEnabled(false);
+        ui->actionExport_Database->setEnabled(false);
+        ui->actionMerge_Database->setEnabled(false);
+        ui->actionChange_Master_Password->setEnabled(false);
         ui->actionClose_Database->setEnabled(false);
+        ui->filterLineEdit->setEnabled(false);
+        ui->groupTreeWidget->setEnabled(false);
         ui->entryNameLineEdit->setEnabled(false);
         ui->usernameLineEdit->setEnabled(false);
         ui->passwordLineEdit->setEnabled(false);
         ui->repeatedPasswordLineEdit->setEnabled(false);
         ui->notesTextEdit->setEnabled(false);
+        ui->groupLineEdit->setEnabled(false);
+        ui->tagsLineEdit->setEnabled(false);
         ui->generatePasswordButton->setEnabled(false);
         ui->revealPasswordCheckBox->setEnabled(false);
     }
 }
 
+void PassMan::updateUndoActions()   // Toggle undo and redo based on the edit history
+{
+    ui->actionUndo->setEnabled(isOpen && db->canUndo());
+    ui->actionRedo->setEnabled(isOpen && db->canRedo());
+}
+
 void PassMan::on_revealPasswordCheckBox_toggled(bool checked)   // Toggle revealing of password textboxes via checkbox
 {
     if (checked)
@@ -211,25 +334,53 @@ void PassMan::on_revealPasswordCheckBox_toggled(bool checked)   // Toggle reveal
     }
 }
 
-void PassMan::on_entryNameLineEdit_textEdited(const QString &arg1) // Update entry name if changed
-{
-    isSaved = false;
-    int row = selectedItem();
-    db->setName(arg1, row);
-    updateListInfo(row);
-}
+void PassMan::on_entryNameLineEdit_textEdited(const QString &arg1) { edits->edit(selectedItem(), EntryStore::NAME_FIELD); }  // Update entry name if changed
 
 void PassMan::on_actionOpen_Database_triggered() { open(true); }    // Open an existing database file
 
-void PassMan::on_entryTableWidget_itemSelectionChanged()    // Update rest of GUI with data corresponding with this entry
+void PassMan::entrySelectionChanged()   // Update rest of GUI with data corresponding with this entry
 {
     passMismatch = false;
     ui->repeatedPasswordLineEdit->setStyleSheet(LINEEDIT_WHITE_BG);
     ui->passwordLineEdit->setStyleSheet(LINEEDIT_WHITE_BG);
+    edits->flush(); // The boxes still hold the entry that was being edited
+    db->closeEdit();    // Typing into another entry is a new undo step
     updateDisplayInfo(selectedItem());
-    int strength = StrengthCalculator::naiveEntropyBits(ui->passwordLineEdit->text());
-    if (ui->passwordStrengthBar->maximum() < strength) ui->passwordStrengthBar->setMaximum(strength);
-    ui->passwordStrengthBar->setValue(strength);
+    updateStrength();
+}
+
+void PassMan::commitEdits(const EntryId& id, int fields)    // Write the fields edited since the last commit, then redo what depends on them once
+{
+    if (!db->contains(id)) return;
+    if (fields & (1 << EntryStore::NAME_FIELD))
+    {
+        db->setName(ui->entryNameLineEdit->text(), id);
+        list->refresh(id);  // Just this row is redrawn
+    }
+    if (fields & (1 << EntryStore::USERNAME_FIELD)) db->setUsername(ui->usernameLineEdit->text(), id);
+    if (fields & (1 << EntryStore::PASSWORD_FIELD))
+    {
+        updatePasswords(id);
+        updateStrength();
+    }
+    if (fields & (1 << EntryStore::NOTES_FIELD)) db->setNotes(ui->notesTextEdit->toPlainText(), id);    // The document is only copied out here
+    if (fields & (1 << EntryStore::GROUP_FIELD)) db->setGroup(ui->groupLineEdit->text(), id);
+    if (fields & (1 << EntryStore::TAGS_FIELD)) db->setTags(ui->tagsLineEdit->text().split(TAG_SEPARATOR.at(0)), id);
+    isSaved = false;
+    updateUndoActions();
+}
+
+void PassMan::on_filterLineEdit_textEdited(const QString &arg1)    // Narrow the entry list as the filter is typed
+{
+    filterEntries();
+    if (list->isEmpty()) updateDisplayInfo(EntryId());  // Nothing matches, so nothing is selected
+}
+
+void PassMan::on_filterLineEdit_returnPressed() // Select the top match, so the copy shortcuts apply to it
+{
+    if (list->isEmpty()) return;
+    ui->entryTableView->selectRow(0);
+    ui->entryTableView->setFocus();
 }
 
 void PassMan::on_actionNew_Database_triggered() { open(false); }    // Create a new database file
@@ -238,43 +389,146 @@ void PassMan::on_actionSave_Database_triggered() { save(true); }    // Save curr
 
 void PassMan::on_actionSaveas_Database_triggered() { save(false); } // Save current database file with new name
 
-void PassMan::on_notesTextEdit_textChanged()    // Update entry notes if changed
+void PassMan::on_actionChange_Master_Password_triggered()   // Save under new credentials, rewrapping the data key
 {
-    isSaved = false;
-    db->setNotes(ui->notesTextEdit->toPlainText(), selectedItem());
+    edits->flush();
+    authenticator()->save(fileName, db, true);
 }
 
-void PassMan::on_usernameLineEdit_textEdited(const QString &arg1)  // Update entry username if changed
+void PassMan::on_actionExport_Database_triggered()  // Write an unencrypted JSON copy of the database
 {
-    isSaved = false;
-    db->setUsername(ui->usernameLineEdit->text(), selectedItem());
+    edits->flush();
+    if (QMessageBox::warning(this, EXPORT_TITLE, EXPORT_WARNING, QMessageBox::Ok | QMessageBox::Cancel, QMessageBox::Cancel) != QMessageBox::Ok) return;
+    QString filter(JSON_FILTER);
+    QString exportName = QFileDialog::getSaveFileName(ui->passManCentralWidget, EXPORT_TITLE, "", filter, &filter);
+    if (exportName.length() < 1) return;    // Failed to get filename (user cancelled)
+    if (!exportName.endsWith(JSON_EXTENSION)) exportName.append(JSON_EXTENSION);
+    QJsonObject obj;
+    db->writeJson(obj);
+    QByteArray json = QJsonDocument(obj).toJson();
+    QSaveFile file(exportName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.length() || !file.commit()) QMessageBox::critical(this, EXPORT_TITLE, EXPORT_ERROR);
+    json.fill(0);
 }
 
-void PassMan::on_passwordLineEdit_textEdited(const QString &arg1)   // Update entry password if changed
+void PassMan::on_actionMerge_Database_triggered()   // Merge another copy of the database into this one, such as one a file syncer set aside
 {
-    int strength = StrengthCalculator::naiveEntropyBits(ui->passwordLineEdit->text());
-    if (ui->passwordStrengthBar->maximum() < strength) ui->passwordStrengthBar->setMaximum(strength);
-    ui->passwordStrengthBar->setValue(strength);
-    updatePasswords();
+    QString filter(FILE_FILTER);
+    QString otherName = QFileDialog::getOpenFileName(ui->passManCentralWidget, MERGE_TITLE, "", filter, &filter);
+    if (otherName.length() < 1) return; // Failed to get filename (user cancelled)
+    mergeBaseName.clear();
+    if (QMessageBox::question(this, MERGE_TITLE, MERGE_BASE_QUESTION) == QMessageBox::Yes) mergeBaseName = QFileDialog::getOpenFileName(ui->passManCentralWidget, MERGE_BASE_TITLE, "", filter, &filter);
+    mergeWithBase = !mergeBaseName.isEmpty();
+    mergeAuthenticator()->open(otherName, mergeOther, true);   // Each copy is unlocked with its own password and YubiKey, and left as it is
 }
 
-void PassMan::on_repeatedPasswordLineEdit_textEdited(const QString &arg1)
+void PassMan::mergeOtherRead()  // Open the common copy once the other copy is read, or merge straight away
 {
-    int strength = StrengthCalculator::naiveEntropyBits(ui->repeatedPasswordLineEdit->text());
-    if (ui->passwordStrengthBar->maximum() < strength) ui->passwordStrengthBar->setMaximum(strength);
-    ui->passwordStrengthBar->setValue(strength);
-    updatePasswords();
+    if (mergeBaseName.isEmpty())
+    {
+        merge();
+        return;
+    }
+    QString baseName = mergeBaseName;
+    mergeBaseName.clear();
+    mergeAuthenticator()->open(baseName, mergeBase, true);
+}
+
+void PassMan::mergeBaseRead() { merge(); }  // Merge once the common copy is read
+
+void PassMan::merge()   // Merge the other copy into the open database, asking how to settle conflicts
+{
+    if (isOpen)
+    {
+        edits->flush(); // Typed values are compared like any other
+        Merger merger(db, mergeOther, mergeWithBase ? mergeBase : 0);
+        QList<Merger::Conflict> conflicts = merger.merge();
+        foreach (const Merger::Conflict& conflict, conflicts) settle(merger, conflict);
+        if (merger.changes() > 0) isSaved = false;
+        ui->filterLineEdit->clear();
+        fillGroups();
+        updateListInfo(EntryId());
+        updateActions();
+        QMessageBox::information(this, MERGE_TITLE, MERGE_DONE.arg(merger.changes()).arg(conflicts.size()));
+    }
+    if (mergeAuth) mergeAuth->clean();  // Don't leave the other copies' data around
+    mergeOther->clear();
+    mergeBase->clear();
+    mergeWithBase = false;
 }
 
-void PassMan::updatePasswords()    // Handle parity between password textboxes on text changes
+void PassMan::settle(Merger& merger, const Merger::Conflict& conflict)  // Ask which side of a conflict to take
+{
+    QMessageBox msg(this);
+    msg.setWindowTitle(MERGE_TITLE);
+    msg.setIcon(QMessageBox::Question);
+    if (conflict.field == 0) msg.setText((conflict.removedHere ? MERGE_REMOVED_HERE : MERGE_REMOVED_THERE).arg(conflict.removedHere ? mergeOther->name(conflict.id) : db->name(conflict.id)));
+    else
+    {
+        msg.setText(MERGE_CONFLICT.arg(db->name(conflict.id), fieldName(conflict.field)));
+        QString here = conflict.localTime ? QDateTime::fromMSecsSinceEpoch(conflict.localTime).toString(REVISION_TIME_FORMAT) : UNKNOWN_TIME;
+        QString there = conflict.otherTime ? QDateTime::fromMSecsSinceEpoch(conflict.otherTime).toString(REVISION_TIME_FORMAT) : UNKNOWN_TIME;
+        msg.setInformativeText(MERGE_TIMES.arg(here, there));
+    }
+    QPushButton* keep = msg.addButton(KEEP_THIS, QMessageBox::RejectRole);
+    msg.addButton(TAKE_OTHER, QMessageBox::AcceptRole);
+    msg.setDefaultButton(keep);
+    msg.exec();
+    merger.resolve(conflict, msg.clickedButton() != keep);
+}
+
+QString PassMan::fieldName(int field)   // Name of an entry field, as a merge conflict shows it
+{
+    switch (field)
+    {
+        case EntryStore::NAME_FIELD: return "name";
+        case EntryStore::USERNAME_FIELD: return "username";
+        case EntryStore::PASSWORD_FIELD: return "password";
+        case EntryStore::NOTES_FIELD: return "notes";
+        case EntryStore::GROUP_FIELD: return "group";
+        case EntryStore::TAGS_FIELD: return "tags";
+        case EntryStore::ATTACHMENTS_FIELD: return "attachments";
+        default: return QString();
+    }
+}
+
+void PassMan::on_notesTextEdit_textChanged() { edits->edit(selectedItem(), EntryStore::NOTES_FIELD); }  // Update entry notes if changed
+
+void PassMan::on_groupLineEdit_textEdited(const QString &arg1) { edits->edit(selectedItem(), EntryStore::GROUP_FIELD); }    // Refile entry in another group
+
+void PassMan::on_groupLineEdit_editingFinished()    // Groups may have come or gone, but not on every keystroke
+{
+    edits->flush(); // Finishing comes before the focus change that would commit it
+    fillGroups();
+}
+
+void PassMan::on_tagsLineEdit_textEdited(const QString &arg1) { edits->edit(selectedItem(), EntryStore::TAGS_FIELD); }  // Update entry tags if changed
+
+void PassMan::on_groupTreeWidget_itemExpanded(QTreeWidgetItem* item) { fillSubgroups(item); }  // Subgroups are only listed once opened
+
+void PassMan::on_groupTreeWidget_itemSelectionChanged() // Narrow the entry list to the selected group
+{
+    QList<QTreeWidgetItem*> selected = ui->groupTreeWidget->selectedItems();
+    shownGroup = selected.isEmpty() ? QString() : selected.first()->data(0, PATH_ROLE).toString();
+    lastFilter.clear(); // Other entries, so match them all again
+    filterEntries();
+    if (list->isEmpty()) updateDisplayInfo(EntryId());  // Nothing in this group matches, so nothing is selected
+}
+
+void PassMan::on_usernameLineEdit_textEdited(const QString &arg1) { edits->edit(selectedItem(), EntryStore::USERNAME_FIELD); }   // Update entry username if changed
+
+void PassMan::on_passwordLineEdit_textEdited(const QString &arg1) { edits->edit(selectedItem(), EntryStore::PASSWORD_FIELD); }  // Update entry password if changed
+
+void PassMan::on_repeatedPasswordLineEdit_textEdited(const QString &arg1) { edits->edit(selectedItem(), EntryStore::PASSWORD_FIELD); }
+
+void PassMan::updatePasswords(const EntryId& id)    // Handle parity between password textboxes, setting this entry's password once they match
 {
     if (!ui->passwordLineEdit->text().compare(ui->repeatedPasswordLineEdit->text()))    // Match!
     {
         passMismatch = false;
         ui->passwordLineEdit->setStyleSheet(LINEEDIT_WHITE_BG);
         ui->repeatedPasswordLineEdit->setStyleSheet(LINEEDIT_WHITE_BG);
-        isSaved = false;
-        db->setPassword(ui->passwordLineEdit->text(), selectedItem());
+        db->setPassword(ui->passwordLineEdit->text(), id);
     }
     else if (!passMismatch) // Mismatch!
     {
@@ -283,11 +537,21 @@ void PassMan::updatePasswords()    // Handle parity between password textboxes o
     }
 }
 
-void PassMan::updateStatusInfo()    // Update status bar
+void PassMan::updateStrength()  // Rate the password shown, once per commit rather than on every keystroke
+{
+    int strength = StrengthCalculator::naiveEntropyBits(ui->passwordLineEdit->text());
+    if (ui->passwordStrengthBar->maximum() < strength) ui->passwordStrengthBar->setMaximum(strength);
+    ui->passwordStrengthBar->setValue(strength);
+}
+
+void PassMan::updateStatusInfo()    // Update status bar, and the secret memory held in its tooltip
 {
     yubikeyState->setText(yubikey->stateText());
     if (isOpen) statusBar()->showMessage(LOADED);
     else statusBar()->showMessage(NOT_LOADED);
+    QString memory = SECRET_MEMORY.arg((qulonglong) SecureMemory::liveBytes() / 1024).arg((qulonglong) SecureMemory::lockedBytes() / 1024);
+    if (SecureMemory::unlockedBytes() > 0) memory += UNLOCKED_MEMORY.arg((qulonglong) SecureMemory::unlockedBytes() / 1024);
+    statusBar()->setToolTip(memory);
 }
 
 int PassMan::confirmClose(QString title, QString text)  // Confirm via message box whether to close
@@ -301,54 +565,114 @@ int PassMan::confirmClose(QString title, QString text)  // Confirm via message b
     return msg.exec();
 }
 
-void PassMan::updateListInfo(int row)   // Update the entry list after database change, or refresh if negative
+void PassMan::filterEntries()   // Fill the entry list with the entries matching the filter text, best first
 {
-    if (row < 0)
+    QStringList words, tags;
+    foreach (const QString& word, ui->filterLineEdit->text().split(QChar(' '), QString::SkipEmptyParts))
     {
-        ui->entryTableWidget->clear();
-        ui->entryTableWidget->setColumnCount(1);
-        ui->entryTableWidget->setRowCount(db->size());  // Update entire entry list
-        for (int i = 0; i < db->size(); i++)
-        {
-            ui->entryTableWidget->setItem(i, 0, new QTableWidgetItem(db->name(i)));
-        }
-        if (ui->entryTableWidget->rowCount() > 0)
-        {
-            ui->entryTableWidget->selectRow(0); // Want to select first item on fresh load
-            row = 0;
-        }
-    }   // Select the current row if valid
-    if (ui->entryTableWidget->rowCount() > 0) ui->entryTableWidget->setItem(row, 0, new QTableWidgetItem(db->name(row)));
+        if (word.startsWith(TAG_PREFIX)) tags.append(word.mid(TAG_PREFIX.size()));   // #tag keeps entries carrying it
+        else words.append(word);
+    }
+    QString text = words.join(QChar(' '));
+    bool restricted = !shownGroup.isEmpty() || !tags.isEmpty();
+    if (!lastFilter.isEmpty() && text.startsWith(lastFilter) && tags == lastTags) list->setEntries(db->match(text, list->ids()));  // Only the last matches can still match a longer filter
+    else if (text.isEmpty()) list->setEntries(restricted ? db->members(shownGroup, tags) : db->ids());   // Every entry in the group, in order
+    else list->setEntries(restricted ? db->match(text, db->members(shownGroup, tags)) : db->match(text));
+    lastFilter = text;
+    lastTags = tags;
+    if (!list->isEmpty()) ui->entryTableView->selectRow(0);  // Best match first
+}
+
+void PassMan::updateListInfo(const EntryId& id) // Update the entry list after database change, or refresh if null
+{
+    EntryId row = id;
+    if (row.isNull())
+    {
+        lastFilter.clear(); // Entries may have come or gone, so match them all again
+        fillGroups();
+        filterEntries();    // Update entire entry list
+        if (!list->isEmpty()) row = list->id(0);    // Want to select first item on fresh load
+    }
+    else list->refresh(row);    // Update the current row if it is listed
     updateDisplayInfo(row);
 }
 
-void PassMan::updateDisplayInfo(int row)   // Update the textboxes with currently selected entry, or clear if negative
+void PassMan::updateDisplayInfo(const EntryId& id)  // Update the textboxes with currently selected entry, or clear if null
 {
-    if (row < 0)
+    edits->flush(); // Typed values are written before the boxes are refilled
+    bool blocked = ui->notesTextEdit->blockSignals(true);   // Refilling the notes isn't an edit
+    EntryId row = id;
+    if (row.isNull())
     {
         ui->entryNameLineEdit->clear();
         ui->usernameLineEdit->clear();
         ui->passwordLineEdit->clear();
         ui->repeatedPasswordLineEdit->clear();
         ui->notesTextEdit->clear();
-        if (db->size() > 0)
+        ui->groupLineEdit->clear();
+        ui->tagsLineEdit->clear();
+        if (!list->isEmpty())
         {
-            ui->entryTableWidget->selectRow(0);
-            row = 0;
+            ui->entryTableView->selectRow(0);
+            row = list->id(0);
         }
     }
     ui->entryNameLineEdit->setText(db->name(row));
     ui->usernameLineEdit->setText(db->username(row));
-    ui->passwordLineEdit->setText(db->password(row));
-    ui->repeatedPasswordLineEdit->setText(db->password(row));
+    QString password = db->password(row);   // Secrets are only decrypted for the selected entry
+    ui->passwordLineEdit->setText(password);
+    ui->repeatedPasswordLineEdit->setText(password);
     ui->notesTextEdit->setPlainText(db->notes(row));
-    ui->entryTableWidget->selectRow(row);
+    ui->groupLineEdit->setText(db->group(row));
+    ui->tagsLineEdit->setText(db->tags(row).join(TAG_SEPARATOR));
+    ui->notesTextEdit->blockSignals(blocked);
+    int listed = list->row(row);
+    if (listed >= 0) ui->entryTableView->selectRow(listed);
 }
 
-int PassMan::selectedItem() // Return currently selected item in entry list
+void PassMan::fillGroups()  // Rebuild the group tree, keeping the selected group open where it still exists
 {
-    if (ui->entryTableWidget->selectedItems().length() > 0) return ui->entryTableWidget->selectedItems().at(0)->row();
-    return -1;
+    ui->groupTreeWidget->blockSignals(true);    // Items are expanded and selected here without refiltering
+    ui->groupTreeWidget->clear();
+    QTreeWidgetItem* item = new QTreeWidgetItem(ui->groupTreeWidget, QStringList(ALL_GROUPS));
+    item->setData(0, PATH_ROLE, QString());
+    QStringList levels = shownGroup.split(GroupIndex::SEPARATOR, QString::SkipEmptyParts);
+    for (int i = 0; i <= levels.size(); i++)    // Open the way down to the selected group, as far as it still goes
+    {
+        fillSubgroups(item);
+        item->setExpanded(true);
+        if (i == levels.size()) break;
+        QString path = QStringList(levels.mid(0, i + 1)).join(GroupIndex::SEPARATOR);
+        QTreeWidgetItem* next = 0;
+        for (int c = 0; c < item->childCount() && !next; c++)
+        {
+            if (item->child(c)->data(0, PATH_ROLE).toString() == path) next = item->child(c);
+        }
+        if (!next) break;
+        item = next;
+    }
+    if (item->childCount() == 0) item->setExpanded(false);
+    ui->groupTreeWidget->setCurrentItem(item);
+    shownGroup = item->data(0, PATH_ROLE).toString();
+    ui->groupTreeWidget->blockSignals(false);
+}
+
+void PassMan::fillSubgroups(QTreeWidgetItem* item)  // List the groups directly inside this one, the first time it is opened
+{
+    if (item->data(0, FILLED_ROLE).toBool()) return;
+    item->setData(0, FILLED_ROLE, true);
+    foreach (const QString& path, db->subgroups(item->data(0, PATH_ROLE).toString()))
+    {
+        QTreeWidgetItem* child = new QTreeWidgetItem(item, QStringList(path.section(GroupIndex::SEPARATOR, -1)));
+        child->setData(0, PATH_ROLE, path);
+        if (!db->subgroups(path).isEmpty()) child->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);  // Expandable before its subgroups are listed
+    }
+}
+
+EntryId PassMan::selectedItem() // Return the entry currently selected in the entry list
+{
+    QModelIndexList selected = ui->entryTableView->selectionModel()->selectedRows();
+    return selected.isEmpty() ? EntryId() : list->id(selected.first().row());
 }
 
 void PassMan::on_actionClose_Database_triggered() { close(); }  // Close database, saving if needed
@@ -356,6 +680,7 @@ void PassMan::on_actionClose_Database_triggered() { close(); }  // Close databas
 bool PassMan::close()  // Handle possible database closing
 {
     if (!isOpen) return true;
+    edits->flush(); // Whatever was still being typed counts as unsaved
     if (!isSaved)
     {
         switch (confirmClose(CLOSE_TITLE, CLOSE_QUESTION))
@@ -371,13 +696,16 @@ bool PassMan::close()  // Handle possible database closing
         }
     }
     isOpen = false;
+    edits->discard();   // Nothing typed is carried into the next database
     db->clear();    // Don't leave any sensitive data
-    auth->clean();
+    if (auth) auth->clean();
+    ui->filterLineEdit->clear();
+    shownGroup.clear();
     ui->passwordLineEdit->setStyleSheet(LINEEDIT_WHITE_BG);
     ui->repeatedPasswordLineEdit->setStyleSheet(LINEEDIT_WHITE_BG);
     passMismatch = false;
     updateActions();
-    updateListInfo(-1);
+    updateListInfo(EntryId());
     return true;
 }
 
@@ -385,28 +713,26 @@ void PassMan::on_actionQuit_triggered() // Quit the program
 {
     if (close())
     {
-        tester->hide(); // Don't leave other windows hanging around!
-        auth->hide();
-        about->hide();
-        gen->hide();
-        strength->hide();
-        help->hide();
+        hideWindows();  // Don't leave other windows hanging around!
         QApplication::quit();
     }
 }
 
 void PassMan::on_actionDelete_Entry_triggered() // Remove entry from the database
 {
-    int row = selectedItem();
+    edits->flush();
+    EntryId id = selectedItem();
     isSaved = false;
     ui->entryNameLineEdit->blockSignals(true);
     ui->usernameLineEdit->blockSignals(true);
     ui->passwordLineEdit->blockSignals(true);
     ui->repeatedPasswordLineEdit->blockSignals(true);
     ui->notesTextEdit->blockSignals(true);
-    db->remove(row);
-    updateListInfo(-1);
-    updateDisplayInfo(-1);
+    bool grouped = !db->group(id).isEmpty();
+    db->remove(id);
+    list->remove(id);   // Only this row goes, the others are left as they are
+    if (grouped) fillGroups();  // Its group may have gone with it
+    updateDisplayInfo(EntryId());
     updateActions();
     ui->usernameLineEdit->blockSignals(false);
     ui->passwordLineEdit->blockSignals(false);
@@ -417,16 +743,22 @@ void PassMan::on_actionDelete_Entry_triggered() // Remove entry from the databas
 
 void PassMan::on_actionAdd_Entry_triggered()    // Add new entry to the database
 {
-    int row = db->size();
+    edits->flush();
     isSaved = false;
     ui->entryNameLineEdit->blockSignals(true);
     ui->usernameLineEdit->blockSignals(true);
     ui->passwordLineEdit->blockSignals(true);
     ui->repeatedPasswordLineEdit->blockSignals(true);
     ui->notesTextEdit->blockSignals(true);
-    db->addNew(); // Insert new item and update GUI
-    updateListInfo(-1);
-    updateDisplayInfo(row);
+    EntryId id = db->addNew();  // Insert new item and update GUI
+    if (ui->filterLineEdit->text().isEmpty() && shownGroup.isEmpty()) list->append(id);  // Every entry is listed in order, so it just goes after the last
+    else    // The new entry wouldn't match a filter or group, and should be listed
+    {
+        ui->filterLineEdit->clear();
+        shownGroup.clear();
+        updateListInfo(EntryId());
+    }
+    updateDisplayInfo(id);
     updateActions();
     ui->entryNameLineEdit->blockSignals(false);
     ui->usernameLineEdit->blockSignals(false);
@@ -435,13 +767,171 @@ void PassMan::on_actionAdd_Entry_triggered()    // Add new entry to the database
     ui->notesTextEdit->blockSignals(false);
 }
 
-void PassMan::on_actionAbout_triggered(){ about->show(); }  // Display about info
+void PassMan::on_actionUndo_triggered() // Revert the last edit
+{
+    edits->flush(); // What was just typed is the last edit
+    showRestored(db->undo());
+}
+
+void PassMan::on_actionRedo_triggered() // Reapply the last undone edit
+{
+    edits->flush();
+    showRestored(db->redo());
+}
+
+void PassMan::on_actionRestore_Earlier_Value_triggered()    // Put back a username, password or notes the selected entry held before
+{
+    edits->flush(); // A value being typed over is kept among them
+    EntryId id = selectedItem();
+    QVector<EntryStore::Revision> kept = db->revisions(id);
+    if (kept.isEmpty())
+    {
+        QMessageBox::information(this, HISTORY_TITLE, NO_HISTORY);
+        return;
+    }
+    QStringList items;
+    for (int r = 0; r < kept.size(); r++)   // Newest first, passwords and notes are only decrypted once chosen
+    {
+        QString time = QDateTime::fromMSecsSinceEpoch(kept.at(r).time).toString(REVISION_TIME_FORMAT);
+        if (kept.at(r).field == EntryStore::USERNAME_FIELD) items.append(REVISED_USERNAME.arg(time, db->revision(id, r)));
+        else if (kept.at(r).field == EntryStore::PASSWORD_FIELD) items.append(REVISED_PASSWORD.arg(time));
+        else items.append(REVISED_NOTES.arg(time));
+    }
+    int chosen = chooseItem(HISTORY_TITLE, HISTORY_PROMPT, items);  // Labels repeat where two values were replaced within a second
+    if (chosen < 0) return;
+    db->revert(id, chosen);
+    showRestored(id);
+}
 
-void PassMan::on_actionHow_to_Use_triggered() { help->show(); } // Display how to use info
+void PassMan::on_actionAttach_File_triggered()  // Attach a file to the selected entry, such as a key or certificate
+{
+    QString fileName = QFileDialog::getOpenFileName(ui->passManCentralWidget, ATTACH_TITLE);
+    if (fileName.length() < 1) return;  // Failed to get filename (user cancelled)
+    edits->flush();
+    QFile file(fileName);
+    bool attached = file.open(QIODevice::ReadOnly) && db->attach(selectedItem(), QFileInfo(fileName).fileName(), [&file](char* data, qint64 length) { return file.read(data, length); });    // Read a chunk at a time, never whole
+    if (!attached)
+    {
+        QMessageBox::critical(this, ATTACH_TITLE, ATTACH_ERROR);
+        return;
+    }
+    isSaved = false;
+    updateUndoActions();
+}
 
-void PassMan::on_actionYubiKey_Tester_triggered() { tester->show(); }  // Open YubiKey Tester
+void PassMan::on_actionSave_Attachment_triggered()  // Write one of the selected entry's attachments out to a file
+{
+    int a = chooseAttachment(SAVE_ATTACHMENT_TITLE);
+    if (a < 0) return;
+    EntryId id = selectedItem();
+    QString fileName = QFileDialog::getSaveFileName(ui->passManCentralWidget, SAVE_ATTACHMENT_TITLE, db->attachments(id).at(a).name);
+    if (fileName.length() < 1) return;  // Failed to get filename (user cancelled)
+    QSaveFile file(fileName);
+    bool written = file.open(QIODevice::WriteOnly) && db->extract(id, a, [&file](const char* data, size_t length) { return file.write(data, length) == (qint64) length; }) && file.commit();
+    if (!written)
+    {
+        file.cancelWriting();
+        QMessageBox::critical(this, SAVE_ATTACHMENT_TITLE, SAVE_ATTACHMENT_ERROR);
+    }
+}
+
+void PassMan::on_actionRemove_Attachment_triggered()    // Remove one of the selected entry's attachments
+{
+    int a = chooseAttachment(REMOVE_ATTACHMENT_TITLE);
+    if (a < 0) return;
+    edits->flush();
+    db->detach(selectedItem(), a);
+    isSaved = false;
+    updateUndoActions();
+}
+
+int PassMan::chooseAttachment(const QString& title) // Ask which of the selected entry's attachments to use, -1 if it has none or the user cancels
+{
+    QVector<EntryStore::Attachment> files = db->attachments(selectedItem());
+    if (files.isEmpty())
+    {
+        QMessageBox::information(this, title, NO_ATTACHMENTS);
+        return -1;
+    }
+    QStringList items;
+    foreach (const EntryStore::Attachment& file, files) items.append(ATTACHMENT_ITEM.arg(file.name).arg(file.size));
+    return chooseItem(title, ATTACHMENT_PROMPT, items); // Copies of a file share a name and size
+}
+
+int PassMan::chooseItem(const QString& title, const QString& prompt, const QStringList& items)  // Ask which of these items to use, returning its index, or -1 if the user cancels
+{
+    QInputDialog dialog(this);
+    dialog.setWindowTitle(title);
+    dialog.setLabelText(prompt);
+    dialog.setComboBoxItems(items);
+    dialog.setComboBoxEditable(false);
+    if (dialog.exec() != QDialog::Accepted) return -1;
+    QComboBox* box = dialog.findChild<QComboBox*>();    // The position chosen, as labels needn't be unique
+    return box ? box->currentIndex() : -1;
+}
+
+void PassMan::showRestored(const EntryId& id)   // Update GUI after undo or redo put back this entry
+{
+    isSaved = false;
+    ui->entryNameLineEdit->blockSignals(true);
+    ui->usernameLineEdit->blockSignals(true);
+    ui->passwordLineEdit->blockSignals(true);
+    ui->repeatedPasswordLineEdit->blockSignals(true);
+    ui->notesTextEdit->blockSignals(true);
+    updateListInfo(EntryId());  // The entry may have come back, gone, or been renamed
+    if (db->contains(id))
+    {
+        if (list->row(id) < 0)  // Filtered out, and should be listed
+        {
+            ui->filterLineEdit->clear();
+            shownGroup.clear();
+            updateListInfo(EntryId());
+        }
+        updateDisplayInfo(id);
+    }
+    updateActions();
+    ui->entryNameLineEdit->blockSignals(false);
+    ui->usernameLineEdit->blockSignals(false);
+    ui->passwordLineEdit->blockSignals(false);
+    ui->repeatedPasswordLineEdit->blockSignals(false);
+    ui->notesTextEdit->blockSignals(false);
+}
+
+void PassMan::on_actionAbout_triggered()    // Display about info
+{
+    if (!about) about = new About(VERSION);
+    about->show();
+}
+
+void PassMan::on_actionHow_to_Use_triggered()   // Display how to use info
+{
+    if (!help) help = new Help();
+    help->show();
+}
+
+void PassMan::on_actionYubiKey_Tester_triggered()   // Open YubiKey Tester
+{
+    if (!tester) tester = new YubiKeyTester(yubikey);
+    tester->show();
+}
+
+void PassMan::on_actionBenchmark_KDF_triggered()    // Measure the KDFs on this computer, setting the cost of later saves
+{
+    if (benchmark.isRunning()) return;
+    ui->actionBenchmark_KDF->setEnabled(false);
+    QApplication::setOverrideCursor(Qt::BusyCursor);    // The window stays usable meanwhile
+    benchmark.setFuture(QtConcurrent::run([]() { KdfPolicy().benchmark(); }));
+}
+
+void PassMan::benchmarkDone()   // Show the costs measured by the KDF benchmark
+{
+    QApplication::restoreOverrideCursor();
+    ui->actionBenchmark_KDF->setEnabled(true);
+    KdfPolicy policy;   // Read back from the settings the worker stored
+    QMessageBox::information(this, BENCHMARK_TITLE, BENCHMARK_RESULT.arg(policy.argon2Memory() / 1024).arg(policy.argon2Passes()).arg(policy.argon2Lanes()).arg(policy.pbkdf2Iterations()));
+}
 
-void PassMan::on_actionPassword_Generator_triggered() { gen->show(); } // Open password generator
+void PassMan::on_actionPassword_Generator_triggered() { generator()->show(); }   // Open password generator
 
 void PassMan::passGenDone() // Update after password generation done
 {
@@ -450,10 +940,8 @@ void PassMan::passGenDone() // Update after password generation done
     {
         ui->passwordLineEdit->setText(pass);
         ui->repeatedPasswordLineEdit->setText(pass);
-        int strength = round(StrengthCalculator::naiveEntropyBits(pass));
-        if (ui->passwordStrengthBar->maximum() < strength) ui->passwordStrengthBar->setMaximum(strength);
-        ui->passwordStrengthBar->setValue(round(StrengthCalculator::naiveEntropyBits(pass)));
-        updatePasswords();
+        edits->edit(selectedItem(), EntryStore::PASSWORD_FIELD);
+        edits->flush(); // Committed and rated at once, as nothing more is typed
     }
 }
 
@@ -461,18 +949,14 @@ void PassMan::closeEvent(QCloseEvent *event)    // Override the window close eve
 {
     if (close())
     {
-        tester->hide(); // Don't leave other windows hanging around!
-        auth->hide();
-        about->hide();
-        gen->hide();
-        strength->hide();
+        hideWindows();  // Don't leave other windows hanging around!
         event->accept();
         QApplication::quit();
     }
     event->ignore();    // User decided not to close
 }
 
-void PassMan::on_generatePasswordButton_clicked() { gen->show(); }
+void PassMan::on_generatePasswordButton_clicked() { generator()->show(); }
 
 void PassMan::on_actionCopy_Entry_Username_triggered()
 {
@@ -488,6 +972,7 @@ void PassMan::on_actionCopy_Entry_Password_triggered()
 
 void PassMan::on_actionPassword_Strength_Calculator_triggered()
 {
+    if (!strength) strength = new StrengthCalculator();
     strength->clear();
     strength->show();
 }
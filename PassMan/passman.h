@@ -12,15 +12,28 @@
 #include <QMessageBox>
 #include <QString>
 #include <QLabel>
+#include <QTreeWidgetItem>
 #include <QFileDialog>
 #include <QFile>
+#include <QFileInfo>
 #include <QIODevice>
 #include <QProcess>
 #include <QJsonDocument>
+#include <QSaveFile>
+#include <QInputDialog>
+#include <QComboBox>
+#include <QPushButton>
+#include <QFutureWatcher>
+#include <QtConcurrent>
 #include "database.h"
+#include "merger.h"
+#include "entrylistmodel.h"
+#include "editbuffer.h"
+#include "securememory.h"
 #include "yubikeytester.h"
 #include "yubikey.h"
 #include "authenticator.h"
+#include "kdfpolicy.h"
 #include "strengthcalculator.h"
 #include "about.h"
 #include "help.h"
@@ -46,6 +59,9 @@ class PassMan : public QMainWindow
         void on_actionNew_Database_triggered();
         void on_actionSave_Database_triggered();
         void on_actionSaveas_Database_triggered();
+        void on_actionExport_Database_triggered();
+        void on_actionMerge_Database_triggered();
+        void on_actionChange_Master_Password_triggered();
         void on_notesTextEdit_textChanged();
         void on_actionClose_Database_triggered();
         void on_actionQuit_triggered();
@@ -54,15 +70,22 @@ class PassMan : public QMainWindow
         void on_actionAbout_triggered();
         void on_actionHow_to_Use_triggered();
         void on_actionYubiKey_Tester_triggered();
-        void on_entryTableWidget_itemSelectionChanged();
+        void on_actionBenchmark_KDF_triggered();
+        void on_filterLineEdit_textEdited(const QString &arg1);
+        void on_filterLineEdit_returnPressed();
         void on_entryNameLineEdit_textEdited(const QString &arg1);
         void on_usernameLineEdit_textEdited(const QString &arg1);
         void on_passwordLineEdit_textEdited(const QString &arg1);
         void on_repeatedPasswordLineEdit_textEdited(const QString &arg1);
-        void updateStatusInfo();    // Update status bar
+        void updateStatusInfo();    // Update status bar, and the secret memory held in its tooltip
         void fileReadDone();    // Update GUI and states after file operation
         void fileWriteDone();   // Update state after file operation
         void passGenDone(); // Update GUI after password generation
+        void entrySelectionChanged();   // Update rest of GUI with data corresponding with this entry
+        void commitEdits(const EntryId& id, int fields);    // Write the fields edited since the last commit, then redo what depends on them once
+        void mergeOtherRead();  // Open the common copy once the other copy is read, or merge straight away
+        void mergeBaseRead();   // Merge once the common copy is read
+        void benchmarkDone();   // Show the costs measured by the KDF benchmark
         void on_actionPassword_Generator_triggered();
         void on_generatePasswordButton_clicked();
         void on_actionCopy_Entry_Username_triggered();
@@ -70,34 +93,80 @@ class PassMan : public QMainWindow
         void on_actionPassword_Strength_Calculator_triggered();
         void on_actionAbout_Qt_triggered();
         void on_actionAuto_Type_Entry_triggered();
+        void on_actionUndo_triggered();
+        void on_actionRedo_triggered();
+        void on_actionRestore_Earlier_Value_triggered();
+        void on_actionAttach_File_triggered();
+        void on_actionSave_Attachment_triggered();
+        void on_actionRemove_Attachment_triggered();
+        void on_groupTreeWidget_itemExpanded(QTreeWidgetItem* item);
+        void on_groupTreeWidget_itemSelectionChanged();
+        void on_groupLineEdit_textEdited(const QString &arg1);
+        void on_groupLineEdit_editingFinished();
+        void on_tagsLineEdit_textEdited(const QString &arg1);
 
 private:
         static const QString VERSION, NOT_LOADED, LOADED, FILE_FILTER, FILE_EXTENSION,  // Commonly used values
                              CLOSE_TITLE, CLOSE_QUESTION, OPEN_EXISTING_TITLE, CREATE_NEW_TITLE,
-                             SAVE_AS_TITLE, LINEEDIT_WHITE_BG, LINEEDIT_YELLOW_BG;
+                             SAVE_AS_TITLE, LINEEDIT_WHITE_BG, LINEEDIT_YELLOW_BG,
+                             EXPORT_TITLE, EXPORT_WARNING, EXPORT_ERROR, JSON_FILTER, JSON_EXTENSION,
+                             BENCHMARK_TITLE, BENCHMARK_RESULT, SECRET_MEMORY, UNLOCKED_MEMORY, ALL_GROUPS, TAG_PREFIX, TAG_SEPARATOR,
+                             HISTORY_TITLE, HISTORY_PROMPT, NO_HISTORY, REVISION_TIME_FORMAT, REVISED_USERNAME, REVISED_PASSWORD, REVISED_NOTES,
+                             MERGE_TITLE, MERGE_BASE_TITLE, MERGE_BASE_QUESTION, MERGE_CONFLICT, MERGE_TIMES, UNKNOWN_TIME, MERGE_REMOVED_HERE,
+                             MERGE_REMOVED_THERE, KEEP_THIS, TAKE_OTHER, MERGE_DONE,
+                             ATTACH_TITLE, ATTACH_ERROR, SAVE_ATTACHMENT_TITLE, SAVE_ATTACHMENT_ERROR, REMOVE_ATTACHMENT_TITLE, ATTACHMENT_PROMPT, ATTACHMENT_ITEM, NO_ATTACHMENTS;
+        static const int PATH_ROLE = Qt::UserRole;  // Group path held by each item of the group tree
+        static const int FILLED_ROLE = Qt::UserRole + 1;    // Whether an item's subgroups have been listed
+        static const int ROW_PADDING = 4;   // Pixels added to the text height for each row of the entry list
         Ui::PassMan *ui;
         Database *db;
         QLabel* yubikeyState;
         YubiKey* yubikey;
-        YubiKeyTester* tester;
+        YubiKeyTester* tester;  // Secondary windows are built the first time they're needed, null until then
         Authenticator* auth;
+        Authenticator* mergeAuth;   // Opens the copies being merged in, leaving auth's key for the open file
+        Database* mergeOther;   // Copy being merged in
+        Database* mergeBase;    // Copy from before the two diverged, if there is one
+        QString mergeBaseName;  // Common copy still to be opened
+        bool mergeWithBase;
         Generator* gen;
         About* about;
         Help* help;
         StrengthCalculator* strength;
+        QFutureWatcher<void> benchmark; // Measures the KDFs on a worker thread, which takes a second or two
         bool passMismatch, isOpen, isSaved;  // Indicate program state
         QString fileName;
+        EntryListModel* list;   // Entries shown in the entry list
+        EditBuffer* edits;  // Fields typed into since the last commit to the database
+        QString lastFilter; // Filter text the shown entries were matched against
+        QStringList lastTags;   // Tags the shown entries were filtered by
+        QString shownGroup; // Group selected in the group tree, empty for every entry
 
         void open(bool existing);   // Open a database file
         void save(bool existing);   // Save a database file
         bool close();    // Handle possible database closing
         void configGUI();  // Initialize GUI components for proper interaction
+        Authenticator* authenticator(); // Authenticator for the open file, built on first use
+        Authenticator* mergeAuthenticator();    // Authenticator for the copies being merged in, built on first use
+        Generator* generator(); // Password generator, built on first use
+        void hideWindows(); // Hide whichever secondary windows have been built
         void updateActions();   // Toggle menu actions based on program state
+        void updateUndoActions();   // Toggle undo and redo based on the edit history
+        void showRestored(const EntryId& id);   // Update GUI after undo or redo put back this entry
         int confirmClose(QString title, QString text);  // Confirm via message box whether to close
-        void updateListInfo(int row);   // Update the entry list after database change, or refresh if negative
-        void updateDisplayInfo(int row);    // Update the textboxes with currently selected entry, or clear if negative
-        int selectedItem(); // Returns currently selected item in the entry list
-        void updatePasswords(); // Handle parity between password textboxes on text changes
+        int chooseItem(const QString& title, const QString& prompt, const QStringList& items);   // Ask which of these items to use, returning its index, or -1 if the user cancels
+        int chooseAttachment(const QString& title); // Ask which of the selected entry's attachments to use, -1 if it has none or the user cancels
+        void merge();   // Merge the other copy into the open database, asking how to settle conflicts
+        void settle(Merger& merger, const Merger::Conflict& conflict);  // Ask which side of a conflict to take
+        static QString fieldName(int field);    // Name of an entry field, as a merge conflict shows it
+        void filterEntries();   // Fill the entry list with the entries matching the filter text, best first
+        void fillGroups();  // Rebuild the group tree, keeping the selected group open where it still exists
+        void fillSubgroups(QTreeWidgetItem* item);  // List the groups directly inside this one, the first time it is opened
+        void updateListInfo(const EntryId& id); // Update the entry list after database change, or refresh if null
+        void updateDisplayInfo(const EntryId& id);  // Update the textboxes with currently selected entry, or clear if null
+        EntryId selectedItem(); // Returns the entry currently selected in the entry list
+        void updatePasswords(const EntryId& id);    // Handle parity between password textboxes, setting this entry's password once they match
+        void updateStrength();  // Rate the password shown, once per commit rather than on every keystroke
         void closeEvent(QCloseEvent*);  // Handle window closing without leaking data
 };
 
@@ -0,0 +1,129 @@
+/*
+ * Description: Implementation of the Pbkdf2 class.
+ *              Derives keys with PBKDF2-HMAC-SHA512, producing the same output as Crypto++'s PKCS5_PBKDF2_HMAC.
+ *              The HMAC key states are computed once, so each iteration costs just two SHA-512 compressions.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * From the second iteration the HMAC message is always the previous 64-byte digest, so the inner and outer hashes
+ * each fit one padded block.  Those blocks are built directly as SHA-512 words and fed to the compression function,
+ * continuing from the saved key states, with no buffering or byte swapping inside the loop.
+ *
+ * A key of 64 bytes or less comes from a single chain of iterations, which can't be spread over SIMD lanes or cores.
+ */
+
+#include "pbkdf2.h"
+
+static inline CryptoPP::word64 loadBig64(const byte* in)    // Big-endian helpers, as SHA-512 reads words
+{
+    CryptoPP::word64 value = 0;
+    for (int i = 0; i < 8; i++) value = (value << 8) | in[i];
+    return value;
+}
+
+static inline void storeBig64(byte* out, CryptoPP::word64 value) { for (int i = 7; i >= 0; i--, value >>= 8) out[i] = (byte) value; }
+
+Pbkdf2::Pbkdf2(const byte* password, size_t passwordLength)
+{
+    cancelled = 0;
+    byte key[BLOCK_SIZE] = { 0 };
+    if (passwordLength > (size_t) BLOCK_SIZE) CryptoPP::SHA512().CalculateDigest(key, password, passwordLength);    // Long keys are hashed first, as HMAC does
+    else memcpy(key, password, passwordLength);
+    CryptoPP::word64 block[BLOCK_WORDS];
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        innerPad[i] = key[i] ^ 0x36;
+        outerPad[i] = key[i] ^ 0x5C;
+    }
+    CryptoPP::SHA512::InitState(innerState);
+    for (int i = 0; i < BLOCK_WORDS; i++) block[i] = loadBig64(innerPad + 8 * i);
+    CryptoPP::SHA512::Transform(innerState, block);
+    CryptoPP::SHA512::InitState(outerState);
+    for (int i = 0; i < BLOCK_WORDS; i++) block[i] = loadBig64(outerPad + 8 * i);
+    CryptoPP::SHA512::Transform(outerState, block);
+    memset(key, 0, sizeof(key));
+    memset(block, 0, sizeof(block));
+}
+
+Pbkdf2::~Pbkdf2()
+{
+    memset(innerState, 0, sizeof(innerState));  // Each state is as good as the password
+    memset(outerState, 0, sizeof(outerState));
+    memset(innerPad, 0, sizeof(innerPad));
+    memset(outerPad, 0, sizeof(outerPad));
+}
+
+void Pbkdf2::setCancel(const QAtomicInt* flag) { cancelled = flag; }    // Give up part way once this flag is set
+
+unsigned int Pbkdf2::deriveKey(byte* key, size_t keyLength, const byte* salt, size_t saltLength, unsigned int iterations, double seconds)   // Run at least this many iterations, or for this long, returning the count used, 0 if cancelled
+{
+    if (iterations < 1) iterations = 1;
+    CryptoPP::word64 u[STATE_WORDS];
+    CryptoPP::word64 t[STATE_WORDS];
+    CryptoPP::word64 block[BLOCK_WORDS];
+    block[STATE_WORDS] = 0x8000000000000000ULL; // Padding for a 64-byte message after one key block
+    for (int i = STATE_WORDS + 1; i < BLOCK_WORDS - 1; i++) block[i] = 0;
+    block[BLOCK_WORDS - 1] = (BLOCK_SIZE + CryptoPP::SHA512::DIGESTSIZE) * 8;
+    QElapsedTimer timer;
+    timer.start();
+    byte digest[CryptoPP::SHA512::DIGESTSIZE];
+    quint32 index = 1;
+    bool stopped = false;
+    for (size_t written = 0; written < keyLength; index++)
+    {
+        firstBlock(u, salt, saltLength, index);
+        memcpy(t, u, sizeof(t));
+        unsigned int j = 1;
+        for (; j < iterations || (seconds > 0 && ((j & 255) || timer.nsecsElapsed() < seconds * 1e9)); j++)  // Only the first block is timed, later ones repeat its count
+        {
+            if (!(j & CANCEL_MASK) && cancelled && cancelled->load())
+            {
+                stopped = true;
+                break;
+            }
+            nextBlock(u, block);
+            for (int w = 0; w < STATE_WORDS; w++) t[w] ^= u[w];
+        }
+        if (stopped) break; // The key is left unfinished
+        iterations = j;
+        seconds = 0;
+        for (int w = 0; w < STATE_WORDS; w++) storeBig64(digest + 8 * w, t[w]);
+        size_t length = (keyLength - written < sizeof(digest)) ? keyLength - written : sizeof(digest);
+        memcpy(key + written, digest, length);
+        written += length;
+    }
+    memset(u, 0, sizeof(u));
+    memset(t, 0, sizeof(t));
+    memset(block, 0, sizeof(block));
+    memset(digest, 0, sizeof(digest));
+    return stopped ? 0 : iterations;
+}
+
+void Pbkdf2::firstBlock(CryptoPP::word64* u, const byte* salt, size_t saltLength, quint32 index) const    // U1 = HMAC(password, salt | block index)
+{
+    byte counter[4];
+    byte digest[CryptoPP::SHA512::DIGESTSIZE];
+    storeBig64(digest, index);  // Borrow the buffer to encode the index big-endian
+    memcpy(counter, digest + 4, sizeof(counter));
+    CryptoPP::SHA512 inner;
+    inner.Update(innerPad, BLOCK_SIZE);
+    inner.Update(salt, saltLength);
+    inner.Update(counter, sizeof(counter));
+    inner.Final(digest);
+    CryptoPP::SHA512 outer;
+    outer.Update(outerPad, BLOCK_SIZE);
+    outer.Update(digest, sizeof(digest));
+    outer.Final(digest);
+    for (int w = 0; w < STATE_WORDS; w++) u[w] = loadBig64(digest + 8 * w);
+    memset(digest, 0, sizeof(digest));
+}
+
+void Pbkdf2::nextBlock(CryptoPP::word64* u, CryptoPP::word64* block) const  // U(n+1) = HMAC(password, U(n)), in place
+{
+    memcpy(block, u, STATE_WORDS * sizeof(CryptoPP::word64));   // Padding words after the digest never change
+    memcpy(u, innerState, STATE_WORDS * sizeof(CryptoPP::word64));
+    CryptoPP::SHA512::Transform(u, block);
+    memcpy(block, u, STATE_WORDS * sizeof(CryptoPP::word64));
+    memcpy(u, outerState, STATE_WORDS * sizeof(CryptoPP::word64));
+    CryptoPP::SHA512::Transform(u, block);
+}
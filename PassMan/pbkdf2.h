@@ -0,0 +1,40 @@
+/*
+ * Description: Definition of the Pbkdf2 class.
+ *              Derives keys with PBKDF2-HMAC-SHA512, producing the same output as Crypto++'s PKCS5_PBKDF2_HMAC.
+ *              The HMAC key states are computed once, so each iteration costs just two SHA-512 compressions.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef PBKDF2_H
+#define PBKDF2_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <crypto++/sha.h>
+
+class Pbkdf2
+{
+    public:
+        Pbkdf2(const byte* password, size_t passwordLength);
+        ~Pbkdf2();
+
+        void setCancel(const QAtomicInt* flag); // Give up part way once this flag is set
+        unsigned int deriveKey(byte* key, size_t keyLength, const byte* salt, size_t saltLength, unsigned int iterations, double seconds = 0);   // Run at least this many iterations, or for this long, returning the count used, 0 if cancelled
+
+    private:
+        static const int STATE_WORDS = 8;   // SHA-512 state, and digest
+        static const int BLOCK_WORDS = 16;
+        static const int BLOCK_SIZE = 128;
+        static const unsigned int CANCEL_MASK = 0xFFFF; // Iterations between looks at the cancel flag, less one
+        CryptoPP::word64 innerState[STATE_WORDS];   // States after hashing the padded key, shared by every HMAC
+        CryptoPP::word64 outerState[STATE_WORDS];
+        byte innerPad[BLOCK_SIZE];
+        byte outerPad[BLOCK_SIZE];
+        const QAtomicInt* cancelled;    // Null when the derivation can't be cancelled
+
+        void firstBlock(CryptoPP::word64* u, const byte* salt, size_t saltLength, quint32 index) const;   // U1 = HMAC(password, salt | block index)
+        void nextBlock(CryptoPP::word64* u, CryptoPP::word64* block) const;  // U(n+1) = HMAC(password, U(n)), in place
+};
+
+#endif // PBKDF2_H
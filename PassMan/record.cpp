@@ -0,0 +1,119 @@
+/*
+ * Description: Implementation of the RecordWriter and RecordReader classes.
+ *              Provide the compact binary encoding used for database contents.
+ *              Integers are unsigned LEB128 varints, and fields are a varint tag, a varint length, then the bytes.
+ *              Strings are stored as UTF-8, and unknown field tags can be skipped by readers.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#include "record.h"
+
+RecordWriter::RecordWriter() { }
+
+RecordWriter::~RecordWriter() { clear(); }  // Buffers may hold secrets
+
+void RecordWriter::varint(quint64 value)    // Append an unsigned integer
+{
+    while (value >= 0x80)
+    {
+        buffer.append((char) ((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.append((char) value);
+}
+
+void RecordWriter::field(quint64 tag, const QString& value) // Append a tagged UTF-8 string
+{
+    QByteArray utf8 = value.toUtf8();
+    field(tag, utf8.constData(), utf8.size());
+    utf8.fill(0);
+}
+
+void RecordWriter::field(quint64 tag, const QByteArray& value) { field(tag, value.constData(), value.size()); }    // Append tagged raw bytes
+
+void RecordWriter::field(quint64 tag, const char* value, int length)
+{
+    varint(tag);
+    varint(length);
+    buffer.append(value, length);
+}
+
+void RecordWriter::integer(quint64 tag, quint64 value)  // Append a tagged unsigned integer
+{
+    RecordWriter body;
+    body.varint(value);
+    field(tag, body.bytes());
+}
+
+void RecordWriter::record(const RecordWriter& body) // Append another writer's bytes as a length-prefixed record
+{
+    varint(body.size());
+    buffer.append(body.bytes());
+}
+
+void RecordWriter::append(const QByteArray& encoded) { buffer.append(encoded); }  // Append bytes that are already encoded
+
+const QByteArray& RecordWriter::bytes() const { return buffer; }    // Encoded bytes so far
+
+int RecordWriter::size() const { return buffer.size(); }
+
+void RecordWriter::clear()  // Wipe and empty the buffer
+{
+    buffer.fill(0);
+    buffer.clear();
+}
+
+RecordReader::RecordReader(const char* data, int length)
+{
+    this->data = data;
+    this->length = length;
+    pos = 0;
+}
+
+bool RecordReader::varint(quint64& value)   // Read an unsigned integer, false if incomplete or malformed
+{
+    value = 0;
+    for (int i = 0, shift = 0; i < MAX_VARINT_SIZE && pos + i < length; i++, shift += 7)
+    {
+        uchar b = (uchar) data[pos + i];
+        value |= ((quint64) (b & 0x7F)) << shift;
+        if (!(b & 0x80))
+        {
+            pos += i + 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RecordReader::field(quint64& tag, const char*& value, int& valueLength) // Read a tagged field, pointing into the source bytes
+{
+    int start = pos;
+    quint64 size;
+    if (!varint(tag) || !varint(size) || size > (quint64) remaining())
+    {
+        pos = start;
+        return false;
+    }
+    value = data + pos;
+    valueLength = (int) size;
+    pos += valueLength;
+    return true;
+}
+
+bool RecordReader::integer(const char* value, int valueLength, quint64& result)  // Decode a field written by RecordWriter::integer
+{
+    RecordReader in(value, valueLength);
+    return in.varint(result) && in.atEnd();
+}
+
+bool RecordReader::atEnd() const { return pos >= length; }  // Whether all bytes were consumed
+
+int RecordReader::position() const { return pos; }  // Bytes consumed so far
+
+int RecordReader::remaining() const { return length - pos; }    // Bytes not yet consumed
+
+const char* RecordReader::current() const { return data + pos; }    // Pointer to the next unread byte
+
+void RecordReader::skip(int n) { pos = qMin(pos + n, length); } // Consume bytes without interpreting them
@@ -0,0 +1,59 @@
+/*
+ * Description: Definition of the RecordWriter and RecordReader classes.
+ *              Provide the compact binary encoding used for database contents.
+ *              Integers are unsigned LEB128 varints, and fields are a varint tag, a varint length, then the bytes.
+ *              Strings are stored as UTF-8, and unknown field tags can be skipped by readers.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <QByteArray>
+#include <QString>
+
+class RecordWriter
+{
+    public:
+        RecordWriter();
+        ~RecordWriter();
+
+        void varint(quint64 value); // Append an unsigned integer
+        void field(quint64 tag, const QString& value);  // Append a tagged UTF-8 string
+        void field(quint64 tag, const QByteArray& value);   // Append tagged raw bytes
+        void field(quint64 tag, const char* value, int length);
+        void integer(quint64 tag, quint64 value);   // Append a tagged unsigned integer
+        void record(const RecordWriter& body);  // Append another writer's bytes as a length-prefixed record
+        void append(const QByteArray& encoded); // Append bytes that are already encoded
+        const QByteArray& bytes() const;    // Encoded bytes so far
+        int size() const;
+        void clear();   // Wipe and empty the buffer
+
+    private:
+        QByteArray buffer;
+};
+
+class RecordReader
+{
+    public:
+        static const int MAX_VARINT_SIZE = 10;  // Bytes needed for a 64-bit value
+
+        RecordReader(const char* data = 0, int length = 0);
+
+        bool varint(quint64& value);    // Read an unsigned integer, false if incomplete or malformed
+        bool field(quint64& tag, const char*& value, int& valueLength);  // Read a tagged field, pointing into the source bytes
+        static bool integer(const char* value, int valueLength, quint64& result);   // Decode a field written by RecordWriter::integer
+        bool atEnd() const; // Whether all bytes were consumed
+        int position() const;   // Bytes consumed so far
+        int remaining() const;  // Bytes not yet consumed
+        const char* current() const;    // Pointer to the next unread byte
+        void skip(int n);   // Consume bytes without interpreting them
+
+    private:
+        const char* data;
+        int length;
+        int pos;
+};
+
+#endif // RECORD_H
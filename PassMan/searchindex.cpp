@@ -0,0 +1,121 @@
+/*
+ * Description: Implementation of the SearchIndex class.
+ *              Keeps the case-folded UTF-8 text of every entry with a signature of the characters it holds.
+ *              Entries are ranked by fuzzy match, and only those whose signature holds every query character are scored.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Documents are numbered as they are added and never renumbered, and removing one only marks it, so a removal takes
+ * constant time and the owner's slots keep matching the documents until it rebuilds the index.
+ * A fuzzy match needs no particular substring, so rather than consult posting lists it tests the character signature
+ * of every document in one flat pass the compiler can vectorize, and only scores the text of those that pass.
+ */
+
+#include "searchindex.h"
+
+SearchIndex::SearchIndex() { }
+
+SearchIndex::~SearchIndex() { clear(); }
+
+void SearchIndex::build(const QStringList& texts)  // Index these texts as documents 0 onward, replacing everything
+{
+    clear();
+    this->texts.reserve(texts.size());
+    signatures.reserve(texts.size());
+    present.reserve(texts.size());
+    foreach (const QString& text, texts) append(text);
+}
+
+void SearchIndex::append(const QString& text)  // Index a new document, numbered after the last
+{
+    QByteArray folded = fold(text);
+    texts.append(folded);
+    signatures.append(FuzzyMatcher::signature(folded));
+    present.append(true);
+}
+
+void SearchIndex::update(int document, const QString& text)   // Reindex a document whose text changed
+{
+    QByteArray folded = fold(text);
+    if (!present.at(document) || folded == texts.at(document)) return;
+    texts[document].fill(0);
+    texts[document] = folded;
+    signatures[document] = FuzzyMatcher::signature(folded);
+}
+
+void SearchIndex::remove(int document) // Drop a document, its number isn't reused
+{
+    texts[document].fill(0);
+    texts[document].clear();
+    signatures[document] = 0;
+    present[document] = false;
+}
+
+QVector<int> SearchIndex::match(const QString& query) const   // Documents whose text holds the query's characters in order, best match first
+{
+    FuzzyMatcher matcher(query);
+    quint64 needed = matcher.signature();
+    const quint64* signature = signatures.constData();
+    int count = signatures.size();
+    QVector<uchar> passed(count);
+    uchar* pass = passed.data();
+    for (int d = 0; d < count; d++) pass[d] = (signature[d] & needed) == needed;    // No branches, so this vectorizes
+    QVector<int> documents;
+    for (int d = 0; d < count; d++) if (pass[d]) documents.append(d);
+    return rank(matcher, documents);
+}
+
+QVector<int> SearchIndex::match(const QString& query, const QVector<int>& within) const   // The same, only among these documents
+{
+    FuzzyMatcher matcher(query);
+    QVector<int> documents;
+    documents.reserve(within.size());
+    foreach (int d, within)
+    {
+        if ((signatures.at(d) & matcher.signature()) == matcher.signature()) documents.append(d);
+    }
+    return rank(matcher, documents);
+}
+
+void SearchIndex::swap(SearchIndex& other)    // Exchange every document with another index
+{
+    texts.swap(other.texts);
+    signatures.swap(other.signatures);
+    present.swap(other.present);
+}
+
+void SearchIndex::clear()  // Wipe and empty the index
+{
+    for (int i = 0; i < texts.size(); i++) texts[i].fill(0);
+    texts.clear();
+    signatures.clear();
+    present.clear();
+}
+
+QByteArray SearchIndex::fold(const QString& text) { return FuzzyMatcher::fold(text); }   // Case-folded UTF-8, as indexed and queried
+
+QVector<int> SearchIndex::rank(const FuzzyMatcher& matcher, const QVector<int>& documents) const  // Score these documents, returning the matches best first
+{
+    QVector<Ranked> ranked;
+    foreach (int d, documents)
+    {
+        if (!present.at(d)) continue;   // Removed, which only an empty query lets through
+        Ranked match;
+        match.score = matcher.score(texts.at(d));
+        match.length = texts.at(d).size();
+        match.document = d;
+        if (match.score >= 0) ranked.append(match);
+    }
+    std::sort(ranked.begin(), ranked.end());
+    QVector<int> found;
+    found.reserve(ranked.size());
+    for (int i = 0; i < ranked.size(); i++) found.append(ranked.at(i).document);
+    return found;
+}
+
+bool SearchIndex::Ranked::operator<(const Ranked& other) const    // Higher scores first, then shorter texts, then document order
+{
+    if (score != other.score) return score > other.score;
+    if (length != other.length) return length < other.length;
+    return document < other.document;
+}
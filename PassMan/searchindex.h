@@ -0,0 +1,50 @@
+/*
+ * Description: Definition of the SearchIndex class.
+ *              Keeps the case-folded UTF-8 text of every entry with a signature of the characters it holds.
+ *              Entries are ranked by fuzzy match, and only those whose signature holds every query character are scored.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+#include "fuzzymatcher.h"
+
+class SearchIndex
+{
+    public:
+        SearchIndex();
+        ~SearchIndex();
+
+        void build(const QStringList& texts);   // Index these texts as documents 0 onward, replacing everything
+        void append(const QString& text);   // Index a new document, numbered after the last
+        void update(int document, const QString& text); // Reindex a document whose text changed
+        void remove(int document);  // Drop a document, its number isn't reused
+        QVector<int> match(const QString& query) const; // Documents whose text holds the query's characters in order, best match first
+        QVector<int> match(const QString& query, const QVector<int>& within) const; // The same, only among these documents
+        void clear();   // Wipe and empty the index
+        void swap(SearchIndex& other); // Exchange every document with another index
+
+    private:
+        struct Ranked   // A fuzzy match, ordered best first
+        {
+            int score;
+            int length;
+            int document;
+            bool operator<(const Ranked& other) const;  // Higher scores first, then shorter texts, then document order
+        };
+        QVector<QByteArray> texts;  // Case-folded text of each document, empty once removed
+        QVector<quint64> signatures;    // Characters in the text of each document, none once removed
+        QVector<bool> present;  // Whether each document is still indexed
+
+        static QByteArray fold(const QString& text);    // Case-folded UTF-8, as indexed and queried
+        QVector<int> rank(const FuzzyMatcher& matcher, const QVector<int>& documents) const;    // Score these documents, returning the matches best first
+};
+
+#endif // SEARCHINDEX_H
@@ -0,0 +1,154 @@
+/*
+ * Description: Implementation of the SecureMemory class.
+ *              Hands out memory for keys and decrypted secrets from a pool of pages kept out of swap and core dumps.
+ *              Memory is wiped as it is released, and the pool reports how many secret bytes are held.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Small requests are rounded up to a power of two and carved from 64 KiB slabs, so locking costs one mlock call
+ * per slab rather than one per key or string.  Released blocks are wiped and kept on a free list for their size, and
+ * slabs are never returned, so the pool holds as much as was ever needed at once.  Requests over 16 KiB, such as the
+ * entry arena, get pages of their own, which are wiped and unmapped on release.
+ * The process may only lock so much memory (RLIMIT_MEMLOCK), often a few MiB or less.  The soft limit is raised to
+ * the hard one at first use, and past it pages are still allocated, wiped and kept out of core dumps, only swappable.
+ * This is reported once, and unlockedBytes says how much is affected.
+ */
+
+#include "securememory.h"
+
+void* SecureMemory::allocate(size_t size)  // Zeroed memory, locked in RAM while the locked-memory limit allows
+{
+    if (size == 0) return 0;
+    Pool& p = pool();
+    QMutexLocker lock(&p.mutex);
+    if (size > MAX_BLOCK)
+    {
+        bool isLocked;
+        void* pages = mapPages(p, size, isLocked);
+        if (isLocked) p.lockedRegions.insert((quintptr) pages);
+        p.live += size;
+        return pages;
+    }
+    int c = classOf(size);
+    size_t blockSize = MIN_BLOCK << c;
+    void* block = p.freeBlocks[c];
+    if (block)
+    {
+        p.freeBlocks[c] = *(void**) block;
+        *(void**) block = 0;    // The rest was wiped on release
+    }
+    else
+    {
+        if (p.slabLeft < blockSize)
+        {
+            while (p.slabLeft >= MIN_BLOCK) // Keep the tail of the old slab as blocks that fit it
+            {
+                int t = classOf(p.slabLeft);
+                if ((MIN_BLOCK << t) > p.slabLeft) t--;
+                *(void**) p.slab = p.freeBlocks[t];
+                p.freeBlocks[t] = p.slab;
+                p.slab += MIN_BLOCK << t;
+                p.slabLeft -= MIN_BLOCK << t;
+            }
+            bool isLocked;
+            p.slab = (char*) mapPages(p, SLAB_SIZE, isLocked);
+            p.slabLeft = SLAB_SIZE;
+        }
+        block = p.slab;
+        p.slab += blockSize;
+        p.slabLeft -= blockSize;
+    }
+    p.live += size;
+    return block;
+}
+
+void SecureMemory::release(void* block, size_t size)   // Wipe memory from allocate, given the same size, and return it to the pool
+{
+    if (!block) return;
+    memset(block, 0, size);
+    Pool& p = pool();
+    QMutexLocker lock(&p.mutex);
+    p.live -= size;
+    if (size > MAX_BLOCK)
+    {
+        size_t length = (size + getpagesize() - 1) / getpagesize() * getpagesize();
+        if (p.lockedRegions.remove((quintptr) block)) p.locked -= length;
+        else p.unlocked -= length;
+        munmap(block, length);  // Unlocks as well
+        return;
+    }
+    int c = classOf(size);
+    *(void**) block = p.freeBlocks[c];
+    p.freeBlocks[c] = block;
+}
+
+size_t SecureMemory::liveBytes()
+{
+    Pool& p = pool();
+    QMutexLocker lock(&p.mutex);
+    return p.live;
+}
+
+size_t SecureMemory::lockedBytes()
+{
+    Pool& p = pool();
+    QMutexLocker lock(&p.mutex);
+    return p.locked;
+}
+
+size_t SecureMemory::unlockedBytes()
+{
+    Pool& p = pool();
+    QMutexLocker lock(&p.mutex);
+    return p.unlocked;
+}
+
+SecureMemory::Pool& SecureMemory::pool()   // Shared by every allocation, and never torn down, as secrets may outlive main
+{
+    static Pool* shared = new Pool;
+    return *shared;
+}
+
+SecureMemory::Pool::Pool()  // Empty, with the locked-memory limit raised as far as it goes
+{
+    for (int c = 0; c < CLASSES; c++) freeBlocks[c] = 0;
+    slab = 0;
+    slabLeft = 0;
+    live = locked = unlocked = 0;
+    limit = 0;
+    warned = false;
+    struct rlimit memlock;
+    if (getrlimit(RLIMIT_MEMLOCK, &memlock) != 0) return;
+    if (memlock.rlim_cur < memlock.rlim_max)    // Allowed to take the rest without privileges
+    {
+        memlock.rlim_cur = memlock.rlim_max;
+        if (setrlimit(RLIMIT_MEMLOCK, &memlock) != 0) getrlimit(RLIMIT_MEMLOCK, &memlock);
+    }
+    limit = (memlock.rlim_cur == RLIM_INFINITY) ? (size_t) -1 : (size_t) memlock.rlim_cur;
+}
+
+int SecureMemory::classOf(size_t size)  // Smallest block size class that fits
+{
+    int c = 0;
+    while ((MIN_BLOCK << c) < size) c++;
+    return c;
+}
+
+void* SecureMemory::mapPages(Pool& p, size_t length, bool& isLocked)  // Fresh zeroed pages, locked if the limit allows
+{
+    length = (length + getpagesize() - 1) / getpagesize() * getpagesize();
+    void* pages = mmap(0, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED) throw std::bad_alloc();
+#ifdef MADV_DONTDUMP
+    madvise(pages, length, MADV_DONTDUMP);  // Left out of core dumps even when it can't be locked
+#endif
+    isLocked = (p.locked + length <= p.limit) && mlock(pages, length) == 0;
+    if (isLocked) p.locked += length;
+    else
+    {
+        p.unlocked += length;
+        if (!p.warned) qWarning("Locked-memory limit reached, further secrets may be swapped to disk");
+        p.warned = true;
+    }
+    return pages;
+}
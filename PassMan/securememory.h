@@ -0,0 +1,84 @@
+/*
+ * Description: Definition of the SecureMemory class and its allocator.
+ *              Hands out memory for keys and decrypted secrets from a pool of pages kept out of swap and core dumps.
+ *              Memory is wiped as it is released, and the pool reports how many secret bytes are held.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef SECUREMEMORY_H
+#define SECUREMEMORY_H
+
+#include <QMutex>
+#include <QSet>
+#include <QtGlobal>
+#include <cstring>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <crypto++/secblock.h>
+
+class SecureMemory
+{
+    public:
+        static void* allocate(size_t size); // Zeroed memory, locked in RAM while the locked-memory limit allows
+        static void release(void* block, size_t size);  // Wipe memory from allocate, given the same size, and return it to the pool
+        static size_t liveBytes();  // Secret bytes allocated and not yet released
+        static size_t lockedBytes();    // Pool bytes locked in RAM
+        static size_t unlockedBytes();  // Pool bytes left swappable, past the locked-memory limit
+
+    private:
+        static const size_t SLAB_SIZE = 64 * 1024;  // Pages locked at once and carved into small blocks
+        static const size_t MIN_BLOCK = 16; // Smallest block, and the alignment of every block
+        static const int CLASSES = 11;  // Block sizes, doubling from MIN_BLOCK to a quarter slab
+        static const size_t MAX_BLOCK = MIN_BLOCK << (CLASSES - 1); // Larger requests get pages of their own
+        struct Pool
+        {
+            Pool(); // Empty, with the locked-memory limit raised as far as it goes
+
+            QMutex mutex;
+            void* freeBlocks[CLASSES];  // Released blocks of each size, linked through their first bytes
+            char* slab; // Unused part of the newest slab
+            size_t slabLeft;
+            QSet<quintptr> lockedRegions;   // Pages of large blocks that are locked
+            size_t live, locked, unlocked;
+            size_t limit;   // Bytes this process may lock
+            bool warned;    // Whether running past the limit was reported
+        };
+
+        static Pool& pool();    // Shared by every allocation, and never torn down, as secrets may outlive main
+        static int classOf(size_t size);    // Smallest block size class that fits
+        static void* mapPages(Pool& p, size_t length, bool& isLocked);  // Fresh zeroed pages, locked if the limit allows
+};
+
+template <class T>
+class SecureAllocator : public CryptoPP::AllocatorBase<T>   // Draws Crypto++ blocks and standard containers from SecureMemory
+{
+    public:
+        typedef typename CryptoPP::AllocatorBase<T>::value_type value_type;
+        typedef typename CryptoPP::AllocatorBase<T>::size_type size_type;
+        typedef typename CryptoPP::AllocatorBase<T>::pointer pointer;
+
+        SecureAllocator() { }
+        template <class U> SecureAllocator(const SecureAllocator<U>&) { }
+
+        pointer allocate(size_type size, const void* hint = 0)
+        {
+            (void) hint;
+            if (size == 0) return 0;
+            if (size > (size_t) -1 / sizeof(T)) throw std::bad_alloc();
+            return static_cast<pointer>(SecureMemory::allocate(size * sizeof(T)));
+        }
+        void deallocate(void* block, size_type size) { SecureMemory::release(block, size * sizeof(T)); }
+        pointer reallocate(T* oldBlock, size_type oldSize, size_type newSize, bool preserve) { return CryptoPP::StandardReallocate(*this, oldBlock, oldSize, newSize, preserve); }
+        bool operator==(const SecureAllocator&) const { return true; } // Every instance draws on the same pool
+        bool operator!=(const SecureAllocator&) const { return false; }
+        template <class U> struct rebind { typedef SecureAllocator<U> other; };
+};
+
+typedef CryptoPP::SecBlock<byte, SecureAllocator<byte> > SecureBlock;   // In place of SecByteBlock wherever it holds secrets
+typedef std::basic_string<char, std::char_traits<char>, SecureAllocator<char> > SecureString;  // Decrypted text gathered by a Crypto++ sink
+
+#endif // SECUREMEMORY_H
@@ -0,0 +1,98 @@
+/*
+ * Description: Known-answer tests for the key derivation functions.
+ *              Checks Argon2id against the phc-winner-argon2 reference vectors, and PBKDF2-HMAC-SHA512 against
+ *              published vectors and Crypto++'s own implementation.  Exits non-zero if any check fails.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Argon2 takes no secret key or associated data, so the RFC 9106 vectors, which use both, don't apply.  The reference
+ * implementation's Argon2id vectors use neither, and cover one and two lanes.
+ */
+
+#include <QByteArray>
+#include <cstdio>
+#include <cstring>
+#include <crypto++/pwdbased.h>
+#include "argon2.h"
+#include "pbkdf2.h"
+
+static int failures = 0;
+
+static void check(const char* name, const QByteArray& actual, const char* expected) // Compare output with a hex answer
+{
+    bool passed = (actual.toHex() == QByteArray(expected));
+    if (!passed) failures++;
+    printf("%s %s\n", passed ? "PASS" : "FAIL", name);
+    if (!passed) printf("     got      %s\n     expected %s\n", actual.toHex().constData(), expected);
+}
+
+static void check(const char* name, bool passed)
+{
+    if (!passed) failures++;
+    printf("%s %s\n", passed ? "PASS" : "FAIL", name);
+}
+
+static QByteArray argon2(quint32 memory, quint32 passes, quint32 lanes, const char* password, const char* salt, const QAtomicInt* cancel = 0)
+{
+    QByteArray key(32, 0);
+    Argon2 kdf(memory, passes, lanes);
+    kdf.setCancel(cancel);
+    if (!kdf.deriveKey((byte*) key.data(), key.size(), (const byte*) password, strlen(password), (const byte*) salt, strlen(salt))) return QByteArray();
+    return key;
+}
+
+static QByteArray pbkdf2(const QByteArray& password, const QByteArray& salt, unsigned int iterations, int length)
+{
+    QByteArray key(length, 0);
+    Pbkdf2(password.size() ? (const byte*) password.constData() : 0, password.size()).deriveKey((byte*) key.data(), key.size(), (const byte*) salt.constData(), salt.size(), iterations);
+    return key;
+}
+
+static QByteArray cryptoppPbkdf2(const QByteArray& password, const QByteArray& salt, unsigned int iterations, int length)
+{
+    QByteArray key(length, 0);
+    CryptoPP::PKCS5_PBKDF2_HMAC<CryptoPP::SHA512>().DeriveKey((byte*) key.data(), key.size(), 0, (const byte*) password.constData(), password.size(), (const byte*) salt.constData(), salt.size(), iterations);
+    return key;
+}
+
+static void testArgon2()
+{
+    check("argon2id m=256 t=2 p=1", argon2(256, 2, 1, "password", "somesalt"), "9dfeb910e80bad0311fee20f9c0e2b12c17987b4cac90c2ef54d5b3021c68bfe");
+    check("argon2id m=256 t=2 p=2", argon2(256, 2, 2, "password", "somesalt"), "6d093c501fd5999645e0ea3bf620d7b8be7fd2db59c20d9fff9539da2bf57037");
+    check("argon2id m=65536 t=2 p=1", argon2(65536, 2, 1, "password", "somesalt"), "09316115d5cf24ed5a15a31a3ba326e5cf32edc24702987c02b6566f61913cf7");
+    QAtomicInt cancel(1);
+    check("argon2id cancelled", argon2(256, 2, 1, "password", "somesalt", &cancel).isEmpty());
+}
+
+static void testPbkdf2()
+{
+    check("pbkdf2-sha512 c=1", pbkdf2("password", "salt", 1, 64),
+          "867f70cf1ade02cff3752599a3a53dc4af34c7a669815ae5d513554e1c8cf252c02d470a285a0501bad999bfe943c08f050235d7d68b1da55e63f73b60a57fce");
+    check("pbkdf2-sha512 c=2", pbkdf2("password", "salt", 2, 64),
+          "e1d9c16aa681708a45f5c7c4e215ceb66e011a2e9f0040713f18aefdb866d53cf76cab2868a39b9f7840edce4fef5a82be67335c77a6068e04112754f27ccf4e");
+    check("pbkdf2-sha512 c=4096", pbkdf2("password", "salt", 4096, 64),
+          "d197b1b33db0143e018b12f3d1d1479e6cdebdcc97c5c0f87f6902e072f457b5143f30602641b3d55cd335988cb36b84376060ecd532e039b742a239434af2d5");
+    check("pbkdf2-sha512 c=4096 long", pbkdf2("passwordPASSWORDpassword", "saltSALTsaltSALTsaltSALTsaltSALTsalt", 4096, 64),
+          "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8");
+
+    QByteArray longPassword(200, 'p');  // Hashed first, as it is longer than a block
+    check("pbkdf2-sha512 long password", pbkdf2(longPassword, "salt", 3, 64).toHex() == cryptoppPbkdf2(longPassword, "salt", 3, 64).toHex());
+    check("pbkdf2-sha512 two blocks", pbkdf2("password", "salt", 5, 100).toHex() == cryptoppPbkdf2("password", "salt", 5, 100).toHex());
+
+    QByteArray timed(64, 0);
+    unsigned int used = Pbkdf2((const byte*) "password", 8).deriveKey((byte*) timed.data(), timed.size(), (const byte*) "salt", 4, 1, 0.01);
+    check("pbkdf2-sha512 timed", used > 0 && timed == pbkdf2("password", "salt", used, 64));   // The count it reports reproduces the key
+
+    QAtomicInt cancel(1);
+    Pbkdf2 cancelled((const byte*) "password", 8);
+    cancelled.setCancel(&cancel);
+    check("pbkdf2-sha512 cancelled", cancelled.deriveKey((byte*) timed.data(), timed.size(), (const byte*) "salt", 4, 1 << 17) == 0);
+}
+
+int main()
+{
+    testArgon2();
+    testPbkdf2();
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
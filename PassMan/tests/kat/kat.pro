@@ -0,0 +1,25 @@
+#-------------------------------------------------
+#
+# Known-answer tests for the key derivation functions,
+# run with make check
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = kat
+TEMPLATE = app
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../..
+
+SOURCES += kat.cpp \
+    ../../argon2.cpp \
+    ../../pbkdf2.cpp
+
+HEADERS += ../../argon2.h \
+    ../../pbkdf2.h
+
+LIBS += -L/usr/lib/libcrypto++.a -lcrypto++
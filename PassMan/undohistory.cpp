@@ -0,0 +1,125 @@
+/*
+ * Description: Implementation of the UndoHistory class.
+ *              Keeps the recent states of the database as persistent snapshots of the entries edited, for undo and redo.
+ *              Typing into one field of one entry makes a single step, and only a configured number of steps are kept.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Each state maps the entries edited so far to their encoded records as they stood after that step (see EntryMap).
+ * A step only copies the path to its one entry, so a hundred states cost little more than one.  An entry no state
+ * holds yet is unchanged since the oldest state, so its record from then is kept once, in origins, when it is first
+ * edited.  Records are kept sealed, as the database holds them, so no secret is decrypted to remember it.
+ * Dropping the oldest step leaves the entries only it edited in the snapshots, so once those outnumber the steps
+ * kept, the snapshots are rebuilt from the oldest state with just the entries still edited.
+ */
+
+#include "undohistory.h"
+
+const QString UndoHistory::DEPTH_KEY = "undo/depth";
+
+UndoHistory::UndoHistory()
+{
+    depth = configuredDepth();
+    clear();
+}
+
+int UndoHistory::configuredDepth()  // Depth from the settings file, at least one step
+{
+    int steps = QSettings().value(DEPTH_KEY, DEFAULT_DEPTH).toInt();
+    return (steps < 1) ? 1 : steps;
+}
+
+void UndoHistory::record(const EntryId& id, const QByteArray& before, const QByteArray& after, int field)  // Note an edit to one entry, joining the open step if it types on into the same field
+{
+    states.resize(current + 1); // Redo is lost once the history branches
+    State& last = states[current];
+    if (open && field != 0 && last.id == id && last.field == field)
+    {
+        last.entries = last.entries.inserted(id, after);    // Same step, typed further
+        return;
+    }
+    if (!last.entries.contains(id) && !origins.contains(id)) origins = origins.inserted(id, before);    // First edit since the oldest state
+    State next;
+    next.entries = last.entries.inserted(id, after);
+    next.id = id;
+    next.field = field;
+    states.append(next);
+    current++;
+    open = (field != 0);
+    if (current > depth)    // Forget the oldest step
+    {
+        states.remove(0);
+        current--;
+    }
+    if (states.last().entries.size() + origins.size() > REBASE_FACTOR * depth) rebase();
+}
+
+void UndoHistory::close() { open = false; } // End the open step, so the next edit starts its own
+
+bool UndoHistory::canUndo() const { return current > 0; }
+
+bool UndoHistory::canRedo() const { return current < states.size() - 1; }
+
+bool UndoHistory::undo(EntryId& id, QByteArray& value)  // Step back, giving the entry to restore and its encoded value, empty if it didn't exist
+{
+    if (!canUndo()) return false;
+    id = states.at(current).id;
+    current--;
+    value = valueAt(current, id);
+    open = false;
+    return true;
+}
+
+bool UndoHistory::redo(EntryId& id, QByteArray& value)  // Step forward again, the same way
+{
+    if (!canRedo()) return false;
+    current++;
+    id = states.at(current).id;
+    value = valueAt(current, id);
+    open = false;
+    return true;
+}
+
+void UndoHistory::swap(UndoHistory& other) // Exchange every step with another history
+{
+    states.swap(other.states);
+    qSwap(current, other.current);
+    qSwap(origins, other.origins);
+    qSwap(depth, other.depth);
+    qSwap(open, other.open);
+}
+
+void UndoHistory::clear()   // Forget every step
+{
+    states.clear();
+    states.append(State());
+    states[0].field = 0;
+    current = 0;
+    origins = EntryMap();
+    open = false;
+}
+
+QByteArray UndoHistory::valueAt(int state, const EntryId& id) const // An entry as it stood in this state
+{
+    const EntryMap& entries = states.at(state).entries;
+    return entries.contains(id) ? entries.value(id) : origins.value(id);
+}
+
+void UndoHistory::rebase()  // Rebuild the snapshots from the oldest state, keeping only entries the steps still edit
+{
+    EntryMap base;
+    for (int s = 1; s < states.size(); s++)
+    {
+        const EntryId& id = states.at(s).id;
+        if (!base.contains(id)) base = base.inserted(id, valueAt(0, id));
+    }
+    EntryMap entries;
+    for (int s = 1; s < states.size(); s++)
+    {
+        const EntryId& id = states.at(s).id;
+        entries = entries.inserted(id, states.at(s).entries.value(id));
+        states[s].entries = entries;
+    }
+    states[0].entries = EntryMap();
+    origins = base;
+}
@@ -0,0 +1,54 @@
+/*
+ * Description: Definition of the UndoHistory class.
+ *              Keeps the recent states of the database as persistent snapshots of the entries edited, for undo and redo.
+ *              Typing into one field of one entry makes a single step, and only a configured number of steps are kept.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <QSettings>
+#include <QString>
+#include <QVector>
+#include "entryid.h"
+#include "entrymap.h"
+
+class UndoHistory
+{
+    public:
+        static const int DEFAULT_DEPTH = 100;   // Steps kept when none is configured
+
+        UndoHistory();
+
+        static int configuredDepth();   // Depth from the settings file, at least one step
+        void record(const EntryId& id, const QByteArray& before, const QByteArray& after, int field = 0);  // Note an edit to one entry, joining the open step if it types on into the same field
+        void close();   // End the open step, so the next edit starts its own
+        bool canUndo() const;
+        bool canRedo() const;
+        bool undo(EntryId& id, QByteArray& value);  // Step back, giving the entry to restore and its encoded value, empty if it didn't exist
+        bool redo(EntryId& id, QByteArray& value);  // Step forward again, the same way
+        void clear();   // Forget every step
+        void swap(UndoHistory& other);  // Exchange every step with another history
+
+    private:
+        static const QString DEPTH_KEY;
+        static const int REBASE_FACTOR = 4; // Entries held per step kept before the snapshots are rebuilt, twice what a rebuild leaves
+        struct State    // The database after a step
+        {
+            EntryMap entries;   // Every entry edited up to this step, as it stood then
+            EntryId id; // Entry the step edited, null for the oldest state
+            int field;  // Field the step edited, 0 for other changes
+        };
+        QVector<State> states;  // Oldest first
+        int current;    // State the database is in
+        EntryMap origins;   // Edited entries as they stood in the oldest state, for those no state holds yet
+        int depth;  // Steps kept
+        bool open;  // Whether the newest step can still take edits
+
+        QByteArray valueAt(int state, const EntryId& id) const; // An entry as it stood in this state
+        void rebase();  // Rebuild the snapshots from the oldest state, keeping only entries the steps still edit
+};
+
+#endif // UNDOHISTORY_H
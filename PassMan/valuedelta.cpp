@@ -0,0 +1,77 @@
+/*
+ * Description: Implementation of the ValueDelta class.
+ *              Encodes one value as an edit of another, so earlier versions of long notes cost little more than the change.
+ *              A delta keeps the bytes the two values share at either end, and holds only the middle that differs.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Delta: varint prefix | varint removed | varint flags | middle
+ * The value is the base's first prefix bytes, then the middle, then the base after the removed bytes that follow the
+ * prefix.  Edits between two saves of a note are usually one run of typing, which this captures exactly, and scattered
+ * edits only widen the middle, which is compressed like a whole note would be once it is long enough.
+ */
+
+#include "valuedelta.h"
+
+void ValueDelta::make(const byte* base, size_t baseLength, const byte* value, size_t valueLength, int level, SecureBlock& delta)  // Encode value as an edit of base, its middle compressed at this level when that makes it smaller
+{
+    size_t shorter = qMin(baseLength, valueLength);
+    size_t prefix = 0;
+    while (prefix < shorter && base[prefix] == value[prefix]) prefix++;
+    size_t suffix = 0;  // Never overlaps the prefix
+    while (suffix < shorter - prefix && base[baseLength - 1 - suffix] == value[valueLength - 1 - suffix]) suffix++;
+    const byte* middle = value + prefix;
+    size_t middleLength = valueLength - prefix - suffix;
+    SecureBlock packed;
+    quint64 flags = 0;
+    if (Compressor::compress((const char*) middle, middleLength, level, packed))
+    {
+        middle = packed.BytePtr();
+        middleLength = packed.size();
+        flags |= DEFLATED;
+    }
+    quint64 head[] = { prefix, baseLength - prefix - suffix, flags };
+    byte encoded[3 * RecordReader::MAX_VARINT_SIZE];
+    size_t used = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        quint64 v = head[i];
+        do  // Unsigned LEB128, as RecordWriter writes it
+        {
+            byte b = v & 0x7F;
+            v >>= 7;
+            encoded[used++] = v ? (b | 0x80) : b;
+        } while (v);
+    }
+    delta.CleanNew(used + middleLength);
+    memcpy(delta.BytePtr(), encoded, used);
+    if (middleLength > 0) memcpy(delta.BytePtr() + used, middle, middleLength);
+}
+
+void ValueDelta::identity(SecureBlock& delta)   // Delta that leaves any base as it is
+{
+    delta.CleanNew(3);  // Nothing kept or removed, and an empty middle, so the whole base follows
+}
+
+bool ValueDelta::apply(const byte* base, size_t baseLength, const byte* delta, size_t deltaLength, SecureBlock& value)  // Rebuild the value from base, false if the delta is malformed or doesn't fit it
+{
+    RecordReader in((const char*) delta, (int) deltaLength);
+    quint64 prefix, removed, flags;
+    if (!in.varint(prefix) || !in.varint(removed) || !in.varint(flags)) return false;
+    if (prefix > baseLength || removed > baseLength - prefix || (flags & ~(quint64) DEFLATED)) return false;
+    const byte* middle = (const byte*) in.current();
+    size_t middleLength = in.remaining();
+    SecureBlock expanded;
+    if (flags & DEFLATED)
+    {
+        if (!Compressor::decompress(middle, middleLength, expanded)) return false;
+        middle = expanded.BytePtr();
+        middleLength = expanded.size();
+    }
+    size_t tail = baseLength - prefix - removed;
+    value.CleanNew(prefix + middleLength + tail);
+    if (prefix > 0) memcpy(value.BytePtr(), base, prefix);
+    if (middleLength > 0) memcpy(value.BytePtr() + prefix, middle, middleLength);
+    if (tail > 0) memcpy(value.BytePtr() + prefix + middleLength, base + prefix + removed, tail);
+    return true;
+}
@@ -0,0 +1,29 @@
+/*
+ * Description: Definition of the ValueDelta class.
+ *              Encodes one value as an edit of another, so earlier versions of long notes cost little more than the change.
+ *              A delta keeps the bytes the two values share at either end, and holds only the middle that differs.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef VALUEDELTA_H
+#define VALUEDELTA_H
+
+#include <QtGlobal>
+#include <crypto++/secblock.h>
+#include "securememory.h"
+#include "compressor.h"
+#include "record.h"
+
+class ValueDelta
+{
+    public:
+        static void make(const byte* base, size_t baseLength, const byte* value, size_t valueLength, int level, SecureBlock& delta);  // Encode value as an edit of base, its middle compressed at this level when that makes it smaller
+        static void identity(SecureBlock& delta);   // Delta that leaves any base as it is
+        static bool apply(const byte* base, size_t baseLength, const byte* delta, size_t deltaLength, SecureBlock& value);   // Rebuild the value from base, false if the delta is malformed or doesn't fit it
+
+    private:
+        enum Flag { DEFLATED = 1 }; // The middle is compressed
+};
+
+#endif // VALUEDELTA_H
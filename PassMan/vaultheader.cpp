@@ -0,0 +1,228 @@
+/*
+ * Description: Implementation of the VaultHeader class.
+ *              Describes the fixed binary header at the start of a database file.
+ *              Holds the key derivation and cipher parameters, the YubiKey challenge, salt, and nonce.
+ *              The header can be parsed and validated without touching the ciphertext that follows it.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Layout (all integers little-endian):
+ *     0   magic "PMDB"         4
+ *     4   format version       2
+ *     6   header length        2   (offset of the ciphertext)
+ *     8   KDF identifier       1
+ *     9   cipher identifier    1
+ *     10  flags                2
+ *     12  KDF iterations       4   (Argon2id passes)
+ *     16  ciphertext length    8   (includes the GCM tag)
+ *     24  HMAC challenge       64
+ *     88  salt                 16
+ *     104 nonce                12
+ *     116 chunk size           4   (plaintext bytes per chunk)
+ *     120 cleartext encoding   1   (binary records)
+ *     121 compression          1   (none or raw DEFLATE)
+ *     122 compression level    1   (informational)
+ *     123 reserved             1
+ *     124 key wrapping nonce   12
+ *     136 wrapped data key     48  (32-byte data key and 16-byte tag)
+ *     184 KDF memory cost      4   (KiB, Argon2id only)
+ *     188 KDF lanes            4   (Argon2id only)
+ *
+ * Journal segments (see Journal) of later saves may follow the ciphertext.  The snapshot and journal are encrypted
+ * under a random data key.  It is wrapped with AES-256-GCM under the key derived from the master password and
+ * YubiKey response, with the KDF identifier, iterations, challenge, salt, memory cost and lanes as associated data,
+ * so saves under the same credentials reuse it without another derivation.
+ *
+ * The snapshot cleartext may be compressed before it is encrypted.  Journal segments hold a single save's edits and
+ * stay uncompressed.
+ *
+ * Original text files have no binary header, and are described by a version 0 header that parse() never produces:
+ * one GCM ciphertext of JSON under the master key.  The first save rewrites them in this format.
+ *
+ * Readers take the ciphertext offset from the header length, so fields appended later are skipped.
+ */
+
+#include "vaultheader.h"
+#include <cstring>
+#include <climits>
+
+const char VaultHeader::MAGIC[4] = { 'P', 'M', 'D', 'B' };
+
+VaultHeader::VaultHeader() { clear(); }
+
+bool VaultHeader::hasMagic(const char* data, qint64 size) { return size >= (qint64) sizeof(MAGIC) && !memcmp(data, MAGIC, sizeof(MAGIC)); }  // Whether data starts like a binary database file
+
+VaultHeader::Status VaultHeader::parse(const char* data, qint64 size)   // Validate and load header from the start of a file
+{
+    const uchar* p = (const uchar*) data;
+    if (!hasMagic(data, size)) return BAD_MAGIC;
+    if (size < 8) return TRUNCATED;
+    version = qFromLittleEndian<quint16>(p + 4);
+    length = qFromLittleEndian<quint16>(p + 6);
+    if (version != FORMAT_VERSION) return BAD_VERSION;
+    if (length < HEADER_SIZE) return BAD_PARAMETERS;
+    if (size < length) return TRUNCATED;
+    kdfId = p[8];
+    cipherId = p[9];
+    flags = qFromLittleEndian<quint16>(p + 10);
+    kdfIterations = qFromLittleEndian<quint32>(p + 12);
+    cipherLength = qFromLittleEndian<quint64>(p + 16);
+    memcpy(challengeBytes, data + 24, CHALLENGE_SIZE);
+    memcpy(saltBytes, data + 88, SALT_SIZE);
+    memcpy(nonceBytes, data + 104, NONCE_SIZE);
+    cipherChunkSize = qFromLittleEndian<quint32>(p + 116);
+    encodingId = p[120];
+    compressionId = p[121];
+    compressionLevelValue = p[122];
+    memcpy(keyNonceBytes, data + 124, NONCE_SIZE);
+    memcpy(wrappedKeyBytes, data + 136, WRAPPED_KEY_SIZE);
+    kdfMemory = qFromLittleEndian<quint32>(p + 184);
+    kdfLanes = qFromLittleEndian<quint32>(p + 188);
+    if (kdfIterations < 1 || kdfIterations > INT_MAX) return BAD_PARAMETERS;
+    if (kdfId == KDF_ARGON2ID && (kdfLanes < 1 || kdfLanes > MAX_LANES || kdfMemory < 8 * kdfLanes || kdfMemory > MAX_MEMORY_COST)) return BAD_PARAMETERS;
+    if (kdfId != KDF_PBKDF2_SHA512 && kdfId != KDF_ARGON2ID) return BAD_PARAMETERS;
+    if (cipherId != CIPHER_AES256_GCM_CHUNKED || cipherChunkSize < 1 || cipherChunkSize > MAX_CHUNK_SIZE) return BAD_PARAMETERS;   // Single-shot GCM and JSON are only the text format's
+    if (encodingId != ENCODING_RECORDS) return BAD_PARAMETERS;
+    if (compressionId != COMPRESSION_NONE && compressionId != COMPRESSION_DEFLATE) return BAD_PARAMETERS;
+    if (cipherLength < 1) return TRUNCATED;
+    raw = QByteArray(data, length);
+    return VALID;
+}
+
+bool VaultHeader::fits(qint64 fileSize) const { return fileSize >= length && cipherLength <= (quint64) (fileSize - length); }   // Whether the described ciphertext lies within a file of this size
+
+QByteArray VaultHeader::serialize() const   // Produce header bytes for writing
+{
+    QByteArray out(HEADER_SIZE, 0);
+    uchar* p = (uchar*) out.data();
+    memcpy(p, MAGIC, sizeof(MAGIC));
+    qToLittleEndian<quint16>(FORMAT_VERSION, p + 4);
+    qToLittleEndian<quint16>(HEADER_SIZE, p + 6);
+    p[8] = kdfId;
+    p[9] = cipherId;
+    qToLittleEndian<quint16>(flags, p + 10);
+    qToLittleEndian<quint32>(kdfIterations, p + 12);
+    qToLittleEndian<quint64>(cipherLength, p + 16);
+    memcpy(p + 24, challengeBytes, CHALLENGE_SIZE);
+    memcpy(p + 88, saltBytes, SALT_SIZE);
+    memcpy(p + 104, nonceBytes, NONCE_SIZE);
+    qToLittleEndian<quint32>(cipherChunkSize, p + 116);
+    p[120] = encodingId;
+    p[121] = compressionId;
+    p[122] = compressionLevelValue;
+    memcpy(p + 124, keyNonceBytes, NONCE_SIZE);
+    memcpy(p + 136, wrappedKeyBytes, WRAPPED_KEY_SIZE);
+    qToLittleEndian<quint32>(kdfMemory, p + 184);
+    qToLittleEndian<quint32>(kdfLanes, p + 188);
+    return out;
+}
+
+QByteArray VaultHeader::associatedData() const  // Header bytes authenticated alongside the ciphertext
+{   // The ciphertext length is left out, as it is only known once streaming completes; the final chunk flag guards truncation
+    QByteArray out = raw.isEmpty() ? serialize() : raw;
+    qToLittleEndian<quint64>(0, (uchar*) out.data() + 16);
+    return out;
+}
+
+QByteArray VaultHeader::keyAssociatedData() const   // Key derivation parameters authenticated alongside the wrapped data key
+{   // Left independent of the ciphertext nonce and length, so the wrapped key carries over when the snapshot is rewritten
+    QByteArray out(5, 0);
+    out[0] = (char) kdfId;
+    qToLittleEndian<quint32>(kdfIterations, (uchar*) out.data() + 1);
+    out.append(challengeBytes, CHALLENGE_SIZE);
+    out.append(saltBytes, SALT_SIZE);
+    char cost[8];
+    qToLittleEndian<quint32>(kdfMemory, (uchar*) cost);
+    qToLittleEndian<quint32>(kdfLanes, (uchar*) cost + 4);
+    out.append(cost, sizeof(cost));
+    return out;
+}
+
+int VaultHeader::headerLength() const { return length; }    // Retrieve information:
+
+bool VaultHeader::isLegacy() const { return version == 0; } // Whether this describes an original text file, which has no journal and is under the master key
+
+int VaultHeader::kdf() const { return kdfId; }
+
+int VaultHeader::cipher() const { return cipherId; }
+
+quint32 VaultHeader::iterations() const { return kdfIterations; } // PBKDF2 iterations, or Argon2id passes
+
+quint32 VaultHeader::memoryCost() const { return kdfMemory; }  // Argon2id memory in KiB
+
+quint32 VaultHeader::lanes() const { return kdfLanes; }
+
+quint32 VaultHeader::chunkSize() const { return cipherChunkSize; }
+
+int VaultHeader::encoding() const { return encodingId; }
+
+int VaultHeader::compression() const { return compressionId; }
+
+int VaultHeader::compressionLevel() const { return compressionLevelValue; }  // Level the snapshot was compressed at, for information only
+
+quint64 VaultHeader::payloadLength() const { return cipherLength; }
+
+const char* VaultHeader::challenge() const { return challengeBytes; }
+
+const char* VaultHeader::salt() const { return saltBytes; }
+
+const char* VaultHeader::nonce() const { return nonceBytes; }
+
+const char* VaultHeader::keyNonce() const { return keyNonceBytes; }
+
+const char* VaultHeader::wrappedKey() const { return wrappedKeyBytes; }
+
+void VaultHeader::setKdf(int k) { kdfId = k; }  // Set information:
+
+void VaultHeader::setCipher(int c) { cipherId = c; }
+
+void VaultHeader::setIterations(quint32 i) { kdfIterations = i; }
+
+void VaultHeader::setMemoryCost(quint32 m) { kdfMemory = m; }
+
+void VaultHeader::setLanes(quint32 l) { kdfLanes = l; }
+
+void VaultHeader::setChunkSize(quint32 size) { cipherChunkSize = size; }
+
+void VaultHeader::setEncoding(int e) { encodingId = e; }
+
+void VaultHeader::setCompression(int c, int level)
+{
+    compressionId = c;
+    compressionLevelValue = (c == COMPRESSION_NONE) ? 0 : level;
+}
+
+void VaultHeader::setPayloadLength(quint64 len) { cipherLength = len; }
+
+void VaultHeader::setChallenge(const char* c) { memcpy(challengeBytes, c, CHALLENGE_SIZE); }
+
+void VaultHeader::setSalt(const char* s) { memcpy(saltBytes, s, SALT_SIZE); }
+
+void VaultHeader::setNonce(const char* n) { memcpy(nonceBytes, n, NONCE_SIZE); }
+
+void VaultHeader::setKeyNonce(const char* n) { memcpy(keyNonceBytes, n, NONCE_SIZE); }
+
+void VaultHeader::setWrappedKey(const char* k) { memcpy(wrappedKeyBytes, k, WRAPPED_KEY_SIZE); }
+
+void VaultHeader::clear(int version)    // Wipe all values, describing a binary header, or the original text format for version 0
+{
+    this->version = version;
+    length = version ? HEADER_SIZE : 0;
+    kdfId = KDF_PBKDF2_SHA512;
+    cipherId = version ? CIPHER_AES256_GCM_CHUNKED : CIPHER_AES256_GCM;
+    flags = 0;
+    kdfIterations = 0;
+    kdfMemory = 0;
+    kdfLanes = 0;
+    cipherLength = 0;
+    cipherChunkSize = 0;
+    encodingId = version ? ENCODING_RECORDS : ENCODING_JSON;
+    compressionId = COMPRESSION_NONE;
+    compressionLevelValue = 0;
+    memset(challengeBytes, 0, CHALLENGE_SIZE);
+    memset(saltBytes, 0, SALT_SIZE);
+    memset(nonceBytes, 0, NONCE_SIZE);
+    memset(keyNonceBytes, 0, NONCE_SIZE);
+    memset(wrappedKeyBytes, 0, WRAPPED_KEY_SIZE);
+    raw.clear();
+}
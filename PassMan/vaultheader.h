@@ -0,0 +1,100 @@
+/*
+ * Description: Definition of the VaultHeader class.
+ *              Describes the fixed binary header at the start of a database file.
+ *              Holds the key derivation and cipher parameters, the YubiKey challenge, salt, and nonce.
+ *              The header can be parsed and validated without touching the ciphertext that follows it.
+ * Author:      Adam Coffee
+ * Licensed under the three-clause BSD license, found in the LICENSE file.
+ */
+
+#ifndef VAULTHEADER_H
+#define VAULTHEADER_H
+
+#include <QByteArray>
+#include <QtEndian>
+
+class VaultHeader
+{
+    public:
+        enum Status { VALID, BAD_MAGIC, BAD_VERSION, TRUNCATED, BAD_PARAMETERS };   // Possible parse results
+        enum Kdf { KDF_PBKDF2_SHA512 = 1, KDF_ARGON2ID = 2 };   // Supported key derivation functions
+        enum Cipher { CIPHER_AES256_GCM = 1, CIPHER_AES256_GCM_CHUNKED = 2 };   // Supported ciphers
+        enum Encoding { ENCODING_JSON = 0, ENCODING_RECORDS = 1 };   // Supported cleartext encodings
+        enum Compression { COMPRESSION_NONE = 0, COMPRESSION_DEFLATE = 1 };   // Supported cleartext compression
+        static const char MAGIC[4];
+        static const int FORMAT_VERSION = 1;
+        static const int HEADER_SIZE = 192; // Bytes in the header
+        static const int MAX_HEADER_SIZE = 0xFFFF;  // Largest header length field
+        static const quint32 MAX_CHUNK_SIZE = 16 * 1024 * 1024;   // Bound on memory used per chunk when reading
+        static const quint32 MAX_MEMORY_COST = 4 * 1024 * 1024; // Bound on KDF memory in KiB, guards against corrupt values
+        static const quint32 MAX_LANES = 255;
+        static const int CHALLENGE_SIZE = 64;
+        static const int SALT_SIZE = 16;
+        static const int NONCE_SIZE = 12;   // Standard 96-bit GCM nonce
+        static const int DATA_KEY_SIZE = 32;
+        static const int WRAPPED_KEY_SIZE = DATA_KEY_SIZE + 16; // Encrypted data key and its GCM tag
+
+        VaultHeader();
+
+        static bool hasMagic(const char* data, qint64 size);    // Whether data starts like a binary database file
+        Status parse(const char* data, qint64 size);    // Validate and load header from the start of a file
+        bool fits(qint64 fileSize) const;   // Whether the described ciphertext lies within a file of this size
+        QByteArray serialize() const;   // Produce header bytes for writing
+        QByteArray associatedData() const;  // Header bytes authenticated alongside the ciphertext
+        QByteArray keyAssociatedData() const;   // Key derivation parameters authenticated alongside the wrapped data key
+        int headerLength() const;   // Retrieve information:
+        bool isLegacy() const;  // Whether this describes an original text file, which has no journal and is under the master key
+        int kdf() const;
+        int cipher() const;
+        quint32 iterations() const; // PBKDF2 iterations, or Argon2id passes
+        quint32 memoryCost() const; // Argon2id memory in KiB
+        quint32 lanes() const;
+        quint32 chunkSize() const;
+        int encoding() const;
+        int compression() const;
+        int compressionLevel() const;  // Level the snapshot was compressed at, for information only
+        quint64 payloadLength() const;
+        const char* challenge() const;
+        const char* salt() const;
+        const char* nonce() const;
+        const char* keyNonce() const;
+        const char* wrappedKey() const;
+        void setKdf(int k); // Set information:
+        void setCipher(int c);
+        void setIterations(quint32 i);
+        void setMemoryCost(quint32 m);
+        void setLanes(quint32 l);
+        void setChunkSize(quint32 size);
+        void setEncoding(int e);
+        void setCompression(int c, int level);
+        void setPayloadLength(quint64 len);
+        void setChallenge(const char* c);
+        void setSalt(const char* s);
+        void setNonce(const char* n);
+        void setKeyNonce(const char* n);
+        void setWrappedKey(const char* k);
+        void clear(int version = FORMAT_VERSION);   // Wipe all values, describing a binary header, or the original text format for version 0
+
+    private:
+        quint16 version;
+        quint16 length;
+        quint8 kdfId;
+        quint8 cipherId;
+        quint16 flags;
+        quint32 kdfIterations;
+        quint32 kdfMemory;
+        quint32 kdfLanes;
+        quint64 cipherLength;
+        quint32 cipherChunkSize;
+        quint8 encodingId;
+        quint8 compressionId;
+        quint8 compressionLevelValue;
+        char challengeBytes[CHALLENGE_SIZE];
+        char saltBytes[SALT_SIZE];
+        char nonceBytes[NONCE_SIZE];
+        char keyNonceBytes[NONCE_SIZE];
+        char wrappedKeyBytes[WRAPPED_KEY_SIZE];
+        QByteArray raw; // Header exactly as read, so it authenticates byte for byte, whatever follows the known fields
+};
+
+#endif // VAULTHEADER_H
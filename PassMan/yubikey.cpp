@@ -3,22 +3,28 @@
  *              Abstracts lower-level operations with Yubico's binaries for YubiKey interaction.
  *              Uses binaries from the 'yubikey-personalization' package, including 'ykchalresp' and 'ykinfo'.
  *              Allows for HMAC-SHA1 challenge-responses and metadata gathering on connected YubiKeys.
+ *              The device is probed in the background, once for every window that shows its state.
  * Author:      Adam Coffee
  * Licensed under the three-clause BSD license, found in the LICENSE file.
+ *
+ * Each probe is one ykinfo process asked for both the serial number and version, which are kept along with the
+ * state it leaves, so the main window, authenticator and tester all read the same result rather than each running
+ * their own.  Nothing waits on it: yubiKeyChanged is signalled once it ends.  A probe requested while one runs is
+ * folded into a single follow-up, so a burst of device changes costs at most two processes.
  */
 
 #include "yubikey.h"
 
 const QString YubiKey::HMAC_SLOT_1_COMMAND = "ykchalresp -1 -x -i-";    // Common values
 const QString YubiKey::HMAC_SLOT_2_COMMAND = "ykchalresp -2 -x -i-";
-const QString YubiKey::GET_SERIAL_COMMAND = "ykinfo -s";
-const QString YubiKey::GET_VERSION_COMMAND = "ykinfo -v";
-const QString YubiKey::GET_USB_COMMAND = "lsusb";
-const QString YubiKey::USB_NAME = "Yubikey";
+const QString YubiKey::GET_INFO_COMMAND = "ykinfo -s -v";
+const QString YubiKey::SERIAL_LABEL = "serial: ";
+const QString YubiKey::VERSION_LABEL = "version: ";
 const QString YubiKey::YUBIKEY_TIMEOUT = "Yubikey core error: timeout\n";
 const QString YubiKey::YUBIKEY_NOT_PRESENT = "Yubikey core error: no yubikey present\n";
 const QString YubiKey::DEVICE_WATCH_PATH = "/dev/";
 const QString YubiKey::USB_WATCH_PATH = "/dev/usb/";
+const QString YubiKey::TIMEOUT_KEY = "yubikey/timeout";
 const QString YubiKey::PRESENT_MSG = "YubiKey connected";   // Common state messages
 const QString YubiKey::TIMEOUT_MSG = "YubiKey timeout";
 const QString YubiKey::NOT_PRESENT_MSG = "YubiKey not connected";
@@ -32,6 +38,11 @@ YubiKey::YubiKey()
 {
     lastState = UNKNOWN;
     slot = 1;
+    pending = 0;
+    probe = 0;
+    probeAgain = false;
+    expiry.setSingleShot(true);
+    QObject::connect(&expiry, SIGNAL(timeout()), this, SLOT(challengeExpired()));
     watcher = new QFileSystemWatcher(); // Watch for changes to /dev/ directory
     QObject::connect(watcher, SIGNAL(directoryChanged(QString)), this, SLOT(deviceChange()));
     usbWatcher = new QFileSystemWatcher();  // Watch for changes specifically to /dev/usb/ directory to check for YubiKeys
@@ -41,6 +52,14 @@ YubiKey::YubiKey()
 
 YubiKey::~YubiKey()
 {
+    cancel();
+    if (probe)
+    {
+        probe->disconnect(this);
+        probe->kill();
+        probe->waitForFinished();
+        delete probe;
+    }
     delete watcher;
     delete usbWatcher;
 }
@@ -60,34 +79,63 @@ QByteArray YubiKey::hmacSHA1(const QByteArray& challenge, bool blocking)    // C
     return out.left(out.length() - 1).toUtf8(); // Strip newline
 }
 
-int YubiKey::state() { return lastState; }  // Return current state of the YubiKey
+void YubiKey::challenge(const QByteArray& challenge)  // Start an HMAC-SHA1 challenge-response without waiting, signalling responded once answered or timed out
+{
+    cancel();
+    pending = new QProcess();   // Answered in the background, the YubiKey may wait for a button-press
+    QObject::connect(pending, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(challengeDone()));
+    QObject::connect(pending, SIGNAL(error(QProcess::ProcessError)), this, SLOT(challengeDone()));  // Also covers a missing binary, which never finishes
+    pending->start(slot == 1 ? HMAC_SLOT_1_COMMAND : HMAC_SLOT_2_COMMAND, QIODevice::ReadWrite);
+    pending->write(challenge.toHex());  // Send challenge via standard input
+    pending->closeWriteChannel();
+    int timeout = configuredTimeout();
+    if (timeout > 0) expiry.start(timeout * 1000);
+}
 
-QString YubiKey::serial() // Return decimal serial number of the YubiKey
+void YubiKey::challengeDone()   // Read the answer once the challenge process ends
 {
-    QProcess* proc = new QProcess();    // Will run Yubico software in separate process
-    proc->start(GET_SERIAL_COMMAND, QIODevice::ReadWrite);
-    proc->waitForFinished(-1);
+    if (!pending) return;   // Already handled, a crash signals twice
+    expiry.stop();
+    QProcess* proc = pending;
+    pending = 0;
     QString error(proc->readAllStandardError());
     QString out(proc->readAllStandardOutput());
     setState(error, out);
-    proc->close();
-    delete proc;
-    return out.left(out.length() - 1).right(7); // Strip newline
+    proc->disconnect(this);
+    proc->deleteLater();    // Still delivering its own signals
+    emit responded(out.left(out.length() - 1).toUtf8());    // Strip newline
 }
 
-QString YubiKey::version() // Return version of the YubiKey
+void YubiKey::challengeExpired()    // Give up on a challenge that wasn't answered in time
 {
-    QProcess* proc = new QProcess();    // Will run Yubico software in separate process
-    proc->start(GET_VERSION_COMMAND, QIODevice::ReadWrite);
-    proc->waitForFinished(-1);
-    QString error(proc->readAllStandardError());
-    QString out(proc->readAllStandardOutput());
-    setState(error, out);
-    proc->close();
-    delete proc;
-    return out.left(out.length() - 1).right(5); // Strip newline
+    if (!pending) return;
+    cancel();
+    lastState = TIMEOUT;
+    emit responded(QByteArray());
+}
+
+void YubiKey::cancel()  // Abandon a challenge still waiting for an answer
+{
+    expiry.stop();
+    if (!pending) return;
+    pending->disconnect(this);
+    pending->kill();
+    pending->deleteLater();
+    pending = 0;
 }
 
+int YubiKey::configuredTimeout()    // Timeout from the settings file in seconds, 0 waits for as long as it takes
+{
+    int seconds = QSettings().value(TIMEOUT_KEY, DEFAULT_TIMEOUT).toInt();
+    return (seconds < 0) ? 0 : seconds;
+}
+
+int YubiKey::state() { return lastState; }  // Return current state of the YubiKey
+
+QString YubiKey::serial() { return serialNumber; } // Return decimal serial number of the YubiKey found by the last probe
+
+QString YubiKey::version() { return versionNumber; }    // Return version of the YubiKey found by the last probe
+
 void YubiKey::setState(const QString& error, const QString& out) // Interpret the state of the YubiKey after an operation attempt
 {
     if (!error.compare(YUBIKEY_TIMEOUT)) lastState = TIMEOUT;   // Save resulting state of operation
@@ -109,7 +157,43 @@ QString YubiKey::stateText() // Return the description of the current state
     return "";
 }
 
-void YubiKey::poll() { version(); } // Query any YubiKey to acquire status
+void YubiKey::poll()    // Start a probe of any YubiKey to acquire status, signalling yubiKeyChanged once it finishes
+{
+    if (probe)  // Already under way, but may have started before the change
+    {
+        probeAgain = true;
+        return;
+    }
+    probeAgain = false;
+    probe = new QProcess(); // Will run Yubico software in separate process
+    QObject::connect(probe, SIGNAL(finished(int,QProcess::ExitStatus)), this, SLOT(probeDone()));
+    QObject::connect(probe, SIGNAL(error(QProcess::ProcessError)), this, SLOT(probeDone()));    // Also covers a missing binary, which never finishes
+    probe->start(GET_INFO_COMMAND, QIODevice::ReadOnly);
+}
+
+void YubiKey::probeDone()   // Read the status and details once the probe process ends
+{
+    if (!probe) return; // Already handled, a crash signals twice
+    QProcess* proc = probe;
+    probe = 0;
+    QString error(proc->readAllStandardError());
+    QString out(proc->readAllStandardOutput());
+    setState(error, out);
+    serialNumber.clear();
+    versionNumber.clear();
+    if (lastState == PRESENT)
+    {
+        foreach (const QString& line, out.split('\n'))
+        {
+            if (line.startsWith(SERIAL_LABEL)) serialNumber = line.mid(SERIAL_LABEL.length());
+            else if (line.startsWith(VERSION_LABEL)) versionNumber = line.mid(VERSION_LABEL.length());
+        }
+    }
+    proc->disconnect(this);
+    proc->deleteLater();    // Still delivering its own signals
+    if (probeAgain) poll(); // Watchers hear once the latest probe is in
+    else emit yubiKeyChanged(); // Notify watchers that a change has occured
+}
 
 int YubiKey::currSlot() { return slot; }    // Return current config slot
 
@@ -117,15 +201,4 @@ void YubiKey::setSlot(int s) { if (slot == 1 || slot == 2) slot = s; }  // Set t
 
 void YubiKey::deviceChange() { if (usbWatcher->files().length() < 1) usbWatcher->addPath(USB_WATCH_PATH); } // Check if a USB device change occured
 
-void YubiKey::usbChange()   // Check if USB change was a YubiKey change
-{
-    QProcess* proc = new QProcess();    // Will run listing program in separate process
-    proc->start(GET_USB_COMMAND, QIODevice::ReadWrite);
-    proc->waitForFinished(-1);
-    QString out(proc->readAllStandardOutput());
-    if (out.contains(USB_NAME)) this->poll();
-    else lastState = NOT_PRESENT;
-    proc->close();
-    delete proc;
-    emit yubiKeyChanged();  // Notify watchers that a change has occured
-}
+void YubiKey::usbChange() { poll(); }  // Probe again after a USB change, which may have been a YubiKey, ykinfo reports one missing
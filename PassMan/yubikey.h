@@ -3,6 +3,7 @@
  *              Abstracts lower-level operations with Yubico's binaries for YubiKey interaction.
  *              Uses binaries from the 'yubikey-personalization' package, including 'ykchalresp' and 'ykinfo'.
  *              Allows for HMAC-SHA1 challenge-responses and metadata gathering on connected YubiKeys.
+ *              The device is probed in the background, once for every window that shows its state.
  * Author:      Adam Coffee
  * Licensed under the three-clause BSD license, found in the LICENSE file.
  */
@@ -12,6 +13,8 @@
 
 #include <QString>
 #include <QProcess>
+#include <QSettings>
+#include <QTimer>
 #include <QFileSystemWatcher>
 #include <QDir>
 
@@ -22,34 +25,46 @@ class YubiKey : public QObject
     public:
         enum State { PRESENT, TIMEOUT, NOT_PRESENT, UNKNOWN, UNKNOWN_ERROR };   // Possible states
         static const int SLOT_ONE, SLOT_TWO, MAX_HMAC_CHALLENGE_SIZE;
+        static const int DEFAULT_TIMEOUT = 30;  // Seconds to wait for a challenge to be answered, when none is configured
 
         YubiKey();
         ~YubiKey();
 
         QByteArray hmacSHA1(const QByteArray& challenge, bool blocking);    // Complete an HMAC-SHA1 challenge-response
+        void challenge(const QByteArray& challenge);    // Start an HMAC-SHA1 challenge-response without waiting, signalling responded once answered or timed out
+        void cancel();  // Abandon a challenge still waiting for an answer
+        static int configuredTimeout(); // Timeout from the settings file in seconds, 0 waits for as long as it takes
         int state();    // Return current state of YubiKey
-        QString serial();   // Return decimal serial number of the YubiKey
-        QString version();  // Return version of the YubiKey
+        QString serial();   // Return decimal serial number of the YubiKey found by the last probe
+        QString version();  // Return version of the YubiKey found by the last probe
         QString stateText();    // Return the description of the current state
         void setSlot(int s);    // Set the config slot
         int currSlot(); // Return current config slot
-        void poll();    // Query any YubiKey to acquire status
+        void poll();    // Start a probe of any YubiKey to acquire status, signalling yubiKeyChanged once it finishes
 
     signals:
         void yubiKeyChanged();  // Signal that a YubiKey may have been inserted/removed
+        void responded(const QByteArray& response); // Signal that a challenge finished, state tells whether the response is valid
 
     private slots:
         void deviceChange();    // Check if a USB device change occured
-        void usbChange();   // Check if USB change was a YubiKey change
+        void usbChange();   // Probe again after a USB change, which may have been a YubiKey
+        void probeDone();   // Read the status and details once the probe process ends
+        void challengeDone();   // Read the answer once the challenge process ends
+        void challengeExpired();    // Give up on a challenge that wasn't answered in time
 
     private:
-        static const QString HMAC_SLOT_1_COMMAND, HMAC_SLOT_2_COMMAND, GET_SERIAL_COMMAND, GET_VERSION_COMMAND, // Common values
-                             GET_USB_COMMAND, USB_NAME, YUBIKEY_TIMEOUT, YUBIKEY_NOT_PRESENT,
-                             DEVICE_WATCH_PATH, USB_WATCH_PATH;
+        static const QString HMAC_SLOT_1_COMMAND, HMAC_SLOT_2_COMMAND, GET_INFO_COMMAND, SERIAL_LABEL, VERSION_LABEL,    // Common values
+                             YUBIKEY_TIMEOUT, YUBIKEY_NOT_PRESENT, DEVICE_WATCH_PATH, USB_WATCH_PATH, TIMEOUT_KEY;
         static const QString PRESENT_MSG, TIMEOUT_MSG, NOT_PRESENT_MSG, UNKNOWN_MSG, UNKNOWN_ERROR_MSG; // Common state messages
         QFileSystemWatcher* watcher, * usbWatcher;
         int lastState;
         int slot;
+        QProcess* pending;  // Challenge waiting for an answer, null when there is none
+        QTimer expiry;
+        QProcess* probe;    // Probe still running, null when there is none
+        bool probeAgain;    // Whether a change came in while probing, so the result may already be stale
+        QString serialNumber, versionNumber;    // Details found by the last probe, empty if no YubiKey answered
 
         void setState(const QString& error, const QString& out);    // Interpret the state of the YubiKey after an operation attempt
 };
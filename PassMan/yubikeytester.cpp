@@ -24,8 +24,8 @@ YubiKeyTester::YubiKeyTester(YubiKey* yk, QWidget *parent) : QMainWindow(parent)
     yubikeyState = new QLabel();
     statusBar()->addPermanentWidget(yubikeyState);
     statusBar()->addPermanentWidget(new QLabel(" "));   // Dummy label to add space on right of statusBar
+    updateDetails();    // Shows the last probe at once, the fresh one fills in when it finishes
     yubikey->poll();
-    updateDetails();
 }
 
 YubiKeyTester::~YubiKeyTester() { delete ui; }
@@ -78,10 +78,8 @@ void YubiKeyTester::challenge() // Initiate an HMAC challenge
     }
 }
 
-void YubiKeyTester::updateDetails() // Get data about YubiKey
+void YubiKeyTester::updateDetails() // Show the details the last probe found
 {
-    QString serial(yubikey->serial());
-    QString version(yubikey->version());
     yubikeyState->setText(yubikey->stateText());
     if (yubikey->state() == YubiKey::PRESENT)
     {
@@ -28,7 +28,7 @@ class YubiKeyTester : public QMainWindow
         ~YubiKeyTester();
 
     private slots:
-        void updateDetails();   // Get data about YubiKey
+        void updateDetails();   // Show the details the last probe found
         void on_sendButton_clicked();   // Trigger a challenge via button
         void on_challengeLineEdit_returnPressed();  // Trigger a challenge via textbox
         void on_challengeLineEdit_textChanged(const QString &arg1); // Restrict challenges if nothing entered